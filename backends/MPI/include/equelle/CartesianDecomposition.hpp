@@ -0,0 +1,188 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <mpi.h>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+
+#include "equelle/CartesianGrid.hpp"
+
+namespace equelle {
+
+/** CartesianDecomposition splits a global cartesian grid into one block per MPI rank.
+ *
+ *  The ranks are arranged in a process grid created with MPI_Cart_create, and each rank
+ *  owns a block of consecutive cells in every dimension. The local grid has ghost cells of
+ *  the same width as a serial CartesianGrid. Ghost cells towards a neighbouring block are
+ *  filled by CartesianHaloExchange, ghost cells on the boundary of the global domain are
+ *  filled by the boundary conditions, as in the serial runtime.
+ */
+class CartesianDecomposition {
+public:
+    /**
+     * @brief CartesianDecomposition constructor.
+     * @param global_dims Number of interior cells of the global grid. The z-dimension is ignored for 2D grids.
+     * @param dimensions 2 or 3.
+     * @param ghost_width Width of the ghost boundary of the local grids.
+     * @param procs Number of ranks in each dimension. Zeros are filled in by MPI_Dims_create.
+     * @param periodic Whether the domain wraps around in each dimension. Periodic boundaries are
+     *                 then handled by the halo exchange.
+     * @param comm The ranks to distribute the grid over.
+     */
+    CartesianDecomposition( std::array<int, 3> global_dims, int dimensions, int ghost_width,
+                            std::array<int, 3> procs = {{0, 0, 0}},
+                            std::array<bool, 3> periodic = {{false, false, false}},
+                            MPI_Comm comm = MPI_COMM_WORLD );
+
+    /**
+     * @brief CartesianDecomposition constructor for a parameter object.
+     * @param param Uses the same grid keys as CartesianEquelleRuntime (grid_dim, nx, ny, nz, ghost_width), and
+     *              - procs_x, procs_y, procs_z Number of ranks in each dimension. (default 0, chosen by MPI)
+     *              - periodic_x, periodic_y, periodic_z Periodic domain in each dimension. (default false)
+     */
+    explicit CartesianDecomposition( const Opm::parameter::ParameterGroup& param, MPI_Comm comm = MPI_COMM_WORLD );
+
+    ~CartesianDecomposition();
+
+    MPI_Comm comm;                   //!< Communicator with the cartesian process topology. Owned by this class.
+    int rank;                        //!< Rank in comm.
+    int size;                        //!< Number of ranks in comm.
+    int dimensions;                  //!< Number of spatial dimensions.
+    std::array<int, 3> global_dims;  //!< Number of interior cells of the global grid. The z-dimension is 1 for 2D grids.
+    std::array<int, 3> procs;        //!< Number of ranks in each dimension.
+    std::array<int, 3> coords;       //!< Position of this rank in the process grid.
+    std::array<int, 3> offset;       //!< Global index of the first local interior cell.
+    std::array<bool, 3> periodic;    //!< Whether the process grid wraps around in each dimension.
+    CartesianGrid grid;              //!< The local block of the grid, with ghost cells.
+
+    /**
+     * @brief neighbour Returns the rank of the block at (dx, dy, dz) relative to this one.
+     * @return The rank, or MPI_PROC_NULL outside a non-periodic domain.
+     */
+    int neighbour( int dx, int dy, int dz = 0 ) const;
+
+    /**
+     * @brief isOnDomainBoundary Returns true if the given side of the local block is on the boundary of the global grid.
+     *
+     * Only these sides should have their ghost cells filled by boundary conditions.
+     */
+    bool isOnDomainBoundary( CartesianGrid::Face side ) const;
+
+    /**
+     * @brief applyBoundaryCondition Like CartesianGrid::applyBoundaryCondition, but only on the sides of the global domain.
+     */
+    void applyBoundaryCondition( StencilCollOfScalar& coll, CartesianGrid::Face side, BoundaryCondition bc, double value = 0.0 ) const;
+
+    /**
+     * @brief gatherInterior Collects the interior cells of a distributed collection on one rank.
+     * @return The global interior cells, with i running fastest, then j and k, on root. An empty vector on the other ranks.
+     */
+    std::vector<double> gatherInterior( const StencilCollOfScalar& coll, int root = 0 ) const;
+
+    /**
+     * @brief scatterInterior Sets the interior cells of the local collection from global values given on root.
+     * @param global The global interior cells in the order of gatherInterior. Only read on root.
+     */
+    void scatterInterior( const std::vector<double>& global, StencilCollOfScalar& coll, int root = 0 ) const;
+
+private:
+    CartesianDecomposition( const CartesianDecomposition& );
+    CartesianDecomposition& operator=( const CartesianDecomposition& );
+
+    void init( std::array<int, 3> requested_procs, int ghost_width, MPI_Comm parent );
+
+    /// Number of interior cells and global offset of the block at the given process coordinates.
+    void blockOf( const std::array<int, 3>& block_coords, std::array<int, 3>& dims, std::array<int, 3>& start ) const;
+};
+
+
+/** CartesianHaloExchange fills the ghost cells of a distributed collection from the neighbouring blocks.
+ *
+ *  All neighbours are exchanged, including those across edges and corners, so that stencils
+ *  reading diagonal cells see correct values. The messages are described by MPI subarray
+ *  datatypes and sent with persistent requests, which are created the first time a
+ *  collection is exchanged and reused afterwards. Requests are kept per data buffer, so that
+ *  collections which trade buffers with StencilCollOfScalar::swapAssign keep using theirs.
+ *
+ *  Boundary conditions must be applied to the sides on the global domain boundary before the
+ *  exchange, since the ghost cells of a neighbour along such a side are sent together with
+ *  its interior cells. executeOverlapped runs a stencil sweep while the messages are in flight.
+ */
+class CartesianHaloExchange {
+public:
+    explicit CartesianHaloExchange( const CartesianDecomposition& decomposition );
+    ~CartesianHaloExchange();
+
+    /**
+     * @brief start Begins filling the ghost cells of coll. The ghost cells must not be read, and the
+     *        interior cells next to them must not be written, until finish() has been called.
+     */
+    void start( StencilCollOfScalar& coll );
+
+    /**
+     * @brief finish Waits until the exchange begun by start() is complete.
+     */
+    void finish();
+
+    /**
+     * @brief exchange Fills the ghost cells of coll, without overlap.
+     */
+    void exchange( StencilCollOfScalar& coll );
+
+    /**
+     * @brief executeOverlapped Runs stencil(i, j[, k]) on all local cells while the ghost cells of in are exchanged.
+     *
+     * The cells at least ghost_width cells inside the local block are computed while the
+     * messages are in flight, the rest after they have arrived. The stencil must read at most ghost_width
+     * cells away, and must not write to in. Ghost cells on the boundary of the global domain must already
+     * be filled.
+     */
+    template <class Stencil>
+    void executeOverlapped( StencilCollOfScalar& in, const Stencil& stencil );
+
+private:
+    CartesianHaloExchange( const CartesianHaloExchange& );
+    CartesianHaloExchange& operator=( const CartesianHaloExchange& );
+
+    /// The persistent requests bound to one data buffer.
+    struct RequestSet {
+        const double* data;
+        std::vector<MPI_Request> requests;
+    };
+
+    RequestSet& requestsFor( StencilCollOfScalar& coll );
+
+    const CartesianDecomposition& decomposition_;
+    std::vector<int> neighbours_;          //!< Rank of each neighbour that is not MPI_PROC_NULL.
+    std::vector<int> send_tags_;
+    std::vector<int> recv_tags_;
+    std::vector<MPI_Datatype> send_types_; //!< The interior cells sent to each neighbour.
+    std::vector<MPI_Datatype> recv_types_; //!< The ghost cells received from each neighbour.
+    std::vector<RequestSet> request_sets_;
+    RequestSet* active_;
+
+    std::vector<CartesianGrid::CellRange> interior_; //!< Cells that do not read ghost cells. Empty or one range.
+    std::vector<CartesianGrid::CellRange> shell_;    //!< The remaining cells.
+};
+
+
+
+template <class Stencil>
+void CartesianHaloExchange::executeOverlapped( StencilCollOfScalar& in, const Stencil& stencil )
+{
+    start( in );
+    for ( const CartesianGrid::CellRange& range : interior_ ) {
+        range.execute( stencil );
+    }
+    finish();
+    for ( const CartesianGrid::CellRange& range : shell_ ) {
+        range.execute( stencil );
+    }
+}
+
+} // namespace equelle
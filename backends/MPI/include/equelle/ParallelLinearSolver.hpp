@@ -0,0 +1,83 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <Eigen/Sparse>
+#include <Eigen/IterativeLinearSolvers>
+
+#include <mpi.h>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+
+#include "equelle/SubGridBuilder.hpp"
+
+namespace equelle {
+
+class SubGridHaloExchange;
+
+/** ParallelLinearSolver solves linear systems distributed like the cells of a SubGrid.
+ *
+ *  Each rank holds the rows of its owned cells, with one column per local cell. The columns of the
+ *  ghost cells therefore refer to unknowns owned by other ranks, and every matrix-vector product
+ *  first fills them with the halo exchange of the subgrid. The system is solved with BiCGStab,
+ *  preconditioned by block Jacobi: an incomplete LU factorisation of the owned rows and columns
+ *  on each rank. Inner products are summed over the owned cells with MPI_Allreduce.
+ */
+class ParallelLinearSolver {
+public:
+    typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Matrix;
+    typedef Eigen::Array<double, Eigen::Dynamic, 1> Vector;
+
+    struct Report {
+        bool converged;
+        int iterations;
+        double residual_norm; //!< Global two-norm of the final residual.
+    };
+
+    /**
+     * @brief ParallelLinearSolver constructor.
+     * @param subGrid The subgrid of this rank, which gives the owned and ghost cells.
+     * @param haloExchange Exchange for the ghost cells of subGrid.
+     * @param param Reads
+     *              - linsolver_residual_tolerance Relative reduction of the residual norm. (default 1e-8)
+     *              - linsolver_max_iterations (default 1000)
+     */
+    ParallelLinearSolver( const SubGrid& subGrid, SubGridHaloExchange& haloExchange,
+                          const Opm::parameter::ParameterGroup& param, MPI_Comm comm = MPI_COMM_WORLD );
+
+    /**
+     * @brief solve Solves A x = b. Collective over all ranks.
+     * @param A One row per owned cell, and one column per local cell.
+     * @param b One entry per owned cell.
+     * @param x One entry per local cell. Holds the initial guess, and the solution on return,
+     *          with the ghost cells updated.
+     */
+    Report solve( const Matrix& A, const Vector& b, Vector& x );
+
+    /// Sum of a*b over the owned cells of all ranks.
+    double dot( const Vector& a, const Vector& b ) const;
+
+    /// Two-norm over the owned cells of all ranks.
+    double norm( const Vector& a ) const;
+
+private:
+    /// y = A x, after updating the ghost cells of x.
+    void multiply( const Matrix& A, Vector& x, Vector& y );
+
+    /// Applies the block Jacobi preconditioner to the owned cells of r, and writes the owned cells of z.
+    void precondition( const Vector& r, Vector& z ) const;
+
+    /// Sums values over all ranks, in place.
+    void allSum( double* values, int count ) const;
+
+    const SubGrid& subGrid_;
+    SubGridHaloExchange& haloExchange_;
+    MPI_Comm comm_;
+    int num_owned_;
+    double tolerance_;
+    int max_iterations_;
+    Eigen::IncompleteLUT<double> ilu_;
+};
+
+} // namespace equelle
@@ -0,0 +1,36 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace equelle {
+
+/** A partition file stores the owner of every cell of a grid, so that a decomposition can be
+ *  computed once, for instance by standalone_partition, and reused by RuntimeMPI without Zoltan.
+ *
+ *  The file is binary, in native byte order: three 32-bit integers (a magic number, the number of
+ *  cells and the number of parts), followed by the owning part of each cell as a 32-bit integer.
+ */
+namespace PartitionFile {
+
+    /**
+     * @brief write Writes cellOwners to filename. Throws std::runtime_error if the file cannot be written.
+     * @param cellOwners The part of each cell, in the global cell enumeration.
+     * @param numParts The number of parts, which must be larger than every entry of cellOwners.
+     */
+    void write( const std::string& filename, const std::vector<int>& cellOwners, int numParts );
+
+    /**
+     * @brief read Reads a file written by write(). Throws std::runtime_error if it is missing or malformed.
+     * @param numParts Set to the number of parts of the partition.
+     * @return The part of each cell, in the global cell enumeration.
+     */
+    std::vector<int> read( const std::string& filename, int& numParts );
+
+} // namespace PartitionFile
+
+} // namespace equelle
@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <fstream>
+#include <map>
+#include <mpi.h>
 #include <opm/core/utility/parameters/ParameterGroup.hpp>
 #include <opm/core/grid/GridManager.hpp>
 #include <opm/core/grid.h>
@@ -15,14 +17,25 @@ class Zoltan;
 
 namespace equelle {
 class EquelleRuntimeCPU;
+class SubGridHaloExchange;
+class ParallelLinearSolver;
 
 /** RuntimeMPI is responsible for executing Equelle-simulators using MPI.
  *  It handles both the MPI context and the domain decomposition, using Zoltan.
  *
- *  The current domain-decomposition and subgrid-building relies on all nodes
- *  reading the globalGrid from disk and then extracting the local subGrid from it.
- *  This is because the current subGrid-building (with ghost cells) relies on full
- *  access to the neighborhood.
+ *  By default all nodes read the globalGrid from disk and then extract the local subGrid from it.
+ *  This is because the subGrid-building (with ghost cells) relies on full access to the neighborhood.
+ *  With the parameter scatter_grid set, only node 0 reads the globalGrid. It builds the subGrids
+ *  of all nodes and sends them out, so that the memory of the other nodes scales with their subGrid.
+ *
+ *  The partitioning is set by the parameters
+ *  - partition_method: graph (default) or hypergraph on the cell adjacency, or the faster geometric
+ *    methods rcb and rib, which bisect the cell centroids.
+ *  - partition_cell_weights: none (default), faces (the number of faces of each cell), or file,
+ *    which reads one cost per cell from partition_cell_weights_filename.
+ *  - partition_edge_weights: none (default), face_areas, or transmissibility. Ignored by rcb and rib.
+ *  - partition_filename: a PartitionFile, for instance from standalone_partition, to use instead of
+ *    running Zoltan. It must have one part per node.
  */
 class  RuntimeMPI {
 public:
@@ -30,7 +43,7 @@ public:
     RuntimeMPI( const Opm::parameter::ParameterGroup& param );
     virtual ~RuntimeMPI();
 
-    std::unique_ptr<Opm::GridManager> globalGrid; //! Assumed to be read from disk on every node.
+    std::unique_ptr<Opm::GridManager> globalGrid; //! Read from disk on every node, or only on node 0 with scatter_grid.
     equelle::SubGrid subGrid; //! Filled with the local subGrid after call to decompose.
 
     void decompose();
@@ -47,6 +60,26 @@ public:
      */
     CollOfCell boundaryCells() const;
     CollOfFace boundaryFaces() const;
+    CollOfFace interiorFaces() const;
+    CollOfCell firstCell( const CollOfFace& faces ) const;
+    CollOfCell secondCell( const CollOfFace& faces ) const;
+    ///@}
+
+    ///@{ Operators reading neighbouring cells.
+
+    /**
+     * @brief gradient Updates the ghost cells of its argument itself.
+     *
+     * The exchange runs while the faces that are not next to a ghost cell are computed,
+     * the remaining faces are computed after it has completed.
+     */
+    CollOfScalar gradient( const CollOfScalar& cell_scalarfield );
+    CollOfScalar divergence( const CollOfScalar& face_fluxes ) const;
+
+    template <class SomeCollection, class EntityCollection>
+    typename CollType<SomeCollection>::Type operatorOn( const SomeCollection& data,
+                                                        const EntityCollection& from_set,
+                                                        const EntityCollection& to_set );
     ///@}
 
     /// Return the number of cells in collection. Will do MPI-transfer.
@@ -56,6 +89,13 @@ public:
     CollOfScalar inputCollectionOfScalar(const String& name,
                                          const CollOfFace& coll);
 
+    /**
+     * @brief inputCollectionOfScalar Reads the values of the cells in coll, without any node holding the whole file.
+     *
+     * Text files are parsed on node 0, which sends every node its own values. With name_binary the
+     * file holds raw doubles in native byte order, and every node reads its own values with MPI-IO.
+     * In both cases the file is in the global cell enumeration.
+     */
     CollOfScalar inputCollectionOfScalar(const String& name,
                                          const CollOfCell& coll);
 
@@ -69,17 +109,102 @@ public:
                                   const Scalar default_value);
     ///@}
 
+    /**
+     * @brief output Writes a collection On AllCells(), in the global cell enumeration.
+     *
+     * Only the owned cells of each node are written, and no node gathers more than its own values,
+     * except node 0 for text output. With output_format=binary all nodes write their own cells
+     * collectively with MPI-IO into tag-00000.bin, which holds raw doubles in native byte order,
+     * like the output files of the cartesian runtime. Text output is written by node 0 as in
+     * EquelleRuntimeCPU::output.
+     */
     void output(const String& tag, const CollOfScalar& vals);
 
+    ///@{ Reductions.
+
+    enum ReduceOperation { Min, Max, Sum, Prod };
+
+    /// The contribution of this node to a global reduction, from partialReduce().
+    struct PartialReduction {
+        ReduceOperation op;
+        Scalar value;
+    };
+
+    /**
+     * @brief partialReduce Reduces the entries of x that this node owns.
+     *
+     * The ghost cells, and the faces that are also stored on the node owning their
+     * first cell (their second cell on the boundary), are left out, so that every
+     * global entry is counted exactly once.
+     * @param domain The set x is On, in the node-local enumeration.
+     */
+    PartialReduction partialReduce( ReduceOperation op, const CollOfScalar& x, const CollOfCell& domain ) const;
+    PartialReduction partialReduce( ReduceOperation op, const CollOfScalar& x, const CollOfFace& domain ) const;
+
+    /**
+     * @brief reduce Completes several reductions with a single MPI_Allreduce.
+     *
+     * Reductions needed at the same point, such as the maximum wave speed of a CFL
+     * condition and the total mass, should be batched here rather than done one by one.
+     * @return The global results, in the order of batch.
+     */
+    std::vector<Scalar> reduce( const std::vector<PartialReduction>& batch );
+
+    template <class EntityCollection>
+    Scalar minReduce( const CollOfScalar& x, const EntityCollection& domain );
+    template <class EntityCollection>
+    Scalar maxReduce( const CollOfScalar& x, const EntityCollection& domain );
+    template <class EntityCollection>
+    Scalar sumReduce( const CollOfScalar& x, const EntityCollection& domain );
+    template <class EntityCollection>
+    Scalar prodReduce( const CollOfScalar& x, const EntityCollection& domain );
+    ///@}
+
+    ///@{ Solver functions.
+
+    /**
+     * @brief newtonSolve Solves rescomp(u) = 0 for the owned cells of all nodes.
+     *
+     * The unknowns are all local cells, so the Jacobian of the owned rows has columns for the
+     * ghost cells, which belong to unknowns on the neighbouring nodes. The linear systems are
+     * solved by ParallelLinearSolver, and the Newton iterations stop on the global residual norm.
+     * Reads the same parameters as EquelleRuntimeCPU::newtonSolve (max_iter, abs_res_tol, verbose).
+     * @param u_initialguess A collection on all local cells.
+     */
+    template <class ResidualFunctor>
+    CollOfScalar newtonSolve( const ResidualFunctor& rescomp, const CollOfScalar& u_initialguess );
+    ///@}
+
     ///@{ Communication between nodes
 
     /**
      * @brief allGather Assembles a distributed collection of scalar to all nodes
-     * @param coll
+     *
+     * The sizes and global indices of the owned entries are only exchanged the first time a
+     * domain is gathered. Later gathers of the same domain only send the values of the owned
+     * entries. The result is ordered by global index, as the serial backend would see it.
+     * @param coll A collection On domain. Without domain, a collection On AllCells().
      * @todo So far only the constant (value) part of an CollOfScalar is returned.
-     * @return
      */
     CollOfScalar allGather( const CollOfScalar& coll );
+    CollOfScalar allGather( const CollOfScalar& coll, const CollOfCell& domain );
+    CollOfScalar allGather( const CollOfScalar& coll, const CollOfFace& domain );
+
+    /**
+     * @brief updateGhosts Returns coll with the values of the ghost cells copied from the nodes that own them.
+     *
+     * Collections on AllCells() are also computed on the ghost cells, from the ghost values of
+     * their arguments, so the ghost values go stale as soon as they depend on a neighbour.
+     * The MPI code generator calls this on the argument of operations that read neighbouring
+     * cells, such as gathers like u On FirstCell(faces), once per field until it is assigned again.
+     * The gradient updates its argument itself.
+     * Collections with derivatives are returned as they are, and only if their ghost cells are
+     * already up to date, as for the primary variables of newtonSolve and values computed
+     * cell by cell from them. The derivatives of a ghost cell on its owner are in terms of the
+     * owner's cells, so they cannot be exchanged, and all nodes throw if any ghost cell is stale.
+     * @param coll A collection on all local cells, including the ghost cells.
+     */
+    CollOfScalar updateGhosts( const CollOfScalar& coll );
 
     ///@}
 
@@ -94,8 +219,55 @@ public:
 private:
     std::unique_ptr<Zoltan> zoltan;
     std::unique_ptr<equelle::EquelleRuntimeCPU> runtime;
+    std::unique_ptr<SubGridHaloExchange> haloExchange; //! Built in decompose().
+    std::unique_ptr<ParallelLinearSolver> linearSolver; //! Built in decompose().
     Opm::parameter::ParameterGroup param_;
 
+    // For reduce(). Entries are pairs of (operation, value), combined by reductionOp_.
+    MPI_Datatype reductionType_;
+    MPI_Op reductionOp_;
+
+    bool scatter_grid_; //! Only node 0 holds the globalGrid, and sends the other nodes their subGrid.
+    std::string partition_method_;       //! partition_method: graph, hypergraph, rcb or rib.
+    std::string partition_cell_weights_; //! partition_cell_weights: none, faces or file.
+    std::string partition_edge_weights_; //! partition_edge_weights: none, face_areas or transmissibility.
+    bool output_binary_; //! output_format=binary, written with MPI-IO.
+    std::map<std::string, int> outputcount_; //! Number of binary outputs so far, per tag.
+
+    // For newtonSolve().
+    int verbose_;
+    int max_iter_;
+    double abs_res_tol_;
+
+    /// Communication plan of allGather() for one domain, made on first use.
+    struct GatherPlan {
+        bool faces;
+        std::vector<int> domain;   //!< Local indices of the domain, to recognise it.
+        std::vector<int> owned;    //!< Positions of the owned entries in a collection On domain.
+        std::vector<int> counts;   //!< Number of owned entries on each node.
+        std::vector<int> offsets;  //!< Start of the entries of each node in the gathered values.
+        std::vector<int> position; //!< Position of each gathered value in the global collection.
+    };
+    std::vector<GatherPlan> gatherPlans_;
+
+    const GatherPlan& gatherPlan( bool faces, const std::vector<int>& domain );
+    CollOfScalar gather( const CollOfScalar& coll, const GatherPlan& plan );
+
+    /// Whether this node owns the face: it owns its first cell, or its second cell on the global boundary.
+    bool isOwnedFace( int face ) const;
+
+    /// Solves the linear system of the owned rows of residual, and returns the update for all local cells.
+    CollOfScalar::V solveForUpdate( const CollOfScalar& residual );
+
+    /// Two-norm over the owned cells of all nodes.
+    double twoNorm( const CollOfScalar& vals ) const;
+
+    /// Whether partition_method is one of the geometric methods, which partition the cell centroids.
+    bool isGeometricPartition() const;
+
+    /// Writes the load imbalance, edge cut and ghost ratio of the decomposition to logstream. Collective.
+    void logPartitionQuality();
+
     void initializeZoltan();
     void initializeGrid();
 };
@@ -1,6 +1,85 @@
 #pragma once
 
+#include "equelle/EquelleRuntimeCPU.hpp"
+
 namespace equelle {
 
+template <class SomeCollection, class EntityCollection>
+typename CollType<SomeCollection>::Type
+RuntimeMPI::operatorOn( const SomeCollection& data,
+                        const EntityCollection& from_set,
+                        const EntityCollection& to_set )
+{
+    // Both sets are in the node-local enumeration, so the serial implementation applies.
+    return runtime->operatorOn( data, from_set, to_set );
+}
+
+template <class EntityCollection>
+Scalar RuntimeMPI::minReduce( const CollOfScalar& x, const EntityCollection& domain )
+{
+    return reduce( { partialReduce( Min, x, domain ) } ).front();
+}
+
+template <class EntityCollection>
+Scalar RuntimeMPI::maxReduce( const CollOfScalar& x, const EntityCollection& domain )
+{
+    return reduce( { partialReduce( Max, x, domain ) } ).front();
+}
+
+template <class EntityCollection>
+Scalar RuntimeMPI::sumReduce( const CollOfScalar& x, const EntityCollection& domain )
+{
+    return reduce( { partialReduce( Sum, x, domain ) } ).front();
+}
+
+template <class EntityCollection>
+Scalar RuntimeMPI::prodReduce( const CollOfScalar& x, const EntityCollection& domain )
+{
+    return reduce( { partialReduce( Prod, x, domain ) } ).front();
+}
+
+template <class ResidualFunctor>
+CollOfScalar RuntimeMPI::newtonSolve( const ResidualFunctor& rescomp, const CollOfScalar& u_initialguess )
+{
+    auto startTime = MPI_Wtime();
+    const bool root = getMPIRank() == 0;
+
+    // Start from consistent ghost values. The updates from the linear solver keep them consistent.
+    const std::vector<int> block_pattern( 1, u_initialguess.size() );
+    CollOfScalar u = CollOfScalar::variable( 0, updateGhosts( u_initialguess ).value(), block_pattern );
+    CollOfScalar residual = rescomp( u );
+    double residualNorm = twoNorm( residual );
+
+    int iter = 0;
+    if ( verbose_ > 1 && root ) {
+        std::cout << "    newtonSolve: iter = " << iter << " (max = " << max_iter_
+                  << "), norm(residual) = " << residualNorm
+                  << " (tol = " << abs_res_tol_ << ")" << std::endl;
+    }
+
+    // The norm is global, so all nodes take the same number of iterations.
+    while ( ( residualNorm > abs_res_tol_ ) && ( iter < max_iter_ ) ) {
+        u = u - CollOfScalar( solveForUpdate( residual ) );
+        residual = rescomp( u );
+        residualNorm = twoNorm( residual );
+        ++iter;
+
+        if ( verbose_ > 1 && root ) {
+            std::cout << "    newtonSolve: iter = " << iter << " (max = " << max_iter_
+                      << "), norm(residual) = " << residualNorm
+                      << " (tol = " << abs_res_tol_ << ")" << std::endl;
+        }
+    }
+    if ( verbose_ > 0 && root ) {
+        if ( residualNorm > abs_res_tol_ ) {
+            std::cout << "Newton solver failed to converge in " << max_iter_ << " iterations" << std::endl;
+        } else {
+            std::cout << "Newton solver converged in " << iter << " iterations" << std::endl;
+        }
+    }
+    logstream << "newtonSolve took " << MPI_Wtime() - startTime << " seconds and " << iter << " iterations" << std::endl;
+
+    return u.value();
+}
 
 } // namespace equelle
@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include <set>
 
+#include <mpi.h>
+
 #include "equelle/equelleTypes.hpp"
 
 class UnstructuredGrid;
@@ -16,6 +18,10 @@ struct SubGrid {
     UnstructuredGrid *c_grid; //! Pointer to data for the subGrid with "local"-indexing. Owned by this class.
 
     int number_of_ghost_cells;
+    int number_of_interior_cells; //! Owned cells without a ghost cell as neighbour. These are the first cells,
+                                  //! followed by the owned cells next to a ghost cell, and then the ghost cells.
+    int number_of_ghost_faces;    //! Faces with a ghost cell on at least one side. These are the last faces,
+                                  //! so that the other faces can be computed before the ghost cells are updated.
 
     std::vector<int> cell_local_to_global; //! Maps local cell indices to global cell indices. The ghost cells are the
                                   //! last cells in this range.
@@ -45,11 +51,26 @@ public:
      *        In addition the returned subGrid will contain a number of ghost cells.
      *        Need not be in sorted order.
      *        The first (SubGrid.c_grid->number_of_cells - SubGrid::number_of_ghost_cells) elements of
-     *        SubGrid::global_cell will be equal to this parameter.
-     * @return A new SubGrid
+     *        SubGrid::cell_local_to_global will be these cells, with the ones next to a ghost cell last.
+     *        The relative order is otherwise kept.
+     * @return A new SubGrid. Its c_grid keeps the cartdims and cell_facetag of the global grid,
+     *         and its global_cell holds the Cartesian index of every local cell.
      */
     static SubGrid build( const UnstructuredGrid* globalGrid, const std::vector<int>& cellsToExtract );
 
+    /**
+     * @brief scatter builds the subgrids of all nodes on the root, and sends every node its own.
+     *        Collective over comm. Only the root needs the global grid, so the memory of the other
+     *        nodes scales with their subgrid.
+     * @param globalGrid Only read on the root.
+     * @param cellOwners The rank owning each global cell. Only read on the root.
+     * @return The subgrid of this node, laid out as by build: the owned cells that are not next
+     *         to a ghost cell, then the owned cells that are, then the ghost cells. Each of the three
+     *         groups is in increasing global order.
+     */
+    static SubGrid scatter( const UnstructuredGrid* globalGrid, const std::vector<int>& cellOwners,
+                            int root = 0, MPI_Comm comm = MPI_COMM_WORLD );
+
 
 private:
     SubGridBuilder();
@@ -80,6 +101,20 @@ private:
     static node_mapping extractNeighborNodes(const UnstructuredGrid *grid, const std::vector<int>& globalFaces);
 
     static void build_face_cells( const face_mapping& participatingFaces, SubGrid& subGrid, const UnstructuredGrid* grid );
+
+    /**
+     * @brief orderOwnedCells Moves the cells that have a neighbour outside cellsToExtract to the end.
+     * @param sortedCells cellsToExtract in sorted order.
+     * @param number_of_interior_cells Set to the number of cells without such a neighbour.
+     */
+    static std::vector<int> orderOwnedCells( const UnstructuredGrid* grid, const std::vector<int>& cellsToExtract,
+                                             const std::vector<int>& sortedCells, int& number_of_interior_cells );
+
+    /**
+     * @brief orderFaces Renumbers the faces so that the faces next to a ghost cell are last.
+     * @return The number of faces next to a ghost cell.
+     */
+    static int orderFaces( face_mapping& participatingFaces, const SubGrid& subGrid, const UnstructuredGrid* grid );
 };
 
 struct GridQuerying {
@@ -0,0 +1,76 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "equelle/SubGridBuilder.hpp"
+
+namespace equelle {
+
+/** SubGridHaloExchange copies the values of the ghost cells of a SubGrid from the ranks that own them.
+ *
+ *  At construction every rank finds the owner of each of its ghost cells and tells the owners
+ *  which of their cells it needs. This gives, per neighbouring rank, a list of owned cells to send
+ *  and a list of ghost cells to receive, in the same order on both sides. The values are packed
+ *  into one contiguous buffer per direction, and the messages use persistent requests bound to
+ *  these buffers, so that an exchange only has to pack, start, wait and unpack.
+ */
+class SubGridHaloExchange {
+public:
+    /**
+     * @brief SubGridHaloExchange constructor. Collective over comm.
+     * @param subGrid The subgrid of this rank, with the ghost cells last in cell_local_to_global.
+     * @param comm The ranks the grid is distributed over.
+     */
+    explicit SubGridHaloExchange( const SubGrid& subGrid, MPI_Comm comm = MPI_COMM_WORLD );
+    ~SubGridHaloExchange();
+
+    /**
+     * @brief start Packs the cells needed by the neighbours and starts all messages.
+     * @param values One value per local cell, in the local cell enumeration.
+     */
+    void start( const double* values );
+
+    /**
+     * @brief finish Waits for the messages begun by start(), and writes the received values into the ghost cells.
+     * @param values One value per local cell. Only the ghost cells are written.
+     */
+    void finish( double* values );
+
+    /**
+     * @brief exchange Fills the ghost cells of values, without overlap.
+     */
+    void exchange( double* values );
+
+    /// Ranks that own at least one of our ghost cells.
+    const std::vector<int>& receiveRanks() const { return recv_ranks_; }
+
+    /// Ranks that have at least one of our owned cells as a ghost cell.
+    const std::vector<int>& sendRanks() const { return send_ranks_; }
+
+    /// Local indices of the owned cells that are ghost cells on another rank, grouped by that rank.
+    const std::vector<int>& sendCells() const { return send_cells_; }
+
+private:
+    SubGridHaloExchange( const SubGridHaloExchange& );
+    SubGridHaloExchange& operator=( const SubGridHaloExchange& );
+
+    MPI_Comm comm_;                  //!< Duplicate of the given communicator, so that halo messages never match other traffic.
+    std::vector<int> recv_ranks_;
+    std::vector<int> recv_offsets_;  //!< Start of the cells from each of recv_ranks_ in recv_cells_, and the total.
+    std::vector<int> recv_cells_;    //!< Local indices of the ghost cells, grouped by owner.
+    std::vector<int> send_ranks_;
+    std::vector<int> send_offsets_;  //!< Start of the cells for each of send_ranks_ in send_cells_, and the total.
+    std::vector<int> send_cells_;
+    std::vector<double> recv_buffer_;
+    std::vector<double> send_buffer_;
+    std::vector<MPI_Request> requests_; //!< The receives, followed by the sends.
+    bool active_;
+};
+
+} // namespace equelle
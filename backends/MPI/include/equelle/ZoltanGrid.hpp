@@ -4,6 +4,11 @@
 #include <zoltan_cpp.h>
 #pragma GCC diagnostic pop
 
+#include <vector>
+#include <iosfwd>
+
+#include <opm/core/grid.h>
+
 namespace equelle {
 
 /**
@@ -24,9 +29,28 @@ struct zoltanReturns {
  *
  *  The intended usage is for the static-functions to be registered as callbacks to Zoltan
  *  and an Opm::UnstructuredGrid (passed via void*) is accepted as the first argument.
+ *  The exceptions are getWeightedCellList and getWeightedEdgeListMulti, which accept a Weights.
+ *
+ *  The graph has the cells as vertices, and an edge for every interior face.
  */
 class ZoltanGrid {
 public:
+    /** Weights of the cells and faces of a grid, for weighted partitioning. Empty vectors mean unit weights. */
+    struct Weights {
+        const UnstructuredGrid* grid;
+        std::vector<float> cells; //!< One weight per cell.
+        std::vector<float> faces; //!< One weight per face, given to the edge between its cells.
+    };
+
+    /// The number of faces of each cell, as an estimate of the work per cell.
+    static std::vector<float> faceCountWeights( const UnstructuredGrid& grid );
+
+    /// The area of each face.
+    static std::vector<float> faceAreaWeights( const UnstructuredGrid& grid );
+
+    /// Two-point transmissibility of each interior face with unit permeability: area over centroid distance.
+    static std::vector<float> transmissibilityWeights( const UnstructuredGrid& grid );
+
     static int getNumberOfObjects( void* data, int *ierr );
 
     static void getCellList( void *data, int sizeGID, int sizeLID,
@@ -42,6 +66,27 @@ public:
                                   int* num_edges, ZOLTAN_ID_PTR nbor_global_id,
                                   int *nbor_procs, int wgt_dim, float *ewgts, int *ierr);
 
+    /** As getCellList, with data a Weights. */
+    static void getWeightedCellList( void *data, int sizeGID, int sizeLID,
+                                     ZOLTAN_ID_PTR globalId, ZOLTAN_ID_PTR localId,
+                                     int wgt_dim, float *weights, int *ierr );
+
+    /** As getEdgeListMulti, with data a Weights. */
+    static void getWeightedEdgeListMulti( void *data, int num_gid_entries, int num_lid_entries, int num_obj,
+                                          ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids,
+                                          int* num_edges, ZOLTAN_ID_PTR nbor_global_id,
+                                          int *nbor_procs, int wgt_dim, float *ewgts, int *ierr);
+
+    /** The number of coordinates of the cell centroids, for the geometric methods (RCB, RIB). */
+    static int getNumberOfGeometryDimensions( void* data, int *ierr );
+
+    static void getGeometryMulti( void *data, int num_gid_entries, int num_lid_entries, int num_obj,
+                                  ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids,
+                                  int num_dim, double *geom_vec, int *ierr );
+
+    /** The owner of each cell, from the exports of node 0 when node 0 alone passed the grid to Zoltan. */
+    static std::vector<int> rank0CellOwners( const int numCells, const zoltanReturns& zr );
+
     /** Debug function to dump exports to a stream. */
     static void dumpRank0Exports( const int numCells, const zoltanReturns&, std::ostream& out );    
 };
@@ -0,0 +1,402 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/CartesianDecomposition.hpp"
+#include "equelle/mpiutils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+namespace equelle {
+
+CartesianDecomposition::CartesianDecomposition( std::array<int, 3> global_dims_, int dimensions_, int ghost_width,
+                                                std::array<int, 3> procs_, std::array<bool, 3> periodic_,
+                                                MPI_Comm parent )
+    : comm( MPI_COMM_NULL ), dimensions( dimensions_ ), global_dims( global_dims_ ), periodic( periodic_ )
+{
+    if ( dimensions != 2 && dimensions != 3 ) {
+        throw std::runtime_error( "Only 2D- and 3D-cartesian grids are supported." );
+    }
+    if ( dimensions == 2 ) {
+        global_dims[2] = 1;
+        procs_[2] = 1;
+        periodic[2] = false;
+    }
+    init( procs_, ghost_width, parent );
+}
+
+CartesianDecomposition::CartesianDecomposition( const Opm::parameter::ParameterGroup& param, MPI_Comm parent )
+    : comm( MPI_COMM_NULL ), global_dims{{1, 1, 1}}, periodic{{false, false, false}}
+{
+    dimensions = param.getDefault( "grid_dim", 2 );
+    if ( dimensions != 2 && dimensions != 3 ) {
+        throw std::runtime_error( "Only 2D- and 3D-cartesian grids are supported." );
+    }
+    param.get( "nx", global_dims[0] );
+    param.get( "ny", global_dims[1] );
+    if ( dimensions == 3 ) {
+        param.get( "nz", global_dims[2] );
+    }
+    std::array<int, 3> requested_procs = {{ param.getDefault( "procs_x", 0 ), param.getDefault( "procs_y", 0 ), 1 }};
+    periodic[0] = param.getDefault( "periodic_x", false );
+    periodic[1] = param.getDefault( "periodic_y", false );
+    if ( dimensions == 3 ) {
+        requested_procs[2] = param.getDefault( "procs_z", 0 );
+        periodic[2] = param.getDefault( "periodic_z", false );
+    }
+    init( requested_procs, param.getDefault( "ghost_width", 1 ), parent );
+}
+
+CartesianDecomposition::~CartesianDecomposition()
+{
+    if ( comm != MPI_COMM_NULL ) {
+        MPI_Comm_free( &comm );
+    }
+}
+
+void CartesianDecomposition::init( std::array<int, 3> requested_procs, int ghost_width, MPI_Comm parent )
+{
+    int parent_size;
+    MPI_SAFE_CALL( MPI_Comm_size( parent, &parent_size ) );
+    procs = requested_procs;
+    MPI_SAFE_CALL( MPI_Dims_create( parent_size, dimensions, procs.data() ) );
+
+    int periods[3] = { periodic[0], periodic[1], periodic[2] };
+    // Let MPI renumber the ranks to match the network topology.
+    MPI_SAFE_CALL( MPI_Cart_create( parent, dimensions, procs.data(), periods, 1, &comm ) );
+    MPI_SAFE_CALL( MPI_Comm_rank( comm, &rank ) );
+    MPI_SAFE_CALL( MPI_Comm_size( comm, &size ) );
+    coords = {{0, 0, 0}};
+    MPI_SAFE_CALL( MPI_Cart_coords( comm, rank, dimensions, coords.data() ) );
+
+    std::array<int, 3> local_dims;
+    blockOf( coords, local_dims, offset );
+    for ( int d = 0; d < dimensions; ++d ) {
+        if ( local_dims[d] < ghost_width ) {
+            std::stringstream ss;
+            ss << "The grid is too small to be split over " << procs[d] << " ranks in dimension " << d
+               << ": blocks must be at least ghost_width = " << ghost_width << " cells wide.";
+            throw std::runtime_error( ss.str() );
+        }
+    }
+    if ( dimensions == 3 ) {
+        grid = CartesianGrid( std::make_tuple( local_dims[0], local_dims[1], local_dims[2] ), ghost_width );
+    } else {
+        grid = CartesianGrid( std::make_tuple( local_dims[0], local_dims[1] ), ghost_width );
+    }
+}
+
+void CartesianDecomposition::blockOf( const std::array<int, 3>& block_coords,
+                                      std::array<int, 3>& dims, std::array<int, 3>& start ) const
+{
+    // The first global_dims % procs blocks get one extra cell.
+    for ( int d = 0; d < 3; ++d ) {
+        const int base = global_dims[d] / procs[d];
+        const int extra = global_dims[d] % procs[d];
+        dims[d] = base + ( block_coords[d] < extra ? 1 : 0 );
+        start[d] = block_coords[d] * base + std::min( block_coords[d], extra );
+    }
+}
+
+int CartesianDecomposition::neighbour( int dx, int dy, int dz ) const
+{
+    const int dir[3] = { dx, dy, dz };
+    std::array<int, 3> c = coords;
+    for ( int d = 0; d < 3; ++d ) {
+        c[d] += dir[d];
+        if ( c[d] < 0 || c[d] >= procs[d] ) {
+            if ( !periodic[d] ) {
+                return MPI_PROC_NULL;
+            }
+            c[d] = ( c[d] + procs[d] ) % procs[d];
+        }
+    }
+    int nbr;
+    MPI_SAFE_CALL( MPI_Cart_rank( comm, c.data(), &nbr ) );
+    return nbr;
+}
+
+bool CartesianDecomposition::isOnDomainBoundary( CartesianGrid::Face side ) const
+{
+    const int d = static_cast<int>( side ) / 2;
+    const bool positive = ( static_cast<int>( side ) % 2 ) == 1;
+    if ( d >= dimensions || periodic[d] ) {
+        return false;
+    }
+    return coords[d] == ( positive ? procs[d] - 1 : 0 );
+}
+
+void CartesianDecomposition::applyBoundaryCondition( StencilCollOfScalar& coll, CartesianGrid::Face side,
+                                                     BoundaryCondition bc, double value ) const
+{
+    if ( bc == BoundaryCondition::Periodic ) {
+        throw std::runtime_error( "Periodic boundaries of a decomposed grid are set up with the periodic "
+                                  "argument of CartesianDecomposition, and filled by the halo exchange." );
+    }
+    if ( isOnDomainBoundary( side ) ) {
+        grid.applyBoundaryCondition( coll, side, bc, value );
+    }
+}
+
+std::vector<double> CartesianDecomposition::gatherInterior( const StencilCollOfScalar& coll, int root ) const
+{
+    const std::array<int, 3>& n = grid.cartdims;
+    std::vector<double> local;
+    local.reserve( grid.number_of_cells );
+    for ( int k = 0; k < n[2]; ++k ) {
+        for ( int j = 0; j < n[1]; ++j ) {
+            const double* row = coll.data.data() + grid.cellIndex( 0, j, k );
+            local.insert( local.end(), row, row + n[0] );
+        }
+    }
+
+    std::vector<int> counts;
+    std::vector<int> displs;
+    std::vector<double> packed;
+    if ( rank == root ) {
+        counts.resize( size );
+    }
+    const int count = local.size();
+    MPI_SAFE_CALL( MPI_Gather( &count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, comm ) );
+    if ( rank == root ) {
+        displs.resize( size, 0 );
+        for ( int r = 1; r < size; ++r ) {
+            displs[r] = displs[r-1] + counts[r-1];
+        }
+        packed.resize( displs.back() + counts.back() );
+    }
+    MPI_SAFE_CALL( MPI_Gatherv( local.data(), count, MPI_DOUBLE,
+                                packed.data(), counts.data(), displs.data(), MPI_DOUBLE, root, comm ) );
+
+    std::vector<double> global;
+    if ( rank != root ) {
+        return global;
+    }
+    global.resize( global_dims[0] * global_dims[1] * global_dims[2] );
+    for ( int r = 0; r < size; ++r ) {
+        std::array<int, 3> c = {{0, 0, 0}};
+        MPI_SAFE_CALL( MPI_Cart_coords( comm, r, dimensions, c.data() ) );
+        std::array<int, 3> dims;
+        std::array<int, 3> start;
+        blockOf( c, dims, start );
+        const double* src = packed.data() + displs[r];
+        for ( int k = 0; k < dims[2]; ++k ) {
+            for ( int j = 0; j < dims[1]; ++j ) {
+                const int pos = ( ( start[2] + k ) * global_dims[1] + start[1] + j ) * global_dims[0] + start[0];
+                std::copy( src, src + dims[0], global.begin() + pos );
+                src += dims[0];
+            }
+        }
+    }
+    return global;
+}
+
+void CartesianDecomposition::scatterInterior( const std::vector<double>& global, StencilCollOfScalar& coll, int root ) const
+{
+    std::vector<int> counts;
+    std::vector<int> displs;
+    std::vector<double> packed;
+    if ( rank == root ) {
+        if ( int( global.size() ) != global_dims[0] * global_dims[1] * global_dims[2] ) {
+            throw std::runtime_error( "scatterInterior() was given a collection of the wrong size." );
+        }
+        counts.resize( size );
+        displs.resize( size );
+        packed.reserve( global.size() );
+        for ( int r = 0; r < size; ++r ) {
+            std::array<int, 3> c = {{0, 0, 0}};
+            MPI_SAFE_CALL( MPI_Cart_coords( comm, r, dimensions, c.data() ) );
+            std::array<int, 3> dims;
+            std::array<int, 3> start;
+            blockOf( c, dims, start );
+            displs[r] = packed.size();
+            counts[r] = dims[0] * dims[1] * dims[2];
+            for ( int k = 0; k < dims[2]; ++k ) {
+                for ( int j = 0; j < dims[1]; ++j ) {
+                    const int pos = ( ( start[2] + k ) * global_dims[1] + start[1] + j ) * global_dims[0] + start[0];
+                    packed.insert( packed.end(), global.begin() + pos, global.begin() + pos + dims[0] );
+                }
+            }
+        }
+    }
+
+    std::vector<double> local( grid.number_of_cells );
+    MPI_SAFE_CALL( MPI_Scatterv( packed.data(), counts.data(), displs.data(), MPI_DOUBLE,
+                                 local.data(), local.size(), MPI_DOUBLE, root, comm ) );
+
+    const std::array<int, 3>& n = grid.cartdims;
+    std::vector<double>::const_iterator src = local.begin();
+    for ( int k = 0; k < n[2]; ++k ) {
+        for ( int j = 0; j < n[1]; ++j ) {
+            std::copy( src, src + n[0], coll.data.begin() + grid.cellIndex( 0, j, k ) );
+            src += n[0];
+        }
+    }
+}
+
+
+
+namespace {
+
+    /// Tag of the message sent towards the neighbour at (dx, dy, dz).
+    int directionTag( const int dir[3] )
+    {
+        return ( dir[0] + 1 ) + 3*( dir[1] + 1 ) + 9*( dir[2] + 1 );
+    }
+
+} // anonymous namespace
+
+
+CartesianHaloExchange::CartesianHaloExchange( const CartesianDecomposition& decomposition )
+    : decomposition_( decomposition ), active_( nullptr )
+{
+    const CartesianGrid& grid = decomposition.grid;
+    const int dims = decomposition.dimensions;
+    const int g = grid.ghost_width;
+
+    // Subarrays are given with the slowest dimension first.
+    int sizes[3];
+    for ( int d = 0; d < dims; ++d ) {
+        sizes[dims - 1 - d] = grid.cartdims[d] + 2*g;
+    }
+
+    for ( int dz = ( dims == 3 ? -1 : 0 ); dz <= ( dims == 3 ? 1 : 0 ); ++dz ) {
+        for ( int dy = -1; dy <= 1; ++dy ) {
+            for ( int dx = -1; dx <= 1; ++dx ) {
+                const int dir[3] = { dx, dy, dz };
+                if ( dx == 0 && dy == 0 && dz == 0 ) {
+                    continue;
+                }
+                const int nbr = decomposition.neighbour( dx, dy, dz );
+                if ( nbr == MPI_PROC_NULL ) {
+                    continue;
+                }
+                int subsizes[3];
+                int send_starts[3];
+                int recv_starts[3];
+                for ( int d = 0; d < dims; ++d ) {
+                    const int n = grid.cartdims[d];
+                    const int s = dims - 1 - d;
+                    if ( dir[d] == 0 ) {
+                        // Ghost cells on a side of the global domain are sent along with the interior
+                        // cells, since no diagonal neighbour exists to provide them.
+                        const bool lower = decomposition.isOnDomainBoundary( static_cast<CartesianGrid::Face>( 2*d ) );
+                        const bool upper = decomposition.isOnDomainBoundary( static_cast<CartesianGrid::Face>( 2*d + 1 ) );
+                        send_starts[s] = recv_starts[s] = lower ? 0 : g;
+                        subsizes[s] = n + ( lower ? g : 0 ) + ( upper ? g : 0 );
+                    } else {
+                        subsizes[s] = g;
+                        send_starts[s] = dir[d] < 0 ? g : n;
+                        recv_starts[s] = dir[d] < 0 ? 0 : n + g;
+                    }
+                }
+                MPI_Datatype send_type;
+                MPI_Datatype recv_type;
+                MPI_SAFE_CALL( MPI_Type_create_subarray( dims, sizes, subsizes, send_starts, MPI_ORDER_C, MPI_DOUBLE, &send_type ) );
+                MPI_SAFE_CALL( MPI_Type_create_subarray( dims, sizes, subsizes, recv_starts, MPI_ORDER_C, MPI_DOUBLE, &recv_type ) );
+                MPI_SAFE_CALL( MPI_Type_commit( &send_type ) );
+                MPI_SAFE_CALL( MPI_Type_commit( &recv_type ) );
+                send_types_.push_back( send_type );
+                recv_types_.push_back( recv_type );
+
+                // The neighbour sends the cells we receive towards (-dx, -dy, -dz).
+                const int opposite[3] = { -dx, -dy, -dz };
+                neighbours_.push_back( nbr );
+                send_tags_.push_back( directionTag( dir ) );
+                recv_tags_.push_back( directionTag( opposite ) );
+            }
+        }
+    }
+
+    // Cells at least ghost_width cells inside the local block do not read ghost cells.
+    const std::array<int, 3>& n = grid.cartdims;
+    const int kg = dims == 3 ? g : 0;
+    const bool has_interior = n[0] > 2*g && n[1] > 2*g && ( dims == 2 || n[2] > 2*g );
+    if ( has_interior ) {
+        interior_.push_back( CartesianGrid::CellRange( g, n[0] - g, g, n[1] - g, kg, n[2] - kg ) );
+        // The shell around it: bottom and top layers, then front and back rows, then left and right columns.
+        if ( dims == 3 ) {
+            shell_.push_back( CartesianGrid::CellRange( 0, n[0], 0, n[1], 0, g ) );
+            shell_.push_back( CartesianGrid::CellRange( 0, n[0], 0, n[1], n[2] - g, n[2] ) );
+        }
+        shell_.push_back( CartesianGrid::CellRange( 0, n[0], 0, g, kg, n[2] - kg ) );
+        shell_.push_back( CartesianGrid::CellRange( 0, n[0], n[1] - g, n[1], kg, n[2] - kg ) );
+        shell_.push_back( CartesianGrid::CellRange( 0, g, g, n[1] - g, kg, n[2] - kg ) );
+        shell_.push_back( CartesianGrid::CellRange( n[0] - g, n[0], g, n[1] - g, kg, n[2] - kg ) );
+    } else {
+        shell_.push_back( CartesianGrid::CellRange( 0, n[0], 0, n[1], 0, n[2] ) );
+    }
+}
+
+CartesianHaloExchange::~CartesianHaloExchange()
+{
+    for ( RequestSet& set : request_sets_ ) {
+        for ( MPI_Request& request : set.requests ) {
+            MPI_Request_free( &request );
+        }
+    }
+    for ( MPI_Datatype& type : send_types_ ) {
+        MPI_Type_free( &type );
+    }
+    for ( MPI_Datatype& type : recv_types_ ) {
+        MPI_Type_free( &type );
+    }
+}
+
+CartesianHaloExchange::RequestSet& CartesianHaloExchange::requestsFor( StencilCollOfScalar& coll )
+{
+    if ( int( coll.data.size() ) != decomposition_.grid.number_of_cells_and_ghost_cells ) {
+        throw std::runtime_error( "CartesianHaloExchange: the collection is not on the local grid of the decomposition." );
+    }
+    double* data = coll.data.data();
+    for ( RequestSet& set : request_sets_ ) {
+        if ( set.data == data ) {
+            return set;
+        }
+    }
+
+    RequestSet set;
+    set.data = data;
+    set.requests.resize( 2*neighbours_.size() );
+    for ( size_t i = 0; i < neighbours_.size(); ++i ) {
+        MPI_SAFE_CALL( MPI_Recv_init( data, 1, recv_types_[i], neighbours_[i], recv_tags_[i],
+                                      decomposition_.comm, &set.requests[i] ) );
+        MPI_SAFE_CALL( MPI_Send_init( data, 1, send_types_[i], neighbours_[i], send_tags_[i],
+                                      decomposition_.comm, &set.requests[neighbours_.size() + i] ) );
+    }
+    request_sets_.push_back( set );
+    return request_sets_.back();
+}
+
+void CartesianHaloExchange::start( StencilCollOfScalar& coll )
+{
+    if ( active_ ) {
+        throw std::logic_error( "CartesianHaloExchange::start() called twice without finish()." );
+    }
+    RequestSet& set = requestsFor( coll );
+    if ( !set.requests.empty() ) {
+        MPI_SAFE_CALL( MPI_Startall( set.requests.size(), set.requests.data() ) );
+    }
+    active_ = &set;
+}
+
+void CartesianHaloExchange::finish()
+{
+    if ( !active_ ) {
+        throw std::logic_error( "CartesianHaloExchange::finish() called without start()." );
+    }
+    if ( !active_->requests.empty() ) {
+        MPI_SAFE_CALL( MPI_Waitall( active_->requests.size(), active_->requests.data(), MPI_STATUSES_IGNORE ) );
+    }
+    active_ = nullptr;
+}
+
+void CartesianHaloExchange::exchange( StencilCollOfScalar& coll )
+{
+    start( coll );
+    finish();
+}
+
+} // namespace equelle
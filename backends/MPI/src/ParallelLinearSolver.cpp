@@ -0,0 +1,158 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/ParallelLinearSolver.hpp"
+#include "equelle/SubGridHaloExchange.hpp"
+#include "equelle/mpiutils.hpp"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace equelle {
+
+ParallelLinearSolver::ParallelLinearSolver( const SubGrid& subGrid, SubGridHaloExchange& haloExchange,
+                                            const Opm::parameter::ParameterGroup& param, MPI_Comm comm )
+    : subGrid_( subGrid ),
+      haloExchange_( haloExchange ),
+      comm_( comm ),
+      num_owned_( subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells ),
+      tolerance_( param.getDefault( "linsolver_residual_tolerance", 1e-8 ) ),
+      max_iterations_( param.getDefault( "linsolver_max_iterations", 1000 ) )
+{
+}
+
+void ParallelLinearSolver::allSum( double* values, int count ) const
+{
+    MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, values, count, MPI_DOUBLE, MPI_SUM, comm_ ) );
+}
+
+double ParallelLinearSolver::dot( const Vector& a, const Vector& b ) const
+{
+    double sum = a.head( num_owned_ ).matrix().dot( b.head( num_owned_ ).matrix() );
+    allSum( &sum, 1 );
+    return sum;
+}
+
+double ParallelLinearSolver::norm( const Vector& a ) const
+{
+    return std::sqrt( dot( a, a ) );
+}
+
+void ParallelLinearSolver::multiply( const Matrix& A, Vector& x, Vector& y )
+{
+    haloExchange_.exchange( x.data() );
+    y.head( num_owned_ ) = ( A * x.matrix() ).array();
+}
+
+void ParallelLinearSolver::precondition( const Vector& r, Vector& z ) const
+{
+    if ( num_owned_ > 0 ) {
+        z.head( num_owned_ ) = ilu_.solve( r.head( num_owned_ ).matrix() ).array();
+    }
+}
+
+ParallelLinearSolver::Report ParallelLinearSolver::solve( const Matrix& A, const Vector& b, Vector& x )
+{
+    const int num_local = subGrid_.cell_local_to_global.size();
+    if ( A.rows() != num_owned_ || A.cols() != num_local || b.size() != num_owned_ || x.size() != num_local ) {
+        throw std::runtime_error( "ParallelLinearSolver::solve() got sizes that do not match the subgrid." );
+    }
+
+    // Block Jacobi: the couplings to the ghost cells are left out of the preconditioner.
+    if ( num_owned_ > 0 ) {
+        const Eigen::SparseMatrix<double> owned_block = A.leftCols( num_owned_ );
+        ilu_.compute( owned_block );
+        if ( ilu_.info() != Eigen::Success ) {
+            throw std::runtime_error( "ParallelLinearSolver: incomplete LU factorisation failed." );
+        }
+    }
+
+    // Preconditioned BiCGStab. Vectors that are multiplied by A have room for the ghost cells.
+    Vector r( num_local );
+    Vector v = Vector::Zero( num_local );
+    Vector p = Vector::Zero( num_local );
+    Vector phat = Vector::Zero( num_local );
+    Vector shat = Vector::Zero( num_local );
+    Vector s( num_local );
+    Vector t( num_local );
+
+    multiply( A, x, r );
+    r.head( num_owned_ ) = b - r.head( num_owned_ );
+    r.tail( num_local - num_owned_ ).setZero();
+
+    Report report;
+    report.iterations = 0;
+    report.residual_norm = norm( r );
+    const double target = tolerance_ * norm( Vector( b ) );
+    report.converged = report.residual_norm <= target;
+
+    // The shadow residual r0 is replaced by the current residual when BiCGStab breaks down,
+    // which happens when an inner product with r0 vanishes relative to the norms of its factors.
+    const double eps = std::numeric_limits<double>::epsilon();
+    Vector r0 = r;
+    double r0_norm = report.residual_norm;
+    bool restarted = true;
+    double rho = 1.0;
+    double alpha = 1.0;
+    double omega = 1.0;
+    auto restart = [&]() {
+        r0 = r;
+        r0_norm = report.residual_norm;
+        restarted = true;
+        rho = alpha = omega = 1.0;
+        v.setZero();
+        p.setZero();
+    };
+    while ( !report.converged && report.iterations < max_iterations_ ) {
+        ++report.iterations;
+        const double rho_new = dot( r0, r );
+        if ( std::abs( rho_new ) <= eps * r0_norm * report.residual_norm ) {
+            if ( restarted ) {
+                break;
+            }
+            restart();
+            continue;
+        }
+        const double beta = ( rho_new / rho ) * ( alpha / omega );
+        p.head( num_owned_ ) = r.head( num_owned_ ) + beta * ( p.head( num_owned_ ) - omega * v.head( num_owned_ ) );
+        precondition( p, phat );
+        multiply( A, phat, v );
+        double r0v_vv[2] = { r0.head( num_owned_ ).matrix().dot( v.head( num_owned_ ).matrix() ),
+                             v.head( num_owned_ ).matrix().squaredNorm() };
+        allSum( r0v_vv, 2 );
+        if ( std::abs( r0v_vv[0] ) <= eps * r0_norm * std::sqrt( r0v_vv[1] ) ) {
+            if ( restarted ) {
+                break;
+            }
+            restart();
+            continue;
+        }
+        alpha = rho_new / r0v_vv[0];
+        s.head( num_owned_ ) = r.head( num_owned_ ) - alpha * v.head( num_owned_ );
+
+        precondition( s, shat );
+        multiply( A, shat, t );
+        // Both inner products of the step length in one reduction.
+        double ts_tt[2] = { t.head( num_owned_ ).matrix().dot( s.head( num_owned_ ).matrix() ),
+                            t.head( num_owned_ ).matrix().squaredNorm() };
+        allSum( ts_tt, 2 );
+        omega = ts_tt[1] > 0.0 ? ts_tt[0] / ts_tt[1] : 0.0;
+
+        x.head( num_owned_ ) += alpha * phat.head( num_owned_ ) + omega * shat.head( num_owned_ );
+        r.head( num_owned_ ) = s.head( num_owned_ ) - omega * t.head( num_owned_ );
+        report.residual_norm = norm( r );
+        report.converged = report.residual_norm <= target;
+        if ( omega == 0.0 ) {
+            break;
+        }
+        rho = rho_new;
+        restarted = false;
+    }
+
+    haloExchange_.exchange( x.data() );
+    return report;
+}
+
+} // namespace equelle
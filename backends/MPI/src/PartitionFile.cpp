@@ -0,0 +1,68 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/PartitionFile.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace equelle {
+
+namespace {
+
+    const std::int32_t magic = 0x50515145; // "EQQP" in little endian.
+
+} // anonymous namespace
+
+void PartitionFile::write( const std::string& filename, const std::vector<int>& cellOwners, int numParts )
+{
+    for ( int owner : cellOwners ) {
+        if ( owner < 0 || owner >= numParts ) {
+            std::stringstream ss;
+            ss << "Cell owner " << owner << " is not one of the " << numParts << " parts.";
+            throw std::runtime_error( ss.str() );
+        }
+    }
+
+    std::ofstream out( filename.c_str(), std::ios::binary );
+    const std::int32_t header[3] = { magic, std::int32_t( cellOwners.size() ), numParts };
+    const std::vector<std::int32_t> owners( cellOwners.begin(), cellOwners.end() );
+    out.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+    out.write( reinterpret_cast<const char*>( owners.data() ), owners.size() * sizeof( std::int32_t ) );
+    if ( !out ) {
+        throw std::runtime_error( "Could not write the partition file " + filename + "." );
+    }
+}
+
+std::vector<int> PartitionFile::read( const std::string& filename, int& numParts )
+{
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    if ( !in ) {
+        throw std::runtime_error( "Could not open the partition file " + filename + "." );
+    }
+
+    std::int32_t header[3];
+    in.read( reinterpret_cast<char*>( header ), sizeof( header ) );
+    if ( !in || header[0] != magic || header[1] < 0 || header[2] < 1 ) {
+        throw std::runtime_error( filename + " is not a partition file." );
+    }
+
+    std::vector<std::int32_t> owners( header[1] );
+    in.read( reinterpret_cast<char*>( owners.data() ), owners.size() * sizeof( std::int32_t ) );
+    if ( !in ) {
+        throw std::runtime_error( "The partition file " + filename + " is truncated." );
+    }
+
+    numParts = header[2];
+    for ( std::int32_t owner : owners ) {
+        if ( owner < 0 || owner >= numParts ) {
+            throw std::runtime_error( "The partition file " + filename + " has a cell owner outside its parts." );
+        }
+    }
+    return std::vector<int>( owners.begin(), owners.end() );
+}
+
+} // namespace equelle
@@ -1,6 +1,11 @@
 #include "equelle/RuntimeMPI.hpp"
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
 #include <mpi.h>
 
@@ -9,10 +14,12 @@
 #pragma GCC diagnostic pop
 
 #include <opm/core/grid/GridManager.hpp>
-#include <boost/iterator/counting_iterator.hpp>
 #include "equelle/EquelleRuntimeCPU.hpp"
 #include "equelle/mpiutils.hpp"
 #include "equelle/SubGridBuilder.hpp"
+#include "equelle/SubGridHaloExchange.hpp"
+#include "equelle/ParallelLinearSolver.hpp"
+#include "equelle/PartitionFile.hpp"
 
 
 namespace equelle {
@@ -23,6 +30,284 @@ std::string logfilename() {
     return ss.str();
 }
 
+namespace {
+
+    double reductionIdentity( RuntimeMPI::ReduceOperation op )
+    {
+        switch ( op ) {
+        case RuntimeMPI::Min:  return std::numeric_limits<double>::infinity();
+        case RuntimeMPI::Max:  return -std::numeric_limits<double>::infinity();
+        case RuntimeMPI::Sum:  return 0.0;
+        case RuntimeMPI::Prod: return 1.0;
+        }
+        throw std::logic_error( "Unknown reduction operation." );
+    }
+
+    double combine( RuntimeMPI::ReduceOperation op, double a, double b )
+    {
+        switch ( op ) {
+        case RuntimeMPI::Min:  return std::min( a, b );
+        case RuntimeMPI::Max:  return std::max( a, b );
+        case RuntimeMPI::Sum:  return a + b;
+        case RuntimeMPI::Prod: return a * b;
+        }
+        throw std::logic_error( "Unknown reduction operation." );
+    }
+
+    /// MPI_User_function for entries of (operation, value), so that mixed operations fit in one MPI_Allreduce.
+    void combinePartialReductions( void* invec, void* inoutvec, int* len, MPI_Datatype* )
+    {
+        const double* in = static_cast<const double*>( invec );
+        double* inout = static_cast<double*>( inoutvec );
+        for ( int i = 0; i < *len; ++i ) {
+            const auto op = static_cast<RuntimeMPI::ReduceOperation>( int( inout[2*i] ) );
+            inout[2*i + 1] = combine( op, in[2*i + 1], inout[2*i + 1] );
+        }
+    }
+
+    /// Throws the same exception on all nodes if any of them failed. Collective.
+    void throwIfAnyFailed( bool failed, const std::string& message )
+    {
+        int anyFailed = failed;
+        MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &anyFailed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD ) );
+        if ( anyFailed ) {
+            OPM_THROW( std::runtime_error, message );
+        }
+    }
+
+    /// Reads a partition file on node 0, and checks it against the grid and the number of nodes. Collective.
+    std::vector<int> readPartitionOnRoot( const std::string& filename, const UnstructuredGrid* grid )
+    {
+        std::vector<int> cellOwners;
+        std::string error;
+        if ( getMPIRank() == 0 ) {
+            try {
+                int numParts = 0;
+                cellOwners = PartitionFile::read( filename, numParts );
+                if ( numParts != getMPISize() ) {
+                    std::stringstream ss;
+                    ss << "The partition file " << filename << " has " << numParts << " parts, but there are "
+                       << getMPISize() << " nodes.";
+                    error = ss.str();
+                } else if ( int( cellOwners.size() ) != grid->number_of_cells ) {
+                    std::stringstream ss;
+                    ss << "The partition file " << filename << " has " << cellOwners.size() << " cells, but the grid has "
+                       << grid->number_of_cells << ".";
+                    error = ss.str();
+                }
+            } catch ( const std::exception& e ) {
+                error = e.what();
+            }
+        }
+        throwIfAnyFailed( !error.empty(), getMPIRank() == 0 ? error : "Node 0 could not use the partition file " + filename + "." );
+        return cellOwners;
+    }
+
+    /// Reads a whitespace separated text file on node 0. Returns false on the other nodes, or if the file is missing.
+    template <class T>
+    bool readOnRoot( const std::string& filename, std::vector<T>& data )
+    {
+        if ( getMPIRank() != 0 ) {
+            return false;
+        }
+        std::ifstream is( filename.c_str() );
+        if ( !is ) {
+            return false;
+        }
+        std::istream_iterator<T> beg( is );
+        std::istream_iterator<T> end;
+        data.assign( beg, end );
+        return true;
+    }
+
+    /// Gathers the global indices of every node on node 0, with the offsets of each node and the total last.
+    void gatherIndicesOnRoot( const std::vector<int>& globalIds, std::vector<int>& allIds, std::vector<int>& offsets )
+    {
+        const int size = getMPISize();
+        int count = globalIds.size();
+        std::vector<int> counts( size );
+        MPI_SAFE_CALL( MPI_Gather( &count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD ) );
+        offsets.assign( size + 1, 0 );
+        for ( int r = 0; r < size; ++r ) {
+            offsets[r + 1] = offsets[r] + counts[r];
+        }
+        allIds.resize( offsets.back() );
+        MPI_SAFE_CALL( MPI_Gatherv( const_cast<int*>( globalIds.data() ), count, MPI_INT,
+                                    allIds.data(), counts.data(), offsets.data(), MPI_INT, 0, MPI_COMM_WORLD ) );
+    }
+
+    /**
+     * Sends every node the entries of the global array values, which is only read on node 0,
+     * at its own global indices. Node 0 reads the file, and the other nodes only ever hold their own entries.
+     */
+    std::vector<double> scatterFromRoot( const std::vector<double>& values, const std::vector<int>& globalIds,
+                                         const std::string& filename )
+    {
+        int maxId = globalIds.empty() ? -1 : *std::max_element( globalIds.begin(), globalIds.end() );
+        MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &maxId, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD ) );
+        throwIfAnyFailed( getMPIRank() == 0 && int( values.size() ) <= maxId,
+                          "Too few values in " + filename + "." );
+
+        std::vector<int> allIds, offsets;
+        gatherIndicesOnRoot( globalIds, allIds, offsets );
+        std::vector<double> packed( allIds.size() );
+        for ( size_t i = 0; i < allIds.size(); ++i ) {
+            packed[i] = values[ allIds[i] ];
+        }
+
+        std::vector<int> counts( offsets.size() - 1 );
+        for ( size_t r = 0; r < counts.size(); ++r ) {
+            counts[r] = offsets[r + 1] - offsets[r];
+        }
+        std::vector<double> local( globalIds.size() );
+        MPI_SAFE_CALL( MPI_Scatterv( packed.data(), counts.data(), offsets.data(), MPI_DOUBLE,
+                                     local.data(), local.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD ) );
+        return local;
+    }
+
+    /**
+     * Reads the entries at globalIds of a file of raw doubles in native byte order, in the global enumeration.
+     * Every node reads only its own entries, through a file view with MPI-IO.
+     */
+    std::vector<double> readBinaryWithMPIIO( const std::string& filename, const std::vector<int>& globalIds )
+    {
+        MPI_File file;
+        const int err = MPI_File_open( MPI_COMM_WORLD, const_cast<char*>( filename.c_str() ), MPI_MODE_RDONLY, MPI_INFO_NULL, &file );
+        if ( err != MPI_SUCCESS ) {
+            OPM_THROW( std::runtime_error, "Could not find file " << filename );
+        }
+
+        // Reading past the end of a file view is not reported reliably, so check the size first.
+        MPI_Offset bytes;
+        MPI_SAFE_CALL( MPI_File_get_size( file, &bytes ) );
+        // All nodes agree on the outcome before closing, since closing the file is collective.
+        int maxId = globalIds.empty() ? -1 : *std::max_element( globalIds.begin(), globalIds.end() );
+        MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &maxId, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD ) );
+        if ( maxId >= bytes / MPI_Offset( sizeof( double ) ) ) {
+            MPI_SAFE_CALL( MPI_File_close( &file ) );
+            OPM_THROW( std::runtime_error, "Too few values in " << filename << "." );
+        }
+
+        // File views must be in strictly increasing order.
+        std::vector<int> displacements( globalIds );
+        std::sort( displacements.begin(), displacements.end() );
+        displacements.erase( std::unique( displacements.begin(), displacements.end() ), displacements.end() );
+
+        MPI_Datatype view;
+        MPI_SAFE_CALL( MPI_Type_create_indexed_block( displacements.size(), 1, displacements.data(), MPI_DOUBLE, &view ) );
+        MPI_SAFE_CALL( MPI_Type_commit( &view ) );
+        MPI_SAFE_CALL( MPI_File_set_view( file, 0, MPI_DOUBLE, view, const_cast<char*>( "native" ), MPI_INFO_NULL ) );
+
+        std::vector<double> sorted( displacements.size() );
+        MPI_SAFE_CALL( MPI_File_read_all( file, sorted.data(), sorted.size(), MPI_DOUBLE, MPI_STATUS_IGNORE ) );
+        MPI_SAFE_CALL( MPI_File_close( &file ) );
+        MPI_SAFE_CALL( MPI_Type_free( &view ) );
+
+        std::vector<double> local( globalIds.size() );
+        for ( size_t i = 0; i < globalIds.size(); ++i ) {
+            const auto it = std::lower_bound( displacements.begin(), displacements.end(), globalIds[i] );
+            local[i] = sorted[ it - displacements.begin() ];
+        }
+        return local;
+    }
+
+    /**
+     * Writes values to their global indices in a file of raw doubles in native byte order, holding
+     * totalSize values. Every node writes its own entries, through a file view with MPI-IO.
+     * The global indices must be unique across all nodes.
+     */
+    void writeBinaryWithMPIIO( const std::string& filename, const std::vector<int>& globalIds,
+                               const std::vector<double>& values, int totalSize )
+    {
+        MPI_File file;
+        const int err = MPI_File_open( MPI_COMM_WORLD, const_cast<char*>( filename.c_str() ),
+                                       MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file );
+        if ( err != MPI_SUCCESS ) {
+            OPM_THROW( std::runtime_error, "Failed to open " << filename );
+        }
+        // Truncates what an earlier run may have left.
+        MPI_SAFE_CALL( MPI_File_set_size( file, MPI_Offset( totalSize ) * sizeof( double ) ) );
+
+        // File views must be in increasing order.
+        std::vector<int> order( globalIds.size() );
+        for ( size_t i = 0; i < order.size(); ++i ) {
+            order[i] = i;
+        }
+        std::sort( order.begin(), order.end(), [&globalIds]( int a, int b ) { return globalIds[a] < globalIds[b]; } );
+        std::vector<int> displacements( order.size() );
+        std::vector<double> sorted( order.size() );
+        for ( size_t i = 0; i < order.size(); ++i ) {
+            displacements[i] = globalIds[ order[i] ];
+            sorted[i] = values[ order[i] ];
+        }
+
+        MPI_Datatype view;
+        MPI_SAFE_CALL( MPI_Type_create_indexed_block( displacements.size(), 1, displacements.data(), MPI_DOUBLE, &view ) );
+        MPI_SAFE_CALL( MPI_Type_commit( &view ) );
+        MPI_SAFE_CALL( MPI_File_set_view( file, 0, MPI_DOUBLE, view, const_cast<char*>( "native" ), MPI_INFO_NULL ) );
+        MPI_SAFE_CALL( MPI_File_write_all( file, sorted.data(), sorted.size(), MPI_DOUBLE, MPI_STATUS_IGNORE ) );
+        MPI_SAFE_CALL( MPI_File_close( &file ) );
+        MPI_SAFE_CALL( MPI_Type_free( &view ) );
+    }
+
+    /**
+     * Gathers values on node 0, in the global enumeration. The global indices must be unique across all nodes,
+     * and cover 0 to the total count. Returns an empty vector on the other nodes.
+     */
+    std::vector<double> gatherOnRoot( const std::vector<int>& globalIds, const std::vector<double>& values )
+    {
+        std::vector<int> allIds, offsets;
+        gatherIndicesOnRoot( globalIds, allIds, offsets );
+
+        std::vector<int> counts( offsets.size() - 1 );
+        for ( size_t r = 0; r < counts.size(); ++r ) {
+            counts[r] = offsets[r + 1] - offsets[r];
+        }
+        std::vector<double> packed( allIds.size() );
+        MPI_SAFE_CALL( MPI_Gatherv( const_cast<double*>( values.data() ), values.size(), MPI_DOUBLE,
+                                    packed.data(), counts.data(), offsets.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD ) );
+
+        std::vector<double> global( allIds.size() );
+        for ( size_t i = 0; i < allIds.size(); ++i ) {
+            global[ allIds[i] ] = packed[i];
+        }
+        return global;
+    }
+
+    /**
+     * Returns the global indices in globalIds that are also in the list ids, which is only read on node 0.
+     * Node 0 intersects the list with the indices of every node, so no node searches the whole list.
+     */
+    std::vector<int> scatterSubsetFromRoot( std::vector<int> ids, std::vector<int> globalIds )
+    {
+        std::sort( globalIds.begin(), globalIds.end() );
+        std::vector<int> allIds, offsets;
+        gatherIndicesOnRoot( globalIds, allIds, offsets );
+
+        const int size = getMPISize();
+        std::vector<int> subsets;
+        std::vector<int> counts( size, 0 );
+        std::vector<int> subsetOffsets( size + 1, 0 );
+        if ( getMPIRank() == 0 ) {
+            std::sort( ids.begin(), ids.end() );
+            for ( int r = 0; r < size; ++r ) {
+                std::set_intersection( ids.begin(), ids.end(), allIds.begin() + offsets[r], allIds.begin() + offsets[r + 1],
+                                       std::back_inserter( subsets ) );
+                subsetOffsets[r + 1] = subsets.size();
+                counts[r] = subsetOffsets[r + 1] - subsetOffsets[r];
+            }
+        }
+
+        int count;
+        MPI_SAFE_CALL( MPI_Scatter( counts.data(), 1, MPI_INT, &count, 1, MPI_INT, 0, MPI_COMM_WORLD ) );
+        std::vector<int> subset( count );
+        MPI_SAFE_CALL( MPI_Scatterv( subsets.data(), counts.data(), subsetOffsets.data(), MPI_INT,
+                                     subset.data(), count, MPI_INT, 0, MPI_COMM_WORLD ) );
+        return subset;
+    }
+
+} // anonymous namespace
+
 void RuntimeMPI::initializeZoltan()
 {
     zoltan.reset( new Zoltan( MPI_COMM_WORLD ) );
@@ -35,11 +320,41 @@ void RuntimeMPI::initializeZoltan()
     ZOLTAN_SAFE_CALL( zoltan->Set_Param( "DEBUG_LEVEL", "2" ) );
 #endif
 
-    // Use hypergraph partitioning
-    ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_METHOD", "GRAPH" ) );
+    partition_method_ = param_.getDefault<std::string>( "partition_method", "graph" );
+    partition_cell_weights_ = param_.getDefault<std::string>( "partition_cell_weights", "none" );
+    partition_edge_weights_ = param_.getDefault<std::string>( "partition_edge_weights", "none" );
+
+    if ( partition_method_ == "graph" ) {
+        ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_METHOD", "GRAPH" ) );
+    } else if ( partition_method_ == "hypergraph" ) {
+        // Zoltan builds the hypergraph from the graph callbacks.
+        ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_METHOD", "HYPERGRAPH" ) );
+    } else if ( partition_method_ == "rcb" ) {
+        ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_METHOD", "RCB" ) );
+    } else if ( partition_method_ == "rib" ) {
+        ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_METHOD", "RIB" ) );
+    } else {
+        OPM_THROW(std::runtime_error, "Unknown partition_method " << partition_method_ << " (expected graph, hypergraph, rcb or rib).");
+    }
+    if ( partition_cell_weights_ != "none" && partition_cell_weights_ != "faces" && partition_cell_weights_ != "file" ) {
+        OPM_THROW(std::runtime_error, "Unknown partition_cell_weights " << partition_cell_weights_ << " (expected none, faces or file).");
+    }
+    if ( partition_edge_weights_ != "none" && partition_edge_weights_ != "face_areas" && partition_edge_weights_ != "transmissibility" ) {
+        OPM_THROW(std::runtime_error, "Unknown partition_edge_weights " << partition_edge_weights_
+                  << " (expected none, face_areas or transmissibility).");
+    }
+
     // Partition everything without concern for cost.
     ZOLTAN_SAFE_CALL( zoltan->Set_Param( "LB_APPROACH", "PARTITION" ) );
     ZOLTAN_SAFE_CALL( zoltan->Set_Param( "PHG_EDGE_SIZE_THRESHOLD", "1.0" ) );
+    ZOLTAN_SAFE_CALL( zoltan->Set_Param( "OBJ_WEIGHT_DIM", partition_cell_weights_ == "none" ? "0" : "1" ) );
+    // The geometric methods have no edges.
+    ZOLTAN_SAFE_CALL( zoltan->Set_Param( "EDGE_WEIGHT_DIM", partition_edge_weights_ == "none" || isGeometricPartition() ? "0" : "1" ) );
+}
+
+bool RuntimeMPI::isGeometricPartition() const
+{
+    return partition_method_ == "rcb" || partition_method_ == "rib";
 }
 
 void RuntimeMPI::initializeGrid()
@@ -49,7 +364,14 @@ void RuntimeMPI::initializeGrid()
 }
 
 RuntimeMPI::RuntimeMPI()
-    : logstream( logfilename() )
+    : logstream( logfilename() ),
+      reductionType_( MPI_DATATYPE_NULL ),
+      reductionOp_( MPI_OP_NULL ),
+      scatter_grid_( false ),
+      output_binary_( false ),
+      verbose_( 0 ),
+      max_iter_( 10 ),
+      abs_res_tol_( 1e-6 )
 {     
     param_.disableOutput();
     initializeZoltan();
@@ -58,47 +380,118 @@ RuntimeMPI::RuntimeMPI()
 
 RuntimeMPI::RuntimeMPI(const Opm::parameter::ParameterGroup &param)
     : logstream( logfilename() ),
-      param_( param )
-
+      param_( param ),
+      reductionType_( MPI_DATATYPE_NULL ),
+      reductionOp_( MPI_OP_NULL ),
+      scatter_grid_( param.getDefault( "scatter_grid", false ) ),
+      output_binary_( param.getDefault<std::string>( "output_format", "text" ) == "binary" ),
+      verbose_( param.getDefault( "verbose", 0 ) ),
+      max_iter_( param.getDefault( "max_iter", 10 ) ),
+      abs_res_tol_( param.getDefault( "abs_res_tol", 1e-6 ) )
 {
     param_.disableOutput();
+    const std::string format = param_.getDefault<std::string>( "output_format", "text" );
+    if ( format != "text" && format != "binary" ) {
+        OPM_THROW(std::runtime_error, "Unknown output_format " << format << " (expected text or binary).");
+    }
     initializeZoltan();
-    globalGrid.reset( equelle::createGridManager( param_ ) );
+    if ( !scatter_grid_ || getMPIRank() == 0 ) {
+        globalGrid.reset( equelle::createGridManager( param_ ) );
+    }
 
     logstream << "Hello from rank " << equelle::getMPIRank() << std::endl;
 }
 
 RuntimeMPI::~RuntimeMPI()
 {
-    // Zoltan resources must be deleted before we call MPI_Finalize.
+    // Zoltan and MPI resources must be deleted before we call MPI_Finalize.
     zoltan.release();
+    linearSolver.reset();
+    haloExchange.reset();
+    if ( reductionOp_ != MPI_OP_NULL ) {
+        MPI_Op_free( &reductionOp_ );
+    }
+    if ( reductionType_ != MPI_DATATYPE_NULL ) {
+        MPI_Type_free( &reductionType_ );
+    }
 }
 
 void RuntimeMPI::decompose()
 {
     auto startTime = MPI_Wtime();
 
-    auto zr = computePartition();
-    std::vector<int> localCells;
+    const std::string partitionFile = param_.getDefault<std::string>( "partition_filename", "" );
+    std::vector<int> cellOwners; // The owner of each global cell, on node 0.
+    std::vector<int> localCells; // The owned cells of this node, without scatter_grid.
 
-    if ( getMPIRank() == 0 ) {
-        // Node 0 must compute which cells not to export.
-        std::set_difference( boost::counting_iterator<int>(0), boost::counting_iterator<int>( globalGrid->c_grid()->number_of_cells ),
-                             zr.exportGlobalGids, zr.exportGlobalGids + zr.numExport, std::back_inserter( localCells ) );
+    if ( !partitionFile.empty() ) {
+        cellOwners = readPartitionOnRoot( partitionFile, globalGrid ? globalGrid->c_grid() : nullptr );
+        logstream << "Read the partition from " << partitionFile << std::endl;
     } else {
-        localCells.resize( zr.numImport );
-        std::copy_n( zr.importGlobalGids, zr.numImport, localCells.begin() );
+        auto zr = computePartition();
+        // Node 0 holds the whole partition, as it is the only node that passed its cells to Zoltan.
+        if ( getMPIRank() == 0 ) {
+            cellOwners = ZoltanGrid::rank0CellOwners( globalGrid->c_grid()->number_of_cells, zr );
+        }
     }
 
-    subGrid = SubGridBuilder::build( globalGrid->c_grid(), localCells );
+    if ( !scatter_grid_ ) {
+        // Every node holds the globalGrid, so it can hold the owners as well.
+        const int numCells = globalGrid->c_grid()->number_of_cells;
+        cellOwners.resize( numCells );
+        MPI_SAFE_CALL( MPI_Bcast( cellOwners.data(), numCells, MPI_INT, 0, MPI_COMM_WORLD ) );
+        for ( int c = 0; c < numCells; ++c ) {
+            if ( cellOwners[c] == getMPIRank() ) {
+                localCells.push_back( c );
+            }
+        }
+    }
+
+    if ( scatter_grid_ ) {
+        subGrid = SubGridBuilder::scatter( globalGrid ? globalGrid->c_grid() : nullptr, cellOwners );
+    } else {
+        subGrid = SubGridBuilder::build( globalGrid->c_grid(), localCells );
+    }
 
     runtime.reset( new EquelleRuntimeCPU( subGrid.c_grid, param_ ) );
+    haloExchange.reset( new SubGridHaloExchange( subGrid ) );
+    linearSolver.reset( new ParallelLinearSolver( subGrid, *haloExchange, param_ ) );
 
     auto endTime = MPI_Wtime();
 
     logstream << "Decomposing took " << endTime-startTime << " seconds\n";
     logstream << "subGrid.number_of_ghost_cells: " << subGrid.number_of_ghost_cells << std::endl;
     logstream << "subGrid.global_cell.size(): " << subGrid.cell_local_to_global.size() << std::endl;
+    logstream << "Exchanging ghost cells with " << haloExchange->receiveRanks().size() << " nodes, sending "
+              << haloExchange->sendCells().size() << " cells to " << haloExchange->sendRanks().size() << " nodes" << std::endl;
+    logPartitionQuality();
+}
+
+void RuntimeMPI::logPartitionQuality()
+{
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+
+    // A cut face has cells on two nodes. Only the node owning it counts it.
+    int cutFaces = 0;
+    for( int f = 0; f < subGrid.c_grid->number_of_faces; ++f ) {
+        const int first = subGrid.c_grid->face_cells[ 2*f ];
+        const int second = subGrid.c_grid->face_cells[ 2*f + 1 ];
+        if ( first >= 0 && second >= 0 && ( first >= numOwned || second >= numOwned ) && isOwnedFace( f ) ) {
+            ++cutFaces;
+        }
+    }
+
+    int totals[3] = { numOwned, subGrid.number_of_ghost_cells, cutFaces };
+    MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, totals, 3, MPI_INT, MPI_SUM, MPI_COMM_WORLD ) );
+    int maxOwned = numOwned;
+    MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &maxOwned, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD ) );
+
+    const double averageOwned = double( totals[0] ) / getMPISize();
+    logstream << "Partition quality (" << partition_method_ << "): imbalance " << maxOwned / averageOwned
+              << " (largest node " << maxOwned << " cells, average " << averageOwned << ")"
+              << ", edge cut " << totals[2] << " faces"
+              << ", ghost ratio " << double( totals[1] ) / totals[0]
+              << " (this node " << subGrid.number_of_ghost_cells << " ghost cells, " << numOwned << " owned)" << std::endl;
 }
 
 zoltanReturns RuntimeMPI::computePartition()
@@ -114,10 +507,37 @@ zoltanReturns RuntimeMPI::computePartition()
         grid = const_cast<void*>( reinterpret_cast<const void*>( emptyGrid.c_grid()) );
     }
 
+    // The weights are only needed on node 0, which holds the grid. The parameters are read
+    // on all nodes, so that a missing one makes all of them throw.
+    const String cellWeightsFilename = partition_cell_weights_ == "file"
+        ? param_.get<String>( "partition_cell_weights_filename" ) : String();
+    ZoltanGrid::Weights weights;
+    weights.grid = reinterpret_cast<const UnstructuredGrid*>( grid );
+    bool failed = false;
+    if ( getMPIRank() == 0 ) {
+        if ( partition_cell_weights_ == "faces" ) {
+            weights.cells = ZoltanGrid::faceCountWeights( *weights.grid );
+        } else if ( partition_cell_weights_ == "file" ) {
+            failed = !readOnRoot( cellWeightsFilename, weights.cells )
+                     || int( weights.cells.size() ) != weights.grid->number_of_cells;
+        }
+        if ( partition_edge_weights_ == "face_areas" ) {
+            weights.faces = ZoltanGrid::faceAreaWeights( *weights.grid );
+        } else if ( partition_edge_weights_ == "transmissibility" ) {
+            weights.faces = ZoltanGrid::transmissibilityWeights( *weights.grid );
+        }
+    }
+    throwIfAnyFailed( failed, "partition_cell_weights_filename must hold one weight per cell." );
+
     ZOLTAN_SAFE_CALL( zoltan->Set_Num_Obj_Fn( ZoltanGrid::getNumberOfObjects, grid ) );
-    ZOLTAN_SAFE_CALL( zoltan->Set_Obj_List_Fn( ZoltanGrid::getCellList, grid ) );
-    ZOLTAN_SAFE_CALL( zoltan->Set_Num_Edges_Multi_Fn( ZoltanGrid::getNumberOfEdgesMulti, grid ) );
-    ZOLTAN_SAFE_CALL( zoltan->Set_Edge_List_Multi_Fn( ZoltanGrid::getEdgeListMulti, grid ) );
+    ZOLTAN_SAFE_CALL( zoltan->Set_Obj_List_Fn( ZoltanGrid::getWeightedCellList, &weights ) );
+    if ( isGeometricPartition() ) {
+        ZOLTAN_SAFE_CALL( zoltan->Set_Num_Geom_Fn( ZoltanGrid::getNumberOfGeometryDimensions, grid ) );
+        ZOLTAN_SAFE_CALL( zoltan->Set_Geom_Multi_Fn( ZoltanGrid::getGeometryMulti, grid ) );
+    } else {
+        ZOLTAN_SAFE_CALL( zoltan->Set_Num_Edges_Multi_Fn( ZoltanGrid::getNumberOfEdgesMulti, grid ) );
+        ZOLTAN_SAFE_CALL( zoltan->Set_Edge_List_Multi_Fn( ZoltanGrid::getWeightedEdgeListMulti, &weights ) );
+    }
 
     ZOLTAN_SAFE_CALL(
                 zoltan->LB_Partition( zr.changes,         /* 1 if partitioning was changed, 0 otherwise */
@@ -166,6 +586,62 @@ CollOfFace RuntimeMPI::boundaryFaces() const
     return boundary;
 }
 
+CollOfFace RuntimeMPI::interiorFaces() const
+{
+    return runtime->interiorFaces();
+}
+
+CollOfCell RuntimeMPI::firstCell( const CollOfFace& faces ) const
+{
+    return runtime->firstCell( faces );
+}
+
+CollOfCell RuntimeMPI::secondCell( const CollOfFace& faces ) const
+{
+    return runtime->secondCell( faces );
+}
+
+CollOfScalar RuntimeMPI::gradient( const CollOfScalar& cell_scalarfield )
+{
+    if ( !cell_scalarfield.derivative().empty() ) {
+        // The derivatives need the serial operators, so there is nothing to overlap the exchange with.
+        return runtime->gradient( updateGhosts( cell_scalarfield ) );
+    }
+    if ( cell_scalarfield.size() != int( subGrid.cell_local_to_global.size() ) ) {
+        OPM_THROW( std::runtime_error, "gradient requires a collection on all cells, got " << cell_scalarfield.size()
+                   << " elements for " << subGrid.cell_local_to_global.size() << " cells." );
+    }
+
+    // The faces next to ghost cells are numbered last by SubGridBuilder, so the interior faces
+    // before them can be computed while the ghost cells are exchanged.
+    CollOfScalar::V u = cell_scalarfield.value();
+    haloExchange->start( u.data() );
+
+    const UnstructuredGrid& grid = *subGrid.c_grid;
+    const int firstGhostFace = grid.number_of_faces - subGrid.number_of_ghost_faces;
+    CollOfScalar::V grad( grid.number_of_faces );
+    int numInteriorFaces = 0;
+    auto gradientOn = [&]( int begin, int end ) {
+        for( int f = begin; f < end; ++f ) {
+            const int c0 = grid.face_cells[2*f];
+            const int c1 = grid.face_cells[2*f + 1];
+            if ( c0 >= 0 && c1 >= 0 ) {
+                grad[numInteriorFaces++] = u[c1] - u[c0];
+            }
+        }
+    };
+    gradientOn( 0, firstGhostFace );
+    haloExchange->finish( u.data() );
+    gradientOn( firstGhostFace, grid.number_of_faces );
+
+    return CollOfScalar( CollOfScalar::V( grad.head( numInteriorFaces ) ) );
+}
+
+CollOfScalar RuntimeMPI::divergence( const CollOfScalar& face_fluxes ) const
+{
+    return runtime->divergence( face_fluxes );
+}
+
 CollOfScalar RuntimeMPI::inputCollectionOfScalar(const String& /* name */, const CollOfFace & /* coll */ )
 {
     throw std::runtime_error("Not implemented");
@@ -177,24 +653,25 @@ CollOfScalar RuntimeMPI::inputCollectionOfScalar(const String &name, const CollO
     const bool from_file = param_.getDefault(name + "_from_file", false);
     if (from_file) {
         const String filename = param_.get<String>(name + "_filename");
-        std::ifstream is(filename.c_str());
-        if (!is) {
-            OPM_THROW(std::runtime_error, "Could not find file " << filename);
-        }
-        std::istream_iterator<double> beg(is);
-        std::istream_iterator<double> end;
-        std::vector<double> data(beg, end);
-
-        std::vector<double> localData( coll.size() );
+        const bool binary = param_.getDefault(name + "_binary", false);
 
-        // Map into local cell enumeration
-        for( int i = 0; i < coll.size(); ++i ) {
-            auto glob = subGrid.cell_local_to_global[i];
+        std::vector<int> globalIds( size );
+        for( int i = 0; i < size; ++i ) {
+            globalIds[i] = subGrid.cell_local_to_global[ coll[i].index ];
+        }
 
-            localData[i] = data[glob];
+        // Binary files are read in parallel. Text files are parsed on node 0, which sends each node its own values.
+        std::vector<double> localData;
+        if ( binary ) {
+            localData = readBinaryWithMPIIO( filename, globalIds );
+        } else {
+            std::vector<double> data;
+            const bool found = readOnRoot( filename, data );
+            throwIfAnyFailed( getMPIRank() == 0 && !found, "Could not find file " + filename );
+            localData = scatterFromRoot( data, globalIds, filename );
         }
 
-        return CollOfScalar(CollOfScalar::V(Eigen::Map<CollOfScalar::V>(&localData[0], size)));
+        return CollOfScalar(CollOfScalar::V(Eigen::Map<CollOfScalar::V>(localData.data(), size)));
     } else {
         // Uniform values.
         return CollOfScalar(CollOfScalar::V::Constant(size, param_.get<double>(name)));
@@ -205,24 +682,16 @@ CollOfScalar RuntimeMPI::inputCollectionOfScalar(const String &name, const CollO
 CollOfFace RuntimeMPI::inputDomainSubsetOf(const String &name, const CollOfFace &superset)
 {
     // This implementation is based on a copy of EquelleRuntimeCPU::inputDomainSubsetOf
-    // but we rewrite the indices into our local index-space.
+    // but we rewrite the indices into our local index-space. Node 0 reads the file and sends
+    // every node the indices that are part of its domain.
     const String filename = param_.get<String>(name + "_filename");
-    std::ifstream is(filename.c_str());
-    if (!is) {
-        OPM_THROW(std::runtime_error, "Could not find file " << filename);
-    }
-    std::istream_iterator<int> beg(is);
-    std::istream_iterator<int> end;
+    std::vector<int> ids;
+    const bool found = readOnRoot( filename, ids );
+    throwIfAnyFailed( getMPIRank() == 0 && !found, "Could not find file " + filename );
 
     CollOfFace data;
-    for (auto it = beg; it != end; ++it) {
-        logstream << "Read " << *it << std::endl;
-        auto jt = subGrid.face_global_to_local.find( *it );
-        if ( jt != subGrid.face_global_to_local.end() ) { // This face is part of our domain
-            data.emplace_back( jt->second );
-
-            logstream << "Adding " << *it << " -> " << jt->second << std::endl;
-        } // else the face is not part of our domain
+    for( int global: scatterSubsetFromRoot( ids, subGrid.face_local_to_global ) ) {
+        data.emplace_back( subGrid.face_global_to_local.at( global ) );
     }
 
     // Needed to allow for std::includes to give valid results.
@@ -239,24 +708,16 @@ CollOfFace RuntimeMPI::inputDomainSubsetOf(const String &name, const CollOfFace
 CollOfCell RuntimeMPI::inputDomainSubsetOf(const String &name, const CollOfCell &superset)
 {
     // This implementation is based on a copy of EquelleRuntimeCPU::inputDomainSubsetOf
-    // but we rewrite the indices into our local index-space.
+    // but we rewrite the indices into our local index-space. Node 0 reads the file and sends
+    // every node the indices that are part of its domain.
     const String filename = param_.get<String>(name + "_filename");
-    std::ifstream is(filename.c_str());
-    if (!is) {
-        OPM_THROW(std::runtime_error, "Could not find file " << filename);
-    }
-    std::istream_iterator<int> beg(is);
-    std::istream_iterator<int> end;
+    std::vector<int> ids;
+    const bool found = readOnRoot( filename, ids );
+    throwIfAnyFailed( getMPIRank() == 0 && !found, "Could not find file " + filename );
 
     CollOfCell data;
-    for (auto it = beg; it != end; ++it) {
-        logstream << "Read " << *it << std::endl;
-        auto jt = subGrid.cell_global_to_local.find( *it );
-        if ( jt != subGrid.cell_global_to_local.end() ) { // This cell is part of our domain
-            data.emplace_back( jt->second );
-
-            logstream << "Adding " << *it << " -> " << jt->second << std::endl;
-        } // else the cell is not part of our domain
+    for( int global: scatterSubsetFromRoot( ids, subGrid.cell_local_to_global ) ) {
+        data.emplace_back( subGrid.cell_global_to_local.at( global ) );
     }
 
     // Needed to allow for std::includes to give valid results.
@@ -278,71 +739,255 @@ Scalar RuntimeMPI::inputScalarWithDefault(const String &name, const Scalar defau
 
 void RuntimeMPI::output(const String &tag, const CollOfScalar &vals)
 {
-    auto val = allGather( vals );
-    if ( equelle::getMPIRank() == 0 ) {
-        runtime->output( tag, val );
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    if ( vals.size() != int( subGrid.cell_local_to_global.size() ) ) {
+        OPM_THROW( std::runtime_error, "RuntimeMPI can only output collections On AllCells()." );
+    }
+
+    // Only the owned cells are written, so every global cell is written once.
+    const std::vector<int> globalIds( subGrid.cell_local_to_global.begin(), subGrid.cell_local_to_global.begin() + numOwned );
+    const std::vector<double> values( vals.value().data(), vals.value().data() + numOwned );
+
+    if ( output_binary_ ) {
+        int count = outputcount_[tag]++;
+        std::ostringstream fname;
+        fname << tag << "-" << std::setw(5) << std::setfill('0') << count << ".bin";
+
+        int totalSize = numOwned;
+        MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &totalSize, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD ) );
+        writeBinaryWithMPIIO( fname.str(), globalIds, values, totalSize );
+    } else {
+        // Text is written by node 0, which is the only node holding the global collection.
+        const std::vector<double> global = gatherOnRoot( globalIds, values );
+        if ( equelle::getMPIRank() == 0 ) {
+            runtime->output( tag, CollOfScalar( CollOfScalar::V( Eigen::Map<const CollOfScalar::V>( global.data(), global.size() ) ) ) );
+        }
     }
 }
 
-equelle::CollOfScalar equelle::RuntimeMPI::allGather( const equelle::CollOfScalar &coll )
+CollOfScalar RuntimeMPI::allGather( const CollOfScalar& coll )
 {
-    // Get the size of the collection on every node
-    struct CollOfScalarSize {
-        int size = 0;
-        int numBlocks = 0;
-    };
+    return allGather( coll, allCells() );
+}
 
-    int rank = equelle::getMPIRank();
-    int world_size = equelle::getMPISize();
-    std::vector<CollOfScalarSize> sizes( world_size );
+CollOfScalar RuntimeMPI::allGather( const CollOfScalar& coll, const CollOfCell& domain )
+{
+    std::vector<int> indices( domain.size() );
+    for( size_t i = 0; i < domain.size(); ++i ) {
+        indices[i] = domain[i].index;
+    }
+    return gather( coll, gatherPlan( false, indices ) );
+}
 
-    sizes[rank].size = coll.size();
-    sizes[rank].numBlocks = coll.numBlocks();
+CollOfScalar RuntimeMPI::allGather( const CollOfScalar& coll, const CollOfFace& domain )
+{
+    std::vector<int> indices( domain.size() );
+    for( size_t i = 0; i < domain.size(); ++i ) {
+        indices[i] = domain[i].index;
+    }
+    return gather( coll, gatherPlan( true, indices ) );
+}
 
-    MPI_SAFE_CALL( MPI_Allgather( &sizes[rank], 2, MPI_INT,
-                                  sizes.data(), 2, MPI_INT, MPI_COMM_WORLD ) );
+const RuntimeMPI::GatherPlan& RuntimeMPI::gatherPlan( bool faces, const std::vector<int>& domain )
+{
+    // A plan can only be reused if it was made for this domain on all nodes, as the local
+    // parts of two domains may be equal on some nodes. The plans are made collectively,
+    // so they have the same position on every node.
+    std::vector<int> matches( gatherPlans_.size() );
+    for( size_t p = 0; p < gatherPlans_.size(); ++p ) {
+        matches[p] = gatherPlans_[p].faces == faces && gatherPlans_[p].domain == domain;
+    }
+    if ( !matches.empty() ) {
+        MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, matches.data(), matches.size(), MPI_INT, MPI_LAND, MPI_COMM_WORLD ) );
+        auto it = std::find( matches.begin(), matches.end(), 1 );
+        if ( it != matches.end() ) {
+            return gatherPlans_[ it - matches.begin() ];
+        }
+    }
+
+    GatherPlan plan;
+    plan.faces = faces;
+    plan.domain = domain;
+
+    // Only the owned entries are sent, so that every global entry is sent once.
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    const std::vector<int>& localToGlobal = faces ? subGrid.face_local_to_global : subGrid.cell_local_to_global;
+    std::vector<int> globalIds;
+    for( size_t i = 0; i < domain.size(); ++i ) {
+        if ( faces ? isOwnedFace( domain[i] ) : domain[i] < numOwned ) {
+            plan.owned.push_back( i );
+            globalIds.push_back( localToGlobal[ domain[i] ] );
+        }
+    }
 
-    // Get the globalgids for the elements in coll.
-    // NB. These globalgids are the global ID for the collection! As the serial backend would see them.
+    const int world_size = getMPISize();
+    int count = plan.owned.size();
+    plan.counts.resize( world_size );
+    MPI_SAFE_CALL( MPI_Allgather( &count, 1, MPI_INT, plan.counts.data(), 1, MPI_INT, MPI_COMM_WORLD ) );
+    plan.offsets.assign( world_size + 1, 0 );
+    for( int r = 0; r < world_size; ++r ) {
+        plan.offsets[r + 1] = plan.offsets[r] + plan.counts[r];
+    }
 
-    std::vector<int> recvcounts( world_size); // Number of elements in each node
-    std::vector<int> displacements( world_size +1 ); // Displacements where each node store the data
+    std::vector<int> allIds( plan.offsets.back() );
+    MPI_SAFE_CALL( MPI_Allgatherv( globalIds.data(), count, MPI_INT,
+                                   allIds.data(), plan.counts.data(), plan.offsets.data(), MPI_INT, MPI_COMM_WORLD ) );
 
-    for( int i = 0; i < equelle::getMPISize(); ++i ) {
-        recvcounts[i] = sizes[i].size;
-        displacements[i+1] = displacements[i] + sizes[i].size;
+    // The global collection is ordered by global index, as the serial backend would see it.
+    std::vector<int> sortedIds( allIds );
+    std::sort( sortedIds.begin(), sortedIds.end() );
+    plan.position.resize( allIds.size() );
+    for( size_t i = 0; i < allIds.size(); ++i ) {
+        plan.position[i] = std::lower_bound( sortedIds.begin(), sortedIds.end(), allIds[i] ) - sortedIds.begin();
     }
 
-    // Total number of elements, including duplicates
-    const int total_number_of_elements = displacements.back();
-    std::vector<int> global_id_mapping( total_number_of_elements );
+    logstream << "allGather: new plan for " << domain.size() << ( faces ? " faces" : " cells" )
+              << ", " << allIds.size() << " global entries" << std::endl;
+    gatherPlans_.push_back( std::move( plan ) );
+    return gatherPlans_.back();
+}
 
-    // We do not need to copy the local data into the global structure.
-    // That is handeled by MPI_Allgatherv
-    MPI_SAFE_CALL(
-        MPI_Allgatherv( subGrid.cell_local_to_global.data(), subGrid.cell_local_to_global.size(), MPI_INT,
-                        global_id_mapping.data(), recvcounts.data(), displacements.data(),
-                        MPI_INT, MPI_COMM_WORLD ) );
+CollOfScalar RuntimeMPI::gather( const CollOfScalar& coll, const GatherPlan& plan )
+{
+    if ( coll.size() != int( plan.domain.size() ) ) {
+        OPM_THROW( std::runtime_error, "The collection to gather does not match its domain." );
+    }
 
     // Send the value part of an AutoDiffBlock, collect them in a global array
-    // offsets are the same as for the global_id_mapping
-    std::vector<double> adbvalues( total_number_of_elements );
+    const CollOfScalar::V& values = coll.value();
+    std::vector<double> owned( plan.owned.size() );
+    for( size_t i = 0; i < plan.owned.size(); ++i ) {
+        owned[i] = values[ plan.owned[i] ];
+    }
+    std::vector<double> received( plan.position.size() );
+    MPI_SAFE_CALL( MPI_Allgatherv( owned.data(), owned.size(), MPI_DOUBLE,
+                                   received.data(), const_cast<int*>( plan.counts.data() ), const_cast<int*>( plan.offsets.data() ),
+                                   MPI_DOUBLE, MPI_COMM_WORLD ) );
+
+    CollOfScalar::V global( received.size() );
+    for( size_t i = 0; i < received.size(); ++i ) {
+        global[ plan.position[i] ] = received[i];
+    }
+    return CollOfScalar( global );
+}
 
-    MPI_SAFE_CALL( MPI_Allgatherv( const_cast<double*>( coll.value().data() ), coll.value().size(), MPI_DOUBLE,
-                     adbvalues.data(), recvcounts.data(), displacements.data(),
-                     MPI_DOUBLE, MPI_COMM_WORLD ) );
+CollOfScalar RuntimeMPI::updateGhosts( const CollOfScalar& coll )
+{
+    if ( coll.size() != int( subGrid.cell_local_to_global.size() ) ) {
+        OPM_THROW( std::runtime_error, "updateGhosts requires a collection on all cells, got " << coll.size()
+                   << " elements for " << subGrid.cell_local_to_global.size() << " cells." );
+    }
+
+    CollOfScalar::V values = coll.value();
+    haloExchange->exchange( values.data() );
 
-    int unique_number_of_elements = 1 + *std::max_element( global_id_mapping.begin(), global_id_mapping.end() );
+    if ( coll.derivative().empty() ) {
+        return CollOfScalar( values );
+    }
 
-    typedef Eigen::Array<Scalar, Eigen::Dynamic, 1> V;
-    V v_new( unique_number_of_elements );
+    // The derivative rows of the owners are in terms of their own local cells, which
+    // need not be on this node, so only collections whose ghost cells are up to date are accepted.
+    const int numGhosts = subGrid.number_of_ghost_cells;
+    const bool stale = ( values.tail( numGhosts ) != coll.value().tail( numGhosts ) ).any();
+    throwIfAnyFailed( stale, "updateGhosts cannot update the ghost cells of a collection with derivatives. "
+                      "Compute it from collections whose ghost cells are up to date instead." );
+    return coll;
+}
 
-    for( int i = 0; i < total_number_of_elements; ++i ) {
-        int global_id = global_id_mapping[i];
-        v_new[global_id] = adbvalues[i];
+RuntimeMPI::PartialReduction RuntimeMPI::partialReduce( ReduceOperation op, const CollOfScalar& x,
+                                                        const CollOfCell& domain ) const
+{
+    if ( x.size() != int( domain.size() ) ) {
+        OPM_THROW( std::runtime_error, "The collection to reduce does not match its domain." );
     }
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    PartialReduction partial = { op, reductionIdentity( op ) };
+    const CollOfScalar::V& values = x.value();
+    for ( int i = 0; i < x.size(); ++i ) {
+        if ( domain[i].index < numOwned ) {
+            partial.value = combine( op, partial.value, values[i] );
+        }
+    }
+    return partial;
+}
 
-    return CollOfScalar( v_new );
+RuntimeMPI::PartialReduction RuntimeMPI::partialReduce( ReduceOperation op, const CollOfScalar& x,
+                                                        const CollOfFace& domain ) const
+{
+    if ( x.size() != int( domain.size() ) ) {
+        OPM_THROW( std::runtime_error, "The collection to reduce does not match its domain." );
+    }
+    PartialReduction partial = { op, reductionIdentity( op ) };
+    const CollOfScalar::V& values = x.value();
+    for ( int i = 0; i < x.size(); ++i ) {
+        if ( isOwnedFace( domain[i].index ) ) {
+            partial.value = combine( op, partial.value, values[i] );
+        }
+    }
+    return partial;
+}
+
+bool RuntimeMPI::isOwnedFace( int face ) const
+{
+    // A face with an owned cell has all its cells in the subgrid, so a missing
+    // first cell means that it is on the global boundary.
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    auto owned = [numOwned]( int cell ) { return cell >= 0 && cell < numOwned; };
+    const int first = subGrid.c_grid->face_cells[ 2*face ];
+    const int second = subGrid.c_grid->face_cells[ 2*face + 1 ];
+    return owned( first ) || ( first < 0 && owned( second ) );
+}
+
+std::vector<Scalar> RuntimeMPI::reduce( const std::vector<PartialReduction>& batch )
+{
+    if ( reductionOp_ == MPI_OP_NULL ) {
+        MPI_SAFE_CALL( MPI_Type_contiguous( 2, MPI_DOUBLE, &reductionType_ ) );
+        MPI_SAFE_CALL( MPI_Type_commit( &reductionType_ ) );
+        MPI_SAFE_CALL( MPI_Op_create( &combinePartialReductions, 1, &reductionOp_ ) );
+    }
+
+    std::vector<double> entries( 2*batch.size() );
+    for ( size_t i = 0; i < batch.size(); ++i ) {
+        entries[2*i] = batch[i].op;
+        entries[2*i + 1] = batch[i].value;
+    }
+    MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, entries.data(), batch.size(), reductionType_,
+                                  reductionOp_, MPI_COMM_WORLD ) );
+
+    std::vector<Scalar> results( batch.size() );
+    for ( size_t i = 0; i < batch.size(); ++i ) {
+        results[i] = entries[2*i + 1];
+    }
+    return results;
+}
+
+CollOfScalar::V RuntimeMPI::solveForUpdate( const CollOfScalar& residual )
+{
+    // Only the rows of the owned cells are complete. The ghost cells lack some of their neighbours.
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    const ParallelLinearSolver::Matrix jacobian = residual.derivative()[0];
+    const ParallelLinearSolver::Matrix A = jacobian.topRows( numOwned );
+    const ParallelLinearSolver::Vector b = residual.value().head( numOwned );
+
+    ParallelLinearSolver::Vector du = ParallelLinearSolver::Vector::Zero( residual.size() );
+    const ParallelLinearSolver::Report report = linearSolver->solve( A, b, du );
+
+    if ( verbose_ > 2 && getMPIRank() == 0 ) {
+        std::cout << "        solveForUpdate: " << report.iterations << " linear iterations, residual "
+                  << report.residual_norm << std::endl;
+    }
+    if ( !report.converged ) {
+        OPM_THROW( std::runtime_error, "Linear solver convergence failure." );
+    }
+    return du;
+}
+
+double RuntimeMPI::twoNorm( const CollOfScalar& vals ) const
+{
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    double sum = vals.value().head( numOwned ).matrix().squaredNorm();
+    MPI_SAFE_CALL( MPI_Allreduce( MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD ) );
+    return std::sqrt( sum );
 }
 
 } // namespace equlle
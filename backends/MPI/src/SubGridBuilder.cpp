@@ -1,7 +1,7 @@
 #include "equelle/SubGridBuilder.hpp"
 
 #include <opm/core/grid.h>
-#include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <cstdlib>
 #include <set>
 #include <unordered_map>
 #include <algorithm>
@@ -13,26 +13,122 @@
 
 namespace equelle {
 
-std::set<int> SubGridBuilder::extractNeighborCells(const UnstructuredGrid *grid, const std::vector<int> &cellsToExtract)
-{
-    std::set<int> neighborCells;
+namespace {
+
+    /// Message tags of scatter().
+    enum { IntTag = 0, DoubleTag = 1 };
+
+    /// Flattens a subgrid into one array of integers and one of doubles.
+    void packSubGrid( const SubGrid& subGrid, std::vector<int>& ints, std::vector<double>& doubles )
+    {
+        const UnstructuredGrid* g = subGrid.c_grid;
+        const int nc = g->number_of_cells;
+        const int nf = g->number_of_faces;
+        const int nfn = g->face_nodepos[nf];
+        const int ncf = g->cell_facepos[nc];
+        const int dim = g->dimensions;
+
+        ints = { dim, nc, nf, nfn, ncf, g->number_of_nodes,
+                 subGrid.number_of_ghost_cells, subGrid.number_of_interior_cells, subGrid.number_of_ghost_faces,
+                 g->cartdims[0], g->cartdims[1], g->cartdims[2], g->cell_facetag != nullptr };
+        ints.insert( ints.end(), g->face_nodepos, g->face_nodepos + nf + 1 );
+        ints.insert( ints.end(), g->face_nodes, g->face_nodes + nfn );
+        ints.insert( ints.end(), g->face_cells, g->face_cells + 2*nf );
+        ints.insert( ints.end(), g->cell_facepos, g->cell_facepos + nc + 1 );
+        ints.insert( ints.end(), g->cell_faces, g->cell_faces + ncf );
+        if ( g->cell_facetag ) {
+            ints.insert( ints.end(), g->cell_facetag, g->cell_facetag + ncf );
+        }
+        ints.insert( ints.end(), g->global_cell, g->global_cell + nc );
+        ints.insert( ints.end(), subGrid.cell_local_to_global.begin(), subGrid.cell_local_to_global.end() );
+        ints.insert( ints.end(), subGrid.face_local_to_global.begin(), subGrid.face_local_to_global.end() );
+
+        doubles.clear();
+        doubles.insert( doubles.end(), g->node_coordinates, g->node_coordinates + dim*g->number_of_nodes );
+        doubles.insert( doubles.end(), g->face_centroids, g->face_centroids + dim*nf );
+        doubles.insert( doubles.end(), g->face_areas, g->face_areas + nf );
+        doubles.insert( doubles.end(), g->face_normals, g->face_normals + dim*nf );
+        doubles.insert( doubles.end(), g->cell_centroids, g->cell_centroids + dim*nc );
+        doubles.insert( doubles.end(), g->cell_volumes, g->cell_volumes + nc );
+    }
+
+    /// The inverse of packSubGrid.
+    SubGrid unpackSubGrid( const std::vector<int>& ints, const std::vector<double>& doubles )
+    {
+        const int dim = ints[0], nc = ints[1], nf = ints[2], nfn = ints[3], ncf = ints[4], nn = ints[5];
+        SubGrid subGrid;
+        subGrid.number_of_ghost_cells = ints[6];
+        subGrid.number_of_interior_cells = ints[7];
+        subGrid.number_of_ghost_faces = ints[8];
+        subGrid.c_grid = allocate_grid( dim, nc, nf, nfn, ncf, nn );
+        UnstructuredGrid* g = subGrid.c_grid;
+        std::copy( ints.begin() + 9, ints.begin() + 12, g->cartdims );
+        const bool has_facetag = ints[12];
+
+        auto in = ints.begin() + 13;
+        auto take = [&in]( int count, int* out ) { std::copy( in, in + count, out ); in += count; };
+        take( nf + 1, g->face_nodepos );
+        take( nfn, g->face_nodes );
+        take( 2*nf, g->face_cells );
+        take( nc + 1, g->cell_facepos );
+        take( ncf, g->cell_faces );
+        std::free( g->cell_facetag );
+        g->cell_facetag = nullptr;
+        if ( has_facetag ) {
+            g->cell_facetag = static_cast<int*>( std::malloc( ncf * sizeof( int ) ) );
+            take( ncf, g->cell_facetag );
+        }
+        g->global_cell = static_cast<int*>( std::malloc( nc * sizeof( int ) ) );
+        take( nc, g->global_cell );
+        subGrid.cell_local_to_global.assign( in, in + nc ); in += nc;
+        subGrid.face_local_to_global.assign( in, in + nf ); in += nf;
+
+        auto din = doubles.begin();
+        auto takeDoubles = [&din]( int count, double* out ) { std::copy( din, din + count, out ); din += count; };
+        takeDoubles( dim*nn, g->node_coordinates );
+        takeDoubles( dim*nf, g->face_centroids );
+        takeDoubles( nf, g->face_areas );
+        takeDoubles( dim*nf, g->face_normals );
+        takeDoubles( dim*nc, g->cell_centroids );
+        takeDoubles( nc, g->cell_volumes );
+
+        subGrid.cell_global_to_local.reserve( nc );
+        for( int i = 0; i < nc; ++i ) {
+            subGrid.cell_global_to_local[ subGrid.cell_local_to_global[i] ] = i;
+        }
+        subGrid.face_global_to_local.reserve( nf );
+        for( int i = 0; i < nf; ++i ) {
+            subGrid.face_global_to_local[ subGrid.face_local_to_global[i] ] = i;
+        }
+        return subGrid;
+    }
 
-    // Extract the inner-neighbors
+    template <class T>
+    void receiveAll( std::vector<T>& data, MPI_Datatype type, int source, int tag, MPI_Comm comm )
+    {
+        MPI_Status status;
+        int count;
+        MPI_SAFE_CALL( MPI_Probe( source, tag, comm, &status ) );
+        MPI_SAFE_CALL( MPI_Get_count( &status, type, &count ) );
+        data.resize( count );
+        MPI_SAFE_CALL( MPI_Recv( data.data(), count, type, source, tag, comm, MPI_STATUS_IGNORE ) );
+    }
 
-    Opm::HelperOps helperOps( *grid );
-    Opm::HelperOps::M adj = helperOps.div * helperOps.ngrad;
+} // anonymous namespace
 
-    //std::cout << helperOps.div << std::endl;
-    //std::cout << adj << std::endl;
+std::set<int> SubGridBuilder::extractNeighborCells(const UnstructuredGrid *grid, const std::vector<int> &cellsToExtract)
+{
+    std::set<int> neighborCells;
 
+    // Extract the inner-neighbors, the cells across each face. This only touches the faces of
+    // cellsToExtract, so that building the subgrids of all nodes on one node stays linear in the grid size.
     for( int i = 0; i < cellsToExtract.size(); ++i ) {
-        int cell = cellsToExtract[i];
-        for( Eigen::SparseMatrix<double>::InnerIterator it( adj, cell); it; ++it ) {
-            if( it.row() == it.col() ) { // Skip diagonal elements
-                // NOP
-            } else {
-                // By using it.index() we can ignore what is the inner and outer dimensions. (Ie col-major or row-major.)
-                neighborCells.insert( it.index() );
+        const int cell = cellsToExtract[i];
+        for( int j = grid->cell_facepos[cell]; j < grid->cell_facepos[cell + 1]; ++j ) {
+            const int face = grid->cell_faces[j];
+            const int other = grid->face_cells[2*face] == cell ? grid->face_cells[2*face + 1] : grid->face_cells[2*face];
+            if( other >= 0 ) {
+                neighborCells.insert( other );
             }
         }
     }
@@ -162,16 +258,88 @@ void SubGridBuilder::build_face_cells( const face_mapping &participatingFaces,
     }
 }
 
+std::vector<int> SubGridBuilder::orderOwnedCells( const UnstructuredGrid* grid, const std::vector<int>& cellsToExtract,
+                                                  const std::vector<int>& sortedCells, int& number_of_interior_cells )
+{
+    std::vector<int> interior;
+    std::vector<int> innerBoundary;
+
+    for( auto cell: cellsToExtract ) {
+        bool nextToGhost = false;
+        for( int i = grid->cell_facepos[cell]; i < grid->cell_facepos[cell+1]; ++i ) {
+            const int face = grid->cell_faces[i];
+            const int other = grid->face_cells[2*face] == cell ? grid->face_cells[2*face + 1] : grid->face_cells[2*face];
+            if ( other != Boundary::outer && !std::binary_search( sortedCells.begin(), sortedCells.end(), other ) ) {
+                nextToGhost = true;
+                break;
+            }
+        }
+        ( nextToGhost ? innerBoundary : interior ).push_back( cell );
+    }
+
+    number_of_interior_cells = interior.size();
+    interior.insert( interior.end(), innerBoundary.begin(), innerBoundary.end() );
+    return interior;
+}
+
+int SubGridBuilder::orderFaces( face_mapping& participatingFaces, const SubGrid& subGrid, const UnstructuredGrid* grid )
+{
+    const int numOwned = subGrid.cell_local_to_global.size() - subGrid.number_of_ghost_cells;
+    auto isOwned = [&]( int gcell ) {
+        if ( gcell == Boundary::outer ) {
+            return true;
+        }
+        auto it = subGrid.cell_global_to_local.find( gcell );
+        return it != subGrid.cell_global_to_local.end() && it->second < numOwned;
+    };
+
+    // Stable partition of the faces, with the faces that touch a ghost cell last.
+    const int numFaces = participatingFaces.global_face.size();
+    std::vector<int> order;
+    std::vector<int> ghostFaces;
+    order.reserve( numFaces );
+    for( int lface = 0; lface < numFaces; ++lface ) {
+        const int gface = participatingFaces.global_face[lface];
+        if ( isOwned( grid->face_cells[2*gface] ) && isOwned( grid->face_cells[2*gface + 1] ) ) {
+            order.push_back( lface );
+        } else {
+            ghostFaces.push_back( lface );
+        }
+    }
+    order.insert( order.end(), ghostFaces.begin(), ghostFaces.end() );
+
+    std::vector<int> newIndex( numFaces );
+    std::vector<int> global_face( numFaces );
+    for( int i = 0; i < numFaces; ++i ) {
+        newIndex[ order[i] ] = i;
+        global_face[i] = participatingFaces.global_face[ order[i] ];
+    }
+
+    for( auto& face: participatingFaces.cell_faces ) {
+        face = newIndex[face];
+    }
+    for( auto& it: participatingFaces.face_global_to_local ) {
+        it.second = newIndex[it.second];
+    }
+    participatingFaces.global_face.swap( global_face );
+
+    return ghostFaces.size();
+}
+
 SubGrid SubGridBuilder::build(const UnstructuredGrid* grid, const std::vector<int>& cellsToExtract )
 {
     SubGrid subGrid;
 
     // Extract the cells and ghost-cells that that will be part of our subdomain    
     std::set<int> neighborCells = extractNeighborCells(grid, cellsToExtract);
-
-    // Build up the local to global mapping based on the input and the additional neighbor cells found above
-    subGrid.cell_local_to_global = cellsToExtract;
-    std::set_difference( neighborCells.begin(), neighborCells.end(), cellsToExtract.begin(), cellsToExtract.end(),
+    std::vector<int> sortedCells( cellsToExtract );
+    std::sort( sortedCells.begin(), sortedCells.end() );
+
+    // Build up the local to global mapping based on the input and the additional neighbor cells found above.
+    // The owned cells next to the ghost cells are put last, so that the interior can be computed while the
+    // ghost cells are exchanged.
+    subGrid.cell_local_to_global = orderOwnedCells( grid, cellsToExtract, sortedCells, subGrid.number_of_interior_cells );
+    std::set_difference( neighborCells.begin(), neighborCells.end(), sortedCells.begin(), sortedCells.end(),
                          std::back_inserter( subGrid.cell_local_to_global ) );
 
     // Build the inverse of global_cell
@@ -184,6 +352,7 @@ SubGrid SubGridBuilder::build(const UnstructuredGrid* grid, const std::vector<in
     subGrid.number_of_ghost_cells = subGrid.cell_local_to_global.size() - cellsToExtract.size();
 
     auto participatingFaces = extractNeighborFaces(grid, subGrid.cell_local_to_global);
+    subGrid.number_of_ghost_faces = orderFaces( participatingFaces, subGrid, grid );
     auto participatingNodes = extractNeighborNodes(grid, participatingFaces.global_face);
 
     subGrid.face_local_to_global = participatingFaces.global_face;
@@ -223,6 +392,26 @@ SubGrid SubGridBuilder::build(const UnstructuredGrid* grid, const std::vector<in
     auto& global_node = participatingNodes.global_node;
     reduceAndReindex( grid->node_coordinates, subGrid.c_grid->node_coordinates, global_node.data(), global_node.size(), dim );
 
+    // The logical Cartesian structure. The half-faces of every cell are in the same order as in the
+    // global grid, and global_cell maps to the Cartesian index, which is the global index without global_cell.
+    UnstructuredGrid* g = subGrid.c_grid;
+    std::copy( grid->cartdims, grid->cartdims + 3, g->cartdims );
+    std::free( g->cell_facetag );
+    g->cell_facetag = nullptr;
+    if ( grid->cell_facetag ) {
+        g->cell_facetag = static_cast<int*>( std::malloc( g->cell_facepos[ g->number_of_cells ] * sizeof( int ) ) );
+        for( int lcell = 0; lcell < g->number_of_cells; ++lcell ) {
+            const int gcell = subGrid.cell_local_to_global[lcell];
+            std::copy( grid->cell_facetag + grid->cell_facepos[gcell], grid->cell_facetag + grid->cell_facepos[gcell + 1],
+                       g->cell_facetag + g->cell_facepos[lcell] );
+        }
+    }
+    g->global_cell = static_cast<int*>( std::malloc( g->number_of_cells * sizeof( int ) ) );
+    for( int lcell = 0; lcell < g->number_of_cells; ++lcell ) {
+        const int gcell = subGrid.cell_local_to_global[lcell];
+        g->global_cell[lcell] = grid->global_cell ? grid->global_cell[gcell] : gcell;
+    }
+
     return subGrid;
 }
 
@@ -262,6 +451,42 @@ CollOfFace SubGrid::map_to_global(const CollOfFace &local_collection)
 }
 
 
+SubGrid SubGridBuilder::scatter( const UnstructuredGrid* globalGrid, const std::vector<int>& cellOwners,
+                                 int root, MPI_Comm comm )
+{
+    int rank, size;
+    MPI_SAFE_CALL( MPI_Comm_rank( comm, &rank ) );
+    MPI_SAFE_CALL( MPI_Comm_size( comm, &size ) );
+
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    if ( rank != root ) {
+        receiveAll( ints, MPI_INT, root, IntTag, comm );
+        receiveAll( doubles, MPI_DOUBLE, root, DoubleTag, comm );
+        return unpackSubGrid( ints, doubles );
+    }
+
+    std::vector<std::vector<int>> cellsOf( size );
+    for( int cell = 0; cell < globalGrid->number_of_cells; ++cell ) {
+        cellsOf[ cellOwners[cell] ].push_back( cell );
+    }
+
+    // One subgrid at a time, so that the root only holds the global grid and one other subgrid.
+    SubGrid own;
+    for( int r = 0; r < size; ++r ) {
+        if ( r == root ) {
+            own = build( globalGrid, cellsOf[r] );
+            continue;
+        }
+        SubGrid subGrid = build( globalGrid, cellsOf[r] );
+        packSubGrid( subGrid, ints, doubles );
+        destroy_grid( subGrid.c_grid );
+        MPI_SAFE_CALL( MPI_Send( ints.data(), ints.size(), MPI_INT, r, IntTag, comm ) );
+        MPI_SAFE_CALL( MPI_Send( doubles.data(), doubles.size(), MPI_DOUBLE, r, DoubleTag, comm ) );
+    }
+    return own;
+}
+
 SubGrid::~SubGrid()
 {
     //destroy_grid( c_grid );
@@ -0,0 +1,178 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/SubGridHaloExchange.hpp"
+#include "equelle/mpiutils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+namespace equelle {
+
+namespace {
+
+    /// Offsets of consecutive blocks with the given sizes, with the total as the last element.
+    std::vector<int> prefixSum( const std::vector<int>& counts )
+    {
+        std::vector<int> offsets( counts.size() + 1, 0 );
+        for ( size_t i = 0; i < counts.size(); ++i ) {
+            offsets[i + 1] = offsets[i] + counts[i];
+        }
+        return offsets;
+    }
+
+} // anonymous namespace
+
+
+SubGridHaloExchange::SubGridHaloExchange( const SubGrid& subGrid, MPI_Comm comm )
+    : comm_( MPI_COMM_NULL ), active_( false )
+{
+    MPI_SAFE_CALL( MPI_Comm_dup( comm, &comm_ ) );
+    int size;
+    MPI_SAFE_CALL( MPI_Comm_size( comm_, &size ) );
+
+    // Find the owner of every global cell, from the owned cells of all ranks.
+    const int num_cells = subGrid.cell_local_to_global.size();
+    const int num_owned = num_cells - subGrid.number_of_ghost_cells;
+    std::vector<int> owned_counts( size );
+    MPI_SAFE_CALL( MPI_Allgather( const_cast<int*>( &num_owned ), 1, MPI_INT, owned_counts.data(), 1, MPI_INT, comm_ ) );
+    const std::vector<int> owned_offsets = prefixSum( owned_counts );
+
+    std::vector<int> owned_ids( owned_offsets.back() );
+    MPI_SAFE_CALL( MPI_Allgatherv( const_cast<int*>( subGrid.cell_local_to_global.data() ), num_owned, MPI_INT,
+                                   owned_ids.data(), owned_counts.data(), owned_offsets.data(), MPI_INT, comm_ ) );
+
+    int num_global_cells = 0;
+    if ( !owned_ids.empty() ) {
+        num_global_cells = 1 + *std::max_element( owned_ids.begin(), owned_ids.end() );
+    }
+    std::vector<int> owner( num_global_cells, -1 );
+    for ( int r = 0; r < size; ++r ) {
+        for ( int i = owned_offsets[r]; i < owned_offsets[r + 1]; ++i ) {
+            owner[ owned_ids[i] ] = r;
+        }
+    }
+
+    // Group our ghost cells by owner, keeping the local order within each group.
+    std::vector<int> request_counts( size, 0 );
+    std::vector<int> ghost_owner( subGrid.number_of_ghost_cells );
+    for ( int g = 0; g < subGrid.number_of_ghost_cells; ++g ) {
+        const int global = subGrid.cell_local_to_global[ num_owned + g ];
+        if ( global >= num_global_cells || owner[global] < 0 ) {
+            std::stringstream ss;
+            ss << "Ghost cell " << global << " is not owned by any rank.";
+            throw std::runtime_error( ss.str() );
+        }
+        ghost_owner[g] = owner[global];
+        ++request_counts[ owner[global] ];
+    }
+    const std::vector<int> request_offsets = prefixSum( request_counts );
+
+    recv_cells_.resize( subGrid.number_of_ghost_cells );
+    std::vector<int> requested_ids( subGrid.number_of_ghost_cells );
+    std::vector<int> position( request_offsets.begin(), request_offsets.end() - 1 );
+    for ( int g = 0; g < subGrid.number_of_ghost_cells; ++g ) {
+        const int p = position[ ghost_owner[g] ]++;
+        recv_cells_[p] = num_owned + g;
+        requested_ids[p] = subGrid.cell_local_to_global[ num_owned + g ];
+    }
+
+    // Tell the owners which of their cells we need, in the order we will receive them.
+    std::vector<int> send_counts( size );
+    MPI_SAFE_CALL( MPI_Alltoall( request_counts.data(), 1, MPI_INT, send_counts.data(), 1, MPI_INT, comm_ ) );
+    const std::vector<int> all_send_offsets = prefixSum( send_counts );
+
+    std::vector<int> send_ids( all_send_offsets.back() );
+    MPI_SAFE_CALL( MPI_Alltoallv( requested_ids.data(), request_counts.data(), const_cast<int*>( request_offsets.data() ), MPI_INT,
+                                  send_ids.data(), send_counts.data(), const_cast<int*>( all_send_offsets.data() ), MPI_INT, comm_ ) );
+
+    send_cells_.resize( send_ids.size() );
+    for ( size_t i = 0; i < send_ids.size(); ++i ) {
+        auto it = subGrid.cell_global_to_local.find( send_ids[i] );
+        if ( it == subGrid.cell_global_to_local.end() || it->second >= num_owned ) {
+            std::stringstream ss;
+            ss << "Cell " << send_ids[i] << " was requested as a ghost cell, but is not owned by this rank.";
+            throw std::runtime_error( ss.str() );
+        }
+        send_cells_[i] = it->second;
+    }
+
+    // Keep only the ranks we actually talk to.
+    recv_offsets_.push_back( 0 );
+    send_offsets_.push_back( 0 );
+    for ( int r = 0; r < size; ++r ) {
+        if ( request_counts[r] > 0 ) {
+            recv_ranks_.push_back( r );
+            recv_offsets_.push_back( request_offsets[r + 1] );
+        }
+        if ( send_counts[r] > 0 ) {
+            send_ranks_.push_back( r );
+            send_offsets_.push_back( all_send_offsets[r + 1] );
+        }
+    }
+
+    // The buffers never move, so the requests can be bound to them once.
+    recv_buffer_.resize( recv_cells_.size() );
+    send_buffer_.resize( send_cells_.size() );
+    requests_.resize( recv_ranks_.size() + send_ranks_.size() );
+    const int tag = 0;
+    for ( size_t i = 0; i < recv_ranks_.size(); ++i ) {
+        MPI_SAFE_CALL( MPI_Recv_init( &recv_buffer_[ recv_offsets_[i] ], recv_offsets_[i + 1] - recv_offsets_[i], MPI_DOUBLE,
+                                      recv_ranks_[i], tag, comm_, &requests_[i] ) );
+    }
+    for ( size_t i = 0; i < send_ranks_.size(); ++i ) {
+        MPI_SAFE_CALL( MPI_Send_init( &send_buffer_[ send_offsets_[i] ], send_offsets_[i + 1] - send_offsets_[i], MPI_DOUBLE,
+                                      send_ranks_[i], tag, comm_, &requests_[ recv_ranks_.size() + i ] ) );
+    }
+}
+
+SubGridHaloExchange::~SubGridHaloExchange()
+{
+    if ( active_ ) {
+        MPI_Waitall( requests_.size(), requests_.data(), MPI_STATUSES_IGNORE );
+    }
+    for ( MPI_Request& request : requests_ ) {
+        MPI_Request_free( &request );
+    }
+    if ( comm_ != MPI_COMM_NULL ) {
+        MPI_Comm_free( &comm_ );
+    }
+}
+
+void SubGridHaloExchange::start( const double* values )
+{
+    if ( active_ ) {
+        throw std::logic_error( "SubGridHaloExchange::start() called twice without finish()." );
+    }
+    for ( size_t i = 0; i < send_cells_.size(); ++i ) {
+        send_buffer_[i] = values[ send_cells_[i] ];
+    }
+    if ( !requests_.empty() ) {
+        MPI_SAFE_CALL( MPI_Startall( requests_.size(), requests_.data() ) );
+    }
+    active_ = true;
+}
+
+void SubGridHaloExchange::finish( double* values )
+{
+    if ( !active_ ) {
+        throw std::logic_error( "SubGridHaloExchange::finish() called without start()." );
+    }
+    if ( !requests_.empty() ) {
+        MPI_SAFE_CALL( MPI_Waitall( requests_.size(), requests_.data(), MPI_STATUSES_IGNORE ) );
+    }
+    active_ = false;
+    for ( size_t i = 0; i < recv_cells_.size(); ++i ) {
+        values[ recv_cells_[i] ] = recv_buffer_[i];
+    }
+}
+
+void SubGridHaloExchange::exchange( double* values )
+{
+    start( values );
+    finish( values );
+}
+
+} // namespace equelle
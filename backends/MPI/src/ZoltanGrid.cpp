@@ -4,10 +4,12 @@
 #include <stdexcept>
 #include <iterator>
 #include <ostream>
+#include <iostream>
 #include <fstream>
+#include <cassert>
+#include <cmath>
 
 #include <opm/core/grid.h>
-#include <opm/autodiff/AutoDiffHelpers.hpp>
 
 
 #include "equelle/mpiutils.hpp"
@@ -21,88 +23,196 @@ int equelle::ZoltanGrid::getNumberOfObjects(void *data, int *ierr)
     return grid->number_of_cells;
 }
 
+namespace {
+
+    void listCells( const UnstructuredGrid& grid, ZOLTAN_ID_PTR globalId, ZOLTAN_ID_PTR localId,
+                    int wgt_dim, float* weights, const std::vector<float>& cellWeights )
+    {
+        for( auto i = 0; i < grid.number_of_cells; ++i ) {
+            globalId[i] = i;
+            localId[i]  = i;
+            if ( wgt_dim > 0 ) {
+                weights[i] = cellWeights.empty() ? 1.0f : cellWeights[i];
+            }
+        }
+    }
+
+    /// The neighbors of a cell are the other cells of its interior faces, in the order of cell_faces.
+    void listEdges( const UnstructuredGrid& grid, int num_obj, ZOLTAN_ID_PTR local_ids,
+                    ZOLTAN_ID_PTR nbor_global_id, int* nbor_procs,
+                    int wgt_dim, float* ewgts, const std::vector<float>& faceWeights )
+    {
+        const int rank = equelle::getMPIRank();
+        int offset = 0;
+        for( int i = 0; i < num_obj; ++i ) {
+            const int cell = local_ids[i];
+            for( int hf = grid.cell_facepos[cell]; hf < grid.cell_facepos[cell + 1]; ++hf ) {
+                const int face = grid.cell_faces[hf];
+                const int c0 = grid.face_cells[2*face];
+                const int c1 = grid.face_cells[2*face + 1];
+                if ( c0 < 0 || c1 < 0 ) {
+                    continue;
+                }
+                nbor_global_id[offset] = ( c0 == cell ) ? c1 : c0;
+                nbor_procs[offset] = rank;
+                if ( wgt_dim > 0 ) {
+                    ewgts[offset] = faceWeights.empty() ? 1.0f : faceWeights[face];
+                }
+                ++offset;
+            }
+        }
+    }
+
+    double distance( const double* a, const double* b, int dim )
+    {
+        double d2 = 0.0;
+        for( int d = 0; d < dim; ++d ) {
+            d2 += ( a[d] - b[d] ) * ( a[d] - b[d] );
+        }
+        return std::sqrt( d2 );
+    }
+
+} // anonymous namespace
+
+std::vector<float> equelle::ZoltanGrid::faceCountWeights( const UnstructuredGrid& grid )
+{
+    std::vector<float> weights( grid.number_of_cells );
+    for( int c = 0; c < grid.number_of_cells; ++c ) {
+        weights[c] = grid.cell_facepos[c + 1] - grid.cell_facepos[c];
+    }
+    return weights;
+}
+
+std::vector<float> equelle::ZoltanGrid::faceAreaWeights( const UnstructuredGrid& grid )
+{
+    return std::vector<float>( grid.face_areas, grid.face_areas + grid.number_of_faces );
+}
+
+std::vector<float> equelle::ZoltanGrid::transmissibilityWeights( const UnstructuredGrid& grid )
+{
+    const int dim = grid.dimensions;
+    std::vector<float> weights( grid.number_of_faces, 0.0f );
+    for( int f = 0; f < grid.number_of_faces; ++f ) {
+        const int c0 = grid.face_cells[2*f];
+        const int c1 = grid.face_cells[2*f + 1];
+        if ( c0 >= 0 && c1 >= 0 ) {
+            weights[f] = grid.face_areas[f] / distance( grid.cell_centroids + dim*c0, grid.cell_centroids + dim*c1, dim );
+        }
+    }
+    return weights;
+}
+
 void equelle::ZoltanGrid::getCellList( void *data, int /*sizeGID*/, int /*sizeLID*/,
                                        ZOLTAN_ID_PTR globalId, ZOLTAN_ID_PTR localId,
-                                       int /*wgt_dim*/, float* /* weights */, int *ierr )
+                                       int wgt_dim, float* weights, int *ierr )
 {
     *ierr = ZOLTAN_OK;
     auto grid = reinterpret_cast<UnstructuredGrid*>( data );
 
-    for( auto i = 0; i < grid->number_of_cells; ++i ) {
-        globalId[i] = i;
-        localId[i]  = i;
-        //weights[i]  = 1.0f;
-    }
+    listCells( *grid, globalId, localId, wgt_dim, weights, std::vector<float>() );
+}
+
+void equelle::ZoltanGrid::getWeightedCellList( void *data, int /*sizeGID*/, int /*sizeLID*/,
+                                               ZOLTAN_ID_PTR globalId, ZOLTAN_ID_PTR localId,
+                                               int wgt_dim, float* weights, int *ierr )
+{
+    *ierr = ZOLTAN_OK;
+    auto w = reinterpret_cast<Weights*>( data );
+
+    listCells( *w->grid, globalId, localId, wgt_dim, weights, w->cells );
 }
 
 // Should we call it getNumberOfNeighbors (for a given cell?) In other words, the number of interior edges.
 void equelle::ZoltanGrid::getNumberOfEdgesMulti( void *data, int /* num_gid_entries */, int /* num_lid_entries */,  int num_obj,
-                                           ZOLTAN_ID_PTR  /*global_id*/  , ZOLTAN_ID_PTR /* local_id */ , int* numEdges, int *ierr )
+                                           ZOLTAN_ID_PTR  /*global_id*/  , ZOLTAN_ID_PTR local_id, int* numEdges, int *ierr )
 {
     *ierr = ZOLTAN_FATAL;
 
     auto grid = reinterpret_cast<UnstructuredGrid*>( data );
 
-
-    // The connectivity graph contains the number of neighbors for each cell on the diagonal
-    // and the index of the nonzero, and equal to -1, entries of the row contains the neighboring cell ID.
-    // Proof is by assuming c_1 is neighbor to c_2.
-    // - On the diagnoal this sums the number of neighbors.
-    // - On the nonzero entries this is always -1 due to the orientation of the edges (always 1*(-1) or vice versa).
-    Opm::HelperOps helperOps( *grid );
-    Opm::HelperOps::M adj = helperOps.div * helperOps.ngrad;
-
-    auto diag = adj.diagonal();
+    // Every interior face of a cell is an edge to the cell on its other side.
     for( int i = 0; i < num_obj; ++i ) {
-        numEdges[i] = diag[i];
+        const int cell = local_id[i];
+        numEdges[i] = 0;
+        for( int hf = grid->cell_facepos[cell]; hf < grid->cell_facepos[cell + 1]; ++hf ) {
+            const int face = grid->cell_faces[hf];
+            if ( grid->face_cells[2*face] >= 0 && grid->face_cells[2*face + 1] >= 0 ) {
+                ++numEdges[i];
+            }
+        }
     }
 
     *ierr = ZOLTAN_OK;
 }
 
 void equelle::ZoltanGrid::getEdgeListMulti(void *data, int /* num_gid_entries */, int /* num_lid_entries */, int num_obj,
-                                           ZOLTAN_ID_PTR /* global_ids */, ZOLTAN_ID_PTR /* local_ids */ , int *num_edges,
+                                           ZOLTAN_ID_PTR /* global_ids */, ZOLTAN_ID_PTR local_ids, int* /* num_edges */,
                                            ZOLTAN_ID_PTR nbor_global_id, int *nbor_procs,
-                                           int /* wgt_dim */ , float */* ewgts */, int *ierr )
+                                           int wgt_dim, float* ewgts, int *ierr )
 {
     *ierr = ZOLTAN_FATAL;
     auto grid = reinterpret_cast<UnstructuredGrid*>( data );
     assert( num_obj == grid->number_of_cells );
 
-    // The connectivity graph contains the number of neighbors for each cell on the diagonal
-    // and the index of the nonzero, and equal to -1, entries of the row contains the neighboring cell ID.
-    // Proof is by assuming c_1 is neighbor to c_2.
-    // - On the diagnoal this sums the number of neighbors.
-    // - On the nonzero entries this is always -1 due to the orientation of the edges (always 1*(-1) or vice versa).
-    Opm::HelperOps helperOps( *grid );
-    Opm::HelperOps::M adj = helperOps.div * helperOps.ngrad;
-
-    // The global id of the neighbors of a cell are given by the column-index of the nonzero, non-diagonal, entries of each row.
-    // These values are always -1.
-    int global_offset = 0;
-    for( int k = 0; k < adj.outerSize(); ++k ) {
-        for( Eigen::SparseMatrix<double>::InnerIterator it( adj, k); it; ++it ) {                       
-            if( it.row() == it.col() ) { // Skip diagonal elements
-                assert( it.value() == num_edges[k] );
-            } else {
-                // By using it.index() we can ignore what is the inner and outer dimensions. (Ie col-major or row-major.)
-                nbor_global_id[global_offset] = it.index();
-                nbor_procs[global_offset] = equelle::getMPIRank();
-                global_offset++;
-            }
-        }       
-    }    
+    listEdges( *grid, num_obj, local_ids, nbor_global_id, nbor_procs, wgt_dim, ewgts, std::vector<float>() );
 
     *ierr = ZOLTAN_OK;
 }
 
-void equelle::ZoltanGrid::dumpRank0Exports( int numCells, const equelle::zoltanReturns& zr, std::ostream& out)
+void equelle::ZoltanGrid::getWeightedEdgeListMulti( void *data, int /* num_gid_entries */, int /* num_lid_entries */, int num_obj,
+                                                    ZOLTAN_ID_PTR /* global_ids */, ZOLTAN_ID_PTR local_ids, int* /* num_edges */,
+                                                    ZOLTAN_ID_PTR nbor_global_id, int *nbor_procs,
+                                                    int wgt_dim, float* ewgts, int *ierr )
+{
+    *ierr = ZOLTAN_FATAL;
+    auto w = reinterpret_cast<Weights*>( data );
+    assert( num_obj == w->grid->number_of_cells );
+
+    listEdges( *w->grid, num_obj, local_ids, nbor_global_id, nbor_procs, wgt_dim, ewgts, w->faces );
+
+    *ierr = ZOLTAN_OK;
+}
+
+int equelle::ZoltanGrid::getNumberOfGeometryDimensions( void *data, int *ierr )
+{
+    auto grid = reinterpret_cast<UnstructuredGrid*>( data );
+
+    *ierr = ZOLTAN_OK;
+
+    return grid->dimensions;
+}
+
+void equelle::ZoltanGrid::getGeometryMulti( void *data, int /* num_gid_entries */, int /* num_lid_entries */, int num_obj,
+                                            ZOLTAN_ID_PTR /* global_ids */, ZOLTAN_ID_PTR local_ids,
+                                            int num_dim, double *geom_vec, int *ierr )
+{
+    *ierr = ZOLTAN_FATAL;
+    auto grid = reinterpret_cast<UnstructuredGrid*>( data );
+    if ( num_dim != grid->dimensions ) {
+        return;
+    }
+
+    for( int i = 0; i < num_obj; ++i ) {
+        const double* centroid = grid->cell_centroids + num_dim*local_ids[i];
+        std::copy( centroid, centroid + num_dim, geom_vec + num_dim*i );
+    }
+
+    *ierr = ZOLTAN_OK;
+}
+
+std::vector<int> equelle::ZoltanGrid::rank0CellOwners( int numCells, const equelle::zoltanReturns& zr )
 {
     std::vector<int> v( numCells, 0 ); // By default all nodes belong to rank 0.
 
     for( int i = 0; i < zr.numExport; ++i ) {
         v[ zr.exportGlobalGids[i] ] = zr.exportProcs[i];
     }
+    return v;
+}
+
+void equelle::ZoltanGrid::dumpRank0Exports( int numCells, const equelle::zoltanReturns& zr, std::ostream& out)
+{
+    const std::vector<int> v = rank0CellOwners( numCells, zr );
     std::copy( v.begin(), v.end(), std::ostream_iterator<int>( out, " " ) );
     std::cout << std::endl;
 
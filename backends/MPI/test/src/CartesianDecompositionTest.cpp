@@ -0,0 +1,151 @@
+#define BOOST_TEST_NO_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+#include <numeric>
+
+#include "equelle/CartesianDecomposition.hpp"
+#include "equelle/mpiutils.hpp"
+
+using namespace equelle;
+
+namespace {
+
+    /// Runs steps of a stencil that also reads the diagonal neighbours, on u0 with reflective boundaries.
+    template <class Range, class Fill>
+    void runNinePoint( int steps, StencilCollOfScalar& u, StencilCollOfScalar& u0, const Range& range, const Fill& fill )
+    {
+        for ( int step = 0; step < steps; ++step ) {
+            fill( u0 );
+            range( [&]( int i, int j ) {
+                    const CartesianGrid& g = u.grid;
+                    g.cellAt( u, i, j ) = 0.5*g.cellAt( u0, i, j )
+                        + 0.1*( g.cellAt( u0, i+1, j ) + g.cellAt( u0, i-1, j ) + g.cellAt( u0, i, j+1 ) + g.cellAt( u0, i, j-1 ) )
+                        + 0.025*( g.cellAt( u0, i+1, j+1 ) + g.cellAt( u0, i-1, j+1 ) + g.cellAt( u0, i+1, j-1 ) + g.cellAt( u0, i-1, j-1 ) );
+                }, u0 );
+            u0.swapAssign( u );
+        }
+    }
+
+    std::vector<double> initialValues( int n )
+    {
+        std::vector<double> values( n );
+        for ( int c = 0; c < n; ++c ) {
+            values[c] = ( c * 7919 ) % 101;
+        }
+        return values;
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE( cartesianDecompositionBlocks ) {
+    CartesianDecomposition decomposition( {{ 13, 7, 1 }}, 2, 1 );
+
+    BOOST_CHECK_EQUAL( decomposition.procs[0] * decomposition.procs[1], equelle::getMPISize() );
+
+    int cells = decomposition.grid.number_of_cells;
+    int total = 0;
+    MPI_Allreduce( &cells, &total, 1, MPI_INT, MPI_SUM, decomposition.comm );
+    BOOST_CHECK_EQUAL( total, 13*7 );
+
+    for ( int d = 0; d < 2; ++d ) {
+        const bool first = decomposition.coords[d] == 0;
+        const bool last = decomposition.coords[d] == decomposition.procs[d] - 1;
+        BOOST_CHECK_EQUAL( decomposition.isOnDomainBoundary( static_cast<CartesianGrid::Face>( 2*d ) ), first );
+        BOOST_CHECK_EQUAL( decomposition.isOnDomainBoundary( static_cast<CartesianGrid::Face>( 2*d + 1 ) ), last );
+        BOOST_CHECK_EQUAL( decomposition.offset[d] == 0, first );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( cartesianScatterGather ) {
+    CartesianDecomposition decomposition( {{ 9, 5, 4 }}, 3, 2 );
+    const std::vector<double> global = initialValues( 9*5*4 );
+
+    StencilCollOfScalar u( std::make_tuple( decomposition.grid.cartdims[0], decomposition.grid.cartdims[1],
+                                            decomposition.grid.cartdims[2] ), 2 );
+    decomposition.scatterInterior( global, u );
+    BOOST_CHECK_EQUAL( decomposition.grid.cellAt( u, 0, 0, 0 ),
+                       global[ ( decomposition.offset[2]*5 + decomposition.offset[1] )*9 + decomposition.offset[0] ] );
+
+    const std::vector<double> gathered = decomposition.gatherInterior( u );
+    if ( decomposition.rank == 0 ) {
+        BOOST_CHECK_EQUAL_COLLECTIONS( gathered.begin(), gathered.end(), global.begin(), global.end() );
+    }
+}
+
+// The decomposed run, with halo exchange overlapping the interior sweep, must reproduce the serial run.
+BOOST_AUTO_TEST_CASE( cartesianHaloExchangeMatchesSerial ) {
+    const int nx = 17;
+    const int ny = 11;
+    const int steps = 5;
+    const std::vector<double> initial = initialValues( nx*ny );
+
+    CartesianDecomposition decomposition( {{ nx, ny, 1 }}, 2, 1 );
+    CartesianHaloExchange halo( decomposition );
+    const std::tuple<int, int> local_dims( decomposition.grid.cartdims[0], decomposition.grid.cartdims[1] );
+    StencilCollOfScalar u( local_dims, 1 );
+    StencilCollOfScalar u0( local_dims, 1 );
+    decomposition.scatterInterior( initial, u0 );
+
+    runNinePoint( steps, u, u0,
+                  [&]( const std::function<void(int, int)>& stencil, StencilCollOfScalar& in ) {
+                      halo.executeOverlapped( in, stencil );
+                  },
+                  [&]( StencilCollOfScalar& in ) {
+                      for ( int side = 0; side < 4; ++side ) {
+                          decomposition.applyBoundaryCondition( in, static_cast<CartesianGrid::Face>( side ), BoundaryCondition::Reflective );
+                      }
+                  } );
+    const std::vector<double> distributed = decomposition.gatherInterior( u0 );
+
+    if ( decomposition.rank == 0 ) {
+        StencilCollOfScalar s( std::make_tuple( nx, ny ), 1 );
+        StencilCollOfScalar s0( std::make_tuple( nx, ny ), 1 );
+        for ( int j = 0; j < ny; ++j ) {
+            for ( int i = 0; i < nx; ++i ) {
+                s0.grid.cellAt( s0, i, j ) = initial[ j*nx + i ];
+            }
+        }
+        runNinePoint( steps, s, s0,
+                      [&]( const std::function<void(int, int)>& stencil, StencilCollOfScalar& ) {
+                          s.grid.allCells().execute( stencil );
+                      },
+                      [&]( StencilCollOfScalar& in ) {
+                          for ( int side = 0; side < 4; ++side ) {
+                              in.grid.applyBoundaryCondition( in, static_cast<CartesianGrid::Face>( side ), BoundaryCondition::Reflective );
+                          }
+                      } );
+        for ( int j = 0; j < ny; ++j ) {
+            for ( int i = 0; i < nx; ++i ) {
+                BOOST_CHECK_CLOSE( distributed[ j*nx + i ], s0.grid.cellAt( s0, i, j ), 1e-10 );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( cartesianPeriodicHaloExchange ) {
+    // Each interior cell holds its global index, so the ghost cells must hold the wrapped-around index.
+    const int nx = 8;
+    const int ny = 6;
+    CartesianDecomposition decomposition( {{ nx, ny, 1 }}, 2, 2, {{ 0, 0, 0 }}, {{ true, true, false }} );
+    CartesianHaloExchange halo( decomposition );
+    std::vector<double> global( nx*ny );
+    std::iota( global.begin(), global.end(), 0.0 );
+
+    const CartesianGrid& grid = decomposition.grid;
+    StencilCollOfScalar u( std::make_tuple( grid.cartdims[0], grid.cartdims[1] ), 2 );
+    decomposition.scatterInterior( global, u );
+    halo.exchange( u );
+    // Exchange once more, to check that the persistent requests can be restarted.
+    halo.exchange( u );
+
+    for ( int j = -2; j < grid.cartdims[1] + 2; ++j ) {
+        for ( int i = -2; i < grid.cartdims[0] + 2; ++i ) {
+            const int gi = ( decomposition.offset[0] + i + nx ) % nx;
+            const int gj = ( decomposition.offset[1] + j + ny ) % ny;
+            BOOST_CHECK_EQUAL( grid.cellAt( u, i, j ), gj*nx + gi );
+        }
+    }
+}
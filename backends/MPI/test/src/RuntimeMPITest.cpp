@@ -1,6 +1,7 @@
 #define BOOST_TEST_NO_MAIN
 
 #include <boost/test/unit_test.hpp>
+#include <numeric>
 #include "equelle/RuntimeMPI.hpp"
 #include "equelle/EquelleRuntimeCPU.hpp"
 #include "equelle/mpiutils.hpp"
@@ -38,6 +39,286 @@ BOOST_AUTO_TEST_CASE( allGather ) {
                                    a_0.begin(), a_0.end() );
 }
 
+BOOST_AUTO_TEST_CASE( allGather_domains ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    std::vector<double> a_0( 5*4 );
+    for ( size_t i = 0; i < a_0.size(); ++i ) {
+        a_0[i] = ( 3*i ) % 7;
+    }
+    injectMockData( param, "a", a_0.begin(), a_0.end() );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+    equelle::EquelleRuntimeCPU ser( param );
+
+    const CollOfScalar a = er.inputCollectionOfScalar( "a", er.allCells() );
+    const CollOfScalar grad = er.gradient( a );
+    const CollOfScalar sgrad = ser.gradient( ser.inputCollectionOfScalar( "a", ser.allCells() ) );
+
+    // Gather each domain twice, the second time with the cached plan.
+    for ( int repeat = 0; repeat < 2; ++repeat ) {
+        const CollOfScalar a_global = er.allGather( a );
+        BOOST_CHECK_EQUAL_COLLECTIONS( a_global.value().data(), a_global.value().data() + a_global.size(),
+                                       a_0.begin(), a_0.end() );
+
+        const CollOfScalar grad_global = er.allGather( grad, er.interiorFaces() );
+        BOOST_CHECK_EQUAL_COLLECTIONS( grad_global.value().data(), grad_global.value().data() + grad_global.size(),
+                                       sgrad.value().data(), sgrad.value().data() + sgrad.size() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( updateGhosts ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    std::vector<double> a_0( 5*4 );
+    std::iota( a_0.begin(), a_0.end(), 0.0 );
+    injectMockData( param, "a", a_0.begin(), a_0.end() );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+
+    // Make the ghost cells stale, as a computation that only is correct on the owned cells would.
+    const CollOfScalar a = er.inputCollectionOfScalar( "a", er.allCells() );
+    const int num_owned = a.size() - er.subGrid.number_of_ghost_cells;
+    CollOfScalar::V stale = a.value();
+    stale.tail( er.subGrid.number_of_ghost_cells ) = -1.0;
+
+    // Exchange twice, to check that the persistent requests can be restarted.
+    const CollOfScalar u = er.updateGhosts( er.updateGhosts( CollOfScalar( stale ) ) );
+    for ( int i = 0; i < u.size(); ++i ) {
+        BOOST_CHECK_EQUAL( u.value()[i], er.subGrid.cell_local_to_global[i] );
+    }
+
+    // The gradient on every face of an owned cell must match the serial gradient,
+    // also when it has to update the stale ghost cells itself.
+    equelle::EquelleRuntimeCPU ser( param );
+    const CollOfFace global_interior = ser.interiorFaces();
+    const CollOfScalar global_grad = ser.gradient( ser.inputCollectionOfScalar( "a", ser.allCells() ) );
+
+    const CollOfFace interior = er.interiorFaces();
+    const CollOfCell first = er.firstCell( interior );
+    const CollOfCell second = er.secondCell( interior );
+    const CollOfScalar grad = er.gradient( CollOfScalar( stale ) );
+    for ( int f = 0; f < int( interior.size() ); ++f ) {
+        if ( first[f].index >= num_owned && second[f].index >= num_owned ) {
+            continue;
+        }
+        const Face global_face( er.subGrid.face_local_to_global[ interior[f].index ] );
+        auto it = std::find( global_interior.begin(), global_interior.end(), global_face );
+        BOOST_REQUIRE( it != global_interior.end() );
+        BOOST_CHECK_EQUAL( grad.value()[f], global_grad.value()[ it - global_interior.begin() ] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( updateGhosts_derivatives ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    std::vector<double> a_0( 5*4 );
+    std::iota( a_0.begin(), a_0.end(), 0.0 );
+    injectMockData( param, "a", a_0.begin(), a_0.end() );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+
+    // Up to date ghost cells keep their derivatives, also through the gradient.
+    const CollOfScalar a = er.inputCollectionOfScalar( "a", er.allCells() );
+    const std::vector<int> block_pattern( 1, a.size() );
+    const CollOfScalar u = CollOfScalar::variable( 0, a.value(), block_pattern );
+    const CollOfScalar w = er.updateGhosts( 2.0 * u );
+    BOOST_REQUIRE_EQUAL( w.derivative().size(), 1 );
+    BOOST_CHECK_EQUAL( w.derivative()[0].nonZeros(), a.size() );
+    BOOST_CHECK_EQUAL( w.derivative()[0].coeff( a.size() - 1, a.size() - 1 ), 2.0 );
+    BOOST_CHECK_EQUAL( er.gradient( u ).derivative().size(), 1 );
+
+    // Stale ghost cells cannot be given the derivatives of their owners.
+    CollOfScalar::V stale = a.value();
+    stale.tail( er.subGrid.number_of_ghost_cells ) = -1.0;
+    BOOST_CHECK_THROW( er.updateGhosts( CollOfScalar::variable( 0, stale, block_pattern ) ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( newtonSolve ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "6" );
+    param.insertParameter( "ny", "5" );
+    param.insertParameter( "abs_res_tol", "1e-10" );
+    param.insertParameter( "linsolver_residual_tolerance", "1e-12" );
+    std::vector<double> u0_0( 6*5 );
+    for ( size_t i = 0; i < u0_0.size(); ++i ) {
+        u0_0[i] = 1.0 + 0.1 * ( i % 7 );
+    }
+    injectMockData( param, "u0", u0_0.begin(), u0_0.end() );
+
+    // A nonlinear implicit step, so that the Jacobian couples the cells across the node boundaries.
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+    const CollOfScalar u0 = er.inputCollectionOfScalar( "u0", er.allCells() );
+    auto residual = [&]( const CollOfScalar& u ) -> CollOfScalar {
+        return u - u0 + double(0.5) * er.divergence( -er.gradient( u ) ) + double(0.1) * ( u * u );
+    };
+    const CollOfScalar u = er.allGather( er.newtonSolve( residual, u0 ) );
+
+    equelle::EquelleRuntimeCPU ser( param );
+    const CollOfScalar su0 = ser.inputCollectionOfScalar( "u0", ser.allCells() );
+    auto serialResidual = [&]( const CollOfScalar& su ) -> CollOfScalar {
+        return su - su0 + double(0.5) * ser.divergence( -ser.gradient( su ) ) + double(0.1) * ( su * su );
+    };
+    const CollOfScalar su = ser.newtonSolve( serialResidual, su0 );
+
+    BOOST_REQUIRE_EQUAL( u.size(), su.size() );
+    for ( int i = 0; i < u.size(); ++i ) {
+        BOOST_CHECK_CLOSE( u.value()[i], su.value()[i], 1e-6 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( reductions ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    std::vector<double> a_0( 5*4 );
+    for ( size_t i = 0; i < a_0.size(); ++i ) {
+        a_0[i] = 1.0 + 0.01 * ( ( 7*i ) % 20 );
+    }
+    injectMockData( param, "a", a_0.begin(), a_0.end() );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+    equelle::EquelleRuntimeCPU ser( param );
+
+    // On cells, where the ghost cells must be left out.
+    const CollOfScalar a = er.inputCollectionOfScalar( "a", er.allCells() );
+    const CollOfScalar sa = ser.inputCollectionOfScalar( "a", ser.allCells() );
+    BOOST_CHECK_EQUAL( er.minReduce( a, er.allCells() ), ser.minReduce( sa ) );
+    BOOST_CHECK_EQUAL( er.maxReduce( a, er.allCells() ), ser.maxReduce( sa ) );
+    BOOST_CHECK_CLOSE( er.sumReduce( a, er.allCells() ), ser.sumReduce( sa ), 1e-12 );
+    BOOST_CHECK_CLOSE( er.prodReduce( a, er.allCells() ), ser.prodReduce( sa ), 1e-12 );
+
+    // On faces, where the faces shared with other nodes must be counted once.
+    const CollOfScalar grad = er.gradient( a );
+    const CollOfScalar sgrad = ser.gradient( sa );
+    BOOST_CHECK_EQUAL( er.maxReduce( grad, er.interiorFaces() ), ser.maxReduce( sgrad ) );
+    BOOST_CHECK_CLOSE( er.sumReduce( grad * grad, er.interiorFaces() ), ser.sumReduce( sgrad * sgrad ), 1e-12 );
+
+    // Several reductions in one batch.
+    const std::vector<Scalar> batch = er.reduce( { er.partialReduce( RuntimeMPI::Max, grad, er.interiorFaces() ),
+                                                   er.partialReduce( RuntimeMPI::Sum, a, er.allCells() ),
+                                                   er.partialReduce( RuntimeMPI::Min, a, er.allCells() ) } );
+    BOOST_REQUIRE_EQUAL( batch.size(), 3 );
+    BOOST_CHECK_EQUAL( batch[0], ser.maxReduce( sgrad ) );
+    BOOST_CHECK_CLOSE( batch[1], ser.sumReduce( sa ), 1e-12 );
+    BOOST_CHECK_EQUAL( batch[2], ser.minReduce( sa ) );
+}
+
+BOOST_AUTO_TEST_CASE( inputCollectionOfScalar_binary ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    std::vector<double> a_0( 5*4 );
+    for ( size_t i = 0; i < a_0.size(); ++i ) {
+        a_0[i] = 0.5 * i - 3.0;
+    }
+    if ( equelle::getMPIRank() == 0 ) {
+        std::ofstream f( "a_binary.mockdata", std::ios::out | std::ios::binary );
+        f.write( reinterpret_cast<const char*>( a_0.data() ), a_0.size() * sizeof( double ) );
+    }
+    MPI_Barrier( MPI_COMM_WORLD );
+    param.insertParameter( "a_from_file", "true" );
+    param.insertParameter( "a_filename", "a_binary.mockdata" );
+    param.insertParameter( "a_binary", "true" );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+
+    // Every node reads its own cells, ghost cells included.
+    const CollOfScalar a = er.inputCollectionOfScalar( "a", er.allCells() );
+    BOOST_REQUIRE_EQUAL( a.size(), er.subGrid.cell_local_to_global.size() );
+    for ( int i = 0; i < a.size(); ++i ) {
+        BOOST_CHECK_EQUAL( a.value()[i], a_0[ er.subGrid.cell_local_to_global[i] ] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( inputCollectionOfScalar_binaryTooShort ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    // The last cell is missing, so only the nodes that hold it find the file too short.
+    const std::vector<double> a_0( 5*4 - 1, 1.0 );
+    if ( equelle::getMPIRank() == 0 ) {
+        std::ofstream f( "a_short.mockdata", std::ios::out | std::ios::binary );
+        f.write( reinterpret_cast<const char*>( a_0.data() ), a_0.size() * sizeof( double ) );
+    }
+    MPI_Barrier( MPI_COMM_WORLD );
+    param.insertParameter( "a_from_file", "true" );
+    param.insertParameter( "a_filename", "a_short.mockdata" );
+    param.insertParameter( "a_binary", "true" );
+    param.insertParameter( "b", "1.0" );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+
+    // All nodes must throw, and leave the communicator usable.
+    BOOST_CHECK_THROW( er.inputCollectionOfScalar( "a", er.allCells() ), std::runtime_error );
+    const CollOfScalar ones = er.inputCollectionOfScalar( "b", er.allCells() );
+    BOOST_CHECK_EQUAL( er.sumReduce( ones, er.allCells() ), 5*4 );
+}
+
+BOOST_AUTO_TEST_CASE( output_binary ) {
+    BOOST_REQUIRE_MESSAGE( equelle::getMPISize() > 1, "Test requires program to be run with mpirun." );
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+
+    param.insertParameter( "nx", "5" );
+    param.insertParameter( "ny", "4" );
+    param.insertParameter( "output_format", "binary" );
+    std::vector<double> a_0( 5*4 );
+    for ( size_t i = 0; i < a_0.size(); ++i ) {
+        a_0[i] = 0.25 * i + 1.0;
+    }
+    injectMockData( param, "a", a_0.begin(), a_0.end() );
+
+    equelle::RuntimeMPI er( param );
+    er.decompose();
+
+    // Stale ghost cells must not end up in the file, as only the owned cells are written.
+    CollOfScalar::V a = er.inputCollectionOfScalar( "a", er.allCells() ).value();
+    a.tail( er.subGrid.number_of_ghost_cells ) = -1.0;
+    er.output( "binary_a", CollOfScalar( a ) );
+    er.output( "binary_a", CollOfScalar( 2.0 * a ) );
+
+    std::vector<double> written( a_0.size() + 1 );
+    if ( equelle::getMPIRank() == 0 ) {
+        std::ifstream f( "binary_a-00001.bin", std::ios::in | std::ios::binary );
+        f.read( reinterpret_cast<char*>( written.data() ), written.size() * sizeof( double ) );
+        BOOST_CHECK_EQUAL( f.gcount(), a_0.size() * sizeof( double ) );
+        for ( size_t i = 0; i < a_0.size(); ++i ) {
+            BOOST_CHECK_EQUAL( written[i], 2.0 * a_0[i] );
+        }
+    }
+}
 
 BOOST_AUTO_TEST_CASE( inputScalarWithDefault ) {
     Opm::parameter::ParameterGroup param;
@@ -25,34 +25,35 @@ BOOST_AUTO_TEST_CASE( SubGridBuilder ) {
     BOOST_CHECK( !subGrid.face_global_to_local.empty() );
     BOOST_CHECK_EQUAL( subGrid.c_grid->number_of_cells, 3 );
     BOOST_CHECK_EQUAL( subGrid.number_of_ghost_cells, 1 );
+    BOOST_CHECK_EQUAL( subGrid.number_of_interior_cells, 1 );
     BOOST_CHECK_EQUAL( subGrid.face_local_to_global.size(), subGrid.c_grid->number_of_faces );
     BOOST_CHECK_EQUAL( subGrid.cell_local_to_global.size(), subGrid.c_grid->number_of_cells );
 
-    // Check the local to global mapping
-    BOOST_CHECK_EQUAL( 4, subGrid.cell_local_to_global[0] );
-    BOOST_CHECK_EQUAL( 5, subGrid.cell_local_to_global[1] );
+    // Check the local to global mapping. Cell 4 is next to the ghost cell, so it comes after cell 5.
+    BOOST_CHECK_EQUAL( 5, subGrid.cell_local_to_global[0] );
+    BOOST_CHECK_EQUAL( 4, subGrid.cell_local_to_global[1] );
     BOOST_CHECK_EQUAL( 3, subGrid.cell_local_to_global[2] );
 
     const int dim = subGrid.c_grid->dimensions;
 
     // Check copying of centroids
-    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*0)+0], globalGrid->cell_centroids[(4*dim)+0] );
-    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*0)+1], globalGrid->cell_centroids[(4*dim)+1] );
+    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*0)+0], globalGrid->cell_centroids[(5*dim)+0] );
+    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*0)+1], globalGrid->cell_centroids[(5*dim)+1] );
 
-    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*1)+0], globalGrid->cell_centroids[(5*dim)+0] );
-    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*1)+1], globalGrid->cell_centroids[(5*dim)+1] );
+    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*1)+0], globalGrid->cell_centroids[(4*dim)+0] );
+    BOOST_CHECK_EQUAL( localGrid->cell_centroids[(dim*1)+1], globalGrid->cell_centroids[(4*dim)+1] );
 
     BOOST_CHECK_EQUAL( subGrid.c_grid->cell_centroids[(dim*2)+0], globalGrid->cell_centroids[(3*dim)+0] );
     BOOST_CHECK_EQUAL( subGrid.c_grid->cell_centroids[(dim*2)+1], globalGrid->cell_centroids[(3*dim)+1] );
 
     // Check copying of the cell volumes
-    BOOST_CHECK_EQUAL( localGrid->cell_volumes[0], globalGrid->cell_volumes[4] );
-    BOOST_CHECK_EQUAL( localGrid->cell_volumes[1], globalGrid->cell_volumes[5] );
+    BOOST_CHECK_EQUAL( localGrid->cell_volumes[0], globalGrid->cell_volumes[5] );
+    BOOST_CHECK_EQUAL( localGrid->cell_volumes[1], globalGrid->cell_volumes[4] );
     BOOST_CHECK_EQUAL( localGrid->cell_volumes[2], globalGrid->cell_volumes[3] );
 
     // Check that we preserve the number of faces
-    BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( globalGrid, 4), equelle::GridQuerying::numFaces( localGrid, 0 ) );
-    BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( globalGrid, 5), equelle::GridQuerying::numFaces( localGrid, 1 ) );
+    BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( globalGrid, 5), equelle::GridQuerying::numFaces( localGrid, 0 ) );
+    BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( globalGrid, 4), equelle::GridQuerying::numFaces( localGrid, 1 ) );
     BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( globalGrid, 3), equelle::GridQuerying::numFaces( localGrid, 2 ) );
 
     // Check that the face_cell mapping is correct.
@@ -63,10 +64,19 @@ BOOST_AUTO_TEST_CASE( SubGridBuilder ) {
     int newId = std::distance( subGrid.face_local_to_global.begin(), std::find( subGrid.face_local_to_global.begin(), subGrid.face_local_to_global.end(), 3 ) );
     BOOST_REQUIRE_EQUAL( localGrid->face_cells[2*newId], equelle::Boundary::inner );
 
+    // The faces next to the ghost cell are last: face 3 west of it, and face 4 between it and cell 4.
+    // The ghost cell's south and north faces, 10 and 16, also belong to it.
+    BOOST_CHECK_EQUAL( subGrid.number_of_ghost_faces, 4 );
+    for( int lface = 0; lface < localGrid->number_of_faces; ++lface ) {
+        const bool ghostFace = localGrid->face_cells[2*lface] == equelle::Boundary::inner
+                            || localGrid->face_cells[2*lface] == 2 || localGrid->face_cells[2*lface + 1] == 2;
+        BOOST_CHECK_EQUAL( ghostFace, lface >= localGrid->number_of_faces - subGrid.number_of_ghost_faces );
+    }
+
     // Check that we have the right face areas for each face in the subgrid
     for( int i = 0; i <  equelle::GridQuerying::numFaces( globalGrid, 4); ++i ) {
         const int glob_startIndex = globalGrid->cell_facepos[4];
-        const int loc_startIndex  = localGrid->cell_facepos[0];
+        const int loc_startIndex  = localGrid->cell_facepos[1];
 
         const int glob_face = globalGrid->cell_faces[glob_startIndex + i];
         const int loc_face  = localGrid->cell_faces[loc_startIndex   + i];
@@ -125,3 +135,69 @@ BOOST_AUTO_TEST_CASE( GridQueryingFunctions ) {
     auto grid = runtime.globalGrid->c_grid();
     BOOST_CHECK_EQUAL( equelle::GridQuerying::numFaces( grid, 0), 4 );
 }
+
+BOOST_AUTO_TEST_CASE( scatter ) {
+    Opm::GridManager gm( 6, 5 );
+    const UnstructuredGrid* grid = gm.c_grid();
+    const int rank = equelle::getMPIRank();
+
+    std::vector<int> cellOwners( grid->number_of_cells );
+    for( int cell = 0; cell < grid->number_of_cells; ++cell ) {
+        cellOwners[cell] = ( cell / 4 ) % equelle::getMPISize();
+    }
+
+    // Only the root passes the grid, the other nodes must get the same subgrid as they would build themselves.
+    equelle::SubGrid scattered = equelle::SubGridBuilder::scatter( rank == 0 ? grid : nullptr,
+                                                                   rank == 0 ? cellOwners : std::vector<int>() );
+    std::vector<int> ownCells;
+    for( int cell = 0; cell < grid->number_of_cells; ++cell ) {
+        if ( cellOwners[cell] == rank ) {
+            ownCells.push_back( cell );
+        }
+    }
+    equelle::SubGrid built = equelle::SubGridBuilder::build( grid, ownCells );
+
+    BOOST_CHECK( scattered.cell_local_to_global == built.cell_local_to_global );
+    BOOST_CHECK( scattered.face_local_to_global == built.face_local_to_global );
+    BOOST_CHECK( scattered.cell_global_to_local == built.cell_global_to_local );
+    BOOST_CHECK_EQUAL( scattered.number_of_ghost_cells, built.number_of_ghost_cells );
+    BOOST_CHECK_EQUAL( scattered.number_of_interior_cells, built.number_of_interior_cells );
+    BOOST_CHECK_EQUAL( scattered.number_of_ghost_faces, built.number_of_ghost_faces );
+
+    const UnstructuredGrid* s = scattered.c_grid;
+    const UnstructuredGrid* b = built.c_grid;
+    BOOST_REQUIRE_EQUAL( s->number_of_faces, b->number_of_faces );
+    BOOST_REQUIRE_EQUAL( s->number_of_nodes, b->number_of_nodes );
+    const int nc = s->number_of_cells, nf = s->number_of_faces, dim = s->dimensions;
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_cells, s->face_cells + 2*nf, b->face_cells, b->face_cells + 2*nf );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->cell_faces, s->cell_faces + s->cell_facepos[nc], b->cell_faces, b->cell_faces + b->cell_facepos[nc] );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_nodes, s->face_nodes + s->face_nodepos[nf], b->face_nodes, b->face_nodes + b->face_nodepos[nf] );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->node_coordinates, s->node_coordinates + dim*s->number_of_nodes,
+                                   b->node_coordinates, b->node_coordinates + dim*b->number_of_nodes );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_normals, s->face_normals + dim*nf, b->face_normals, b->face_normals + dim*nf );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->cell_volumes, s->cell_volumes + nc, b->cell_volumes, b->cell_volumes + nc );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->cell_facepos, s->cell_facepos + nc + 1, b->cell_facepos, b->cell_facepos + nc + 1 );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_nodepos, s->face_nodepos + nf + 1, b->face_nodepos, b->face_nodepos + nf + 1 );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_centroids, s->face_centroids + dim*nf, b->face_centroids, b->face_centroids + dim*nf );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->face_areas, s->face_areas + nf, b->face_areas, b->face_areas + nf );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->cell_centroids, s->cell_centroids + dim*nc, b->cell_centroids, b->cell_centroids + dim*nc );
+
+    // The logical Cartesian structure must survive both.
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->cartdims, s->cartdims + 3, b->cartdims, b->cartdims + 3 );
+    BOOST_CHECK_EQUAL_COLLECTIONS( b->cartdims, b->cartdims + 3, grid->cartdims, grid->cartdims + 3 );
+    BOOST_CHECK_EQUAL_COLLECTIONS( s->global_cell, s->global_cell + nc, b->global_cell, b->global_cell + nc );
+    BOOST_REQUIRE_EQUAL( s->cell_facetag == nullptr, grid->cell_facetag == nullptr );
+    BOOST_REQUIRE_EQUAL( b->cell_facetag == nullptr, grid->cell_facetag == nullptr );
+    if ( grid->cell_facetag ) {
+        BOOST_CHECK_EQUAL_COLLECTIONS( s->cell_facetag, s->cell_facetag + s->cell_facepos[nc],
+                                       b->cell_facetag, b->cell_facetag + b->cell_facepos[nc] );
+    }
+    for( int lcell = 0; lcell < nc; ++lcell ) {
+        const int gcell = built.cell_local_to_global[lcell];
+        BOOST_CHECK_EQUAL( b->global_cell[lcell], grid->global_cell ? grid->global_cell[gcell] : gcell );
+        if ( grid->cell_facetag ) {
+            BOOST_CHECK_EQUAL_COLLECTIONS( b->cell_facetag + b->cell_facepos[lcell], b->cell_facetag + b->cell_facepos[lcell + 1],
+                                           grid->cell_facetag + grid->cell_facepos[gcell], grid->cell_facetag + grid->cell_facepos[gcell + 1] );
+        }
+    }
+}
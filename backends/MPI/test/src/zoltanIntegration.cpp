@@ -20,6 +20,7 @@
 #include "equelle/mpiutils.hpp"
 #include "equelle/RuntimeMPI.hpp"
 #include "equelle/ZoltanGrid.hpp"
+#include "equelle/PartitionFile.hpp"
 
 
 using equelle::MPIInitializer;
@@ -155,3 +156,94 @@ BOOST_AUTO_TEST_CASE( decompose ) {
 
 
 
+
+BOOST_AUTO_TEST_CASE( decompose_partitionOptions ) {
+    const char* options[][3] = { { "rcb", "faces", "none" },
+                                 { "rib", "none", "none" },
+                                 { "graph", "faces", "transmissibility" },
+                                 { "hypergraph", "none", "face_areas" } };
+
+    for( const auto& option : options ) {
+        Opm::parameter::ParameterGroup param;
+        param.disableOutput();
+        param.insertParameter( "nx", "6" );
+        param.insertParameter( "ny", "5" );
+        param.insertParameter( "partition_method", option[0] );
+        param.insertParameter( "partition_cell_weights", option[1] );
+        param.insertParameter( "partition_edge_weights", option[2] );
+
+        equelle::RuntimeMPI runtime( param );
+        runtime.decompose();
+
+        int numOwnedCells = runtime.subGrid.cell_local_to_global.size() - runtime.subGrid.number_of_ghost_cells;
+        int totalCells = 0;
+        MPI_Allreduce( &numOwnedCells, &totalCells, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD );
+        BOOST_CHECK_MESSAGE( totalCells == 6*5, "partition_method " << option[0] << " gave " << totalCells << " cells." );
+    }
+
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+    param.insertParameter( "partition_method", "metis" );
+    BOOST_CHECK_THROW( equelle::RuntimeMPI runtime( param ), std::runtime_error );
+
+    // Weights from a file without a file name, or with too few weights, must fail on all nodes.
+    if ( equelle::getMPIRank() == 0 ) {
+        std::ofstream f( "6x5-weights.mockdata" );
+        f << "1 2 3";
+    }
+    MPI_Barrier( MPI_COMM_WORLD );
+    for( const bool with_filename : { false, true } ) {
+        Opm::parameter::ParameterGroup param;
+        param.disableOutput();
+        param.insertParameter( "nx", "6" );
+        param.insertParameter( "ny", "5" );
+        param.insertParameter( "partition_cell_weights", "file" );
+        if ( with_filename ) {
+            param.insertParameter( "partition_cell_weights_filename", "6x5-weights.mockdata" );
+        }
+        equelle::RuntimeMPI runtime( param );
+        BOOST_CHECK_THROW( runtime.decompose(), std::exception );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( decompose_partitionFile ) {
+    const int size = equelle::getMPISize();
+    const int rank = equelle::getMPIRank();
+    std::vector<int> cellOwners( 6*5 );
+    for( int c = 0; c < 6*5; ++c ) {
+        cellOwners[c] = c % size;
+    }
+    if ( rank == 0 ) {
+        equelle::PartitionFile::write( "6x5.part", cellOwners, size );
+        equelle::PartitionFile::write( "6x5-wrongsize.part", cellOwners, size + 1 );
+    }
+
+    for( const char* scatter : { "false", "true" } ) {
+        Opm::parameter::ParameterGroup param;
+        param.disableOutput();
+        param.insertParameter( "nx", "6" );
+        param.insertParameter( "ny", "5" );
+        param.insertParameter( "scatter_grid", scatter );
+        param.insertParameter( "partition_filename", "6x5.part" );
+
+        equelle::RuntimeMPI runtime( param );
+        runtime.decompose();
+
+        const int numOwnedCells = runtime.subGrid.cell_local_to_global.size() - runtime.subGrid.number_of_ghost_cells;
+        std::vector<int> expected;
+        for( int c = rank; c < 6*5; c += size ) {
+            expected.push_back( c );
+        }
+        std::vector<int> owned( runtime.subGrid.cell_local_to_global.begin(), runtime.subGrid.cell_local_to_global.begin() + numOwnedCells );
+        std::sort( owned.begin(), owned.end() );
+        BOOST_CHECK_EQUAL_COLLECTIONS( owned.begin(), owned.end(), expected.begin(), expected.end() );
+    }
+
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+    param.insertParameter( "nx", "6" );
+    param.insertParameter( "ny", "5" );
+    param.insertParameter( "partition_filename", "6x5-wrongsize.part" );
+    equelle::RuntimeMPI runtime( param );
+    BOOST_CHECK_THROW( runtime.decompose(), std::runtime_error );
+}
@@ -5,7 +5,9 @@
 #include <tuple>
 #include <unordered_map>
 #include <map>
-#include <functional>
+#include <algorithm>
+#include <future>
+#include <string>
 
 #include "equelle/equelleTypes.hpp"
 
@@ -19,33 +21,129 @@ enum Dimension {
     z = 2
 };
 
+class CartesianGrid;
 class StencilCollOfScalar;
+class FaceStencilCollOfScalar;
+class MultiStencilCollOfScalar;
+
+/**
+ * @brief The ComponentLayout enum selects how the components of a MultiStencilCollOfScalar are stored.
+ */
+enum class ComponentLayout {
+    SoA,  //!< One contiguous array per component.
+    AoSoA //!< Blocks of consecutive cells, with the components of each block stored after each other.
+};
+
+/**
+ * @brief The BoundaryCondition enum lists the ways the ghost cells of a cartesian collection can be filled.
+ */
+enum class BoundaryCondition {
+    Periodic,          //!< Copy from the opposite side of the domain.
+    Reflective,        //!< Mirror the interior cells across the boundary.
+    NegatedReflective, //!< Mirror and negate, e.g. for the normal momentum component at a wall.
+    Dirichlet,         //!< Mirror so that the value on the boundary face equals the given value.
+    Extrapolate        //!< Copy the outermost interior cell (zero gradient).
+};
 
 class CartesianEquelleRuntime {
 public:
     /**
      * @brief CartesianGrid constructor for a parameter object.
      * @param param Is a parameter object where the following keys are used for grid initialization.
-     *              - grid_dim Dimension of grid. (default 2)
-     *              - nx Number of interior cells in x-direction. (default 3)
-     *              - ny Number of interior cells in y-direction. (default 2)
+     *              - grid_dim Dimension of grid, 2 or 3. (default 2)
+     *              - nx Number of interior cells in x-direction.
+     *              - ny Number of interior cells in y-direction.
+     *              - nz Number of interior cells in z-direction. Only used if grid_dim is 3.
      *              - ghost_width width of ghost boundary. (default 1)
+     *              - output_to_file Write each output to its own file, tag-00000.output or tag-00000.bin. (default false)
+     *              - output_format text or binary. Binary files hold raw doubles in native byte order,
+     *                with i running fastest, then j and k. Implies output_to_file. (default text)
+     *              - output_ghost_cells Include the ghost cells in the output. (default true)
+     *              - output_async Write files in the background while the simulation continues. (default false)
      *              In addition how to read initial and boundary conditions can be specified.
+     *              A cell collection name is read from name_filename if name_from_file is true, as text,
+     *              or as raw doubles if name_binary is true. With name_ghost_cells the file includes the
+     *              ghost cells. (both default false)
      */
 	CartesianEquelleRuntime( const Opm::parameter::ParameterGroup& param );
+	~CartesianEquelleRuntime();
 
 	StencilCollOfScalar inputCellCollectionOfScalar( std::string name );
-	//CartesianCollOfFace inputFaceCollectionOfScalar( std::string name );
+
+	/**
+	 * @brief inputFaceCollectionOfScalar Reads a face collection, from the file given by name_filename if
+	 *        name_from_file is true, otherwise the constant name.
+	 *
+	 * The file holds the x-faces, then the y-faces (and z-faces). For each direction, the index
+	 * normal to the faces runs fastest, followed by the remaining indices in the order i, j, k.
+	 */
+	FaceStencilCollOfScalar inputFaceCollectionOfScalar( std::string name );
 
 	StencilCollOfScalar inputCellScalarWithDefault( std::string name, double d );
-	//CartesianCollOfFace inputFaceScalarWithDefault( std::string name, double d );
+	FaceStencilCollOfScalar inputFaceScalarWithDefault( std::string name, double d );
 
 	StencilCollOfScalar inputStencilCollectionOfScalar( std::string name, CollOfCell c);
+	FaceStencilCollOfScalar inputStencilCollectionOfScalar( std::string name, CollOfFace f);
+
+	/**
+	 * @brief inputCellMultiCollectionOfScalar Reads one component per name, like inputCellCollectionOfScalar.
+	 */
+	MultiStencilCollOfScalar inputCellMultiCollectionOfScalar( const std::vector<std::string>& names,
+	                                                           ComponentLayout layout = ComponentLayout::SoA );
 
     void output(std::string var_name_, const StencilCollOfScalar& var_);
+    void output(std::string var_name_, const MultiStencilCollOfScalar& var_);
+    void output(std::string var_name_, const FaceStencilCollOfScalar& var_);
+
+    /**
+     * @brief ensureGhostWidthMin Sets the ghost width to the stencil width required by the program.
+     *
+     * Collections created after this call use exactly the required width, unless the
+     * ghost_width parameter asks for more. A ghost_width parameter smaller than the
+     * required width is an error, since the stencils would then read out of bounds.
+     */
+    void ensureGhostWidthMin( int width );
+
+    /**
+     * @brief applyCartesianBoundaryConditions Fills the ghost cells of coll.
+     * @param conditions Either a single condition used for all sides, or one condition per side in the
+     *                   order "negX posX negY posY [negZ posZ]", separated by spaces. Each condition is
+     *                   one of periodic, reflective, negated_reflective, extrapolate or dirichlet=<value>.
+     */
+    void applyCartesianBoundaryConditions( StencilCollOfScalar& coll, const std::string& conditions );
+
+    /**
+     * @brief executeTimeLoop Runs an explicit time loop whose body is one stencil update of u from u0, followed by u0 = u.
+     *
+     * The stencil is called as stencil(step, u, u0, i, j[, k]) for all cells. The steps are temporally
+     * blocked when the parameter temporal_block_depth is larger than 1 (default 1), using bands of
+     * temporal_block_rows rows, or layers in 3D (default 16). See CartesianGrid::CellRange::executeTimeSteps.
+     */
+    template <class TimeStencil>
+    void executeTimeLoop( int steps, StencilCollOfScalar& u, StencilCollOfScalar& u0, const TimeStencil& stencil ) const;
 
 private:
+    /// Returns the grid given by the parameters.
+    CartesianGrid createGrid() const;
+
+    /// Returns a collection on the grid given by the parameters, with the interior cells set to value.
+    StencilCollOfScalar createCollection( double value ) const;
+
+    /// Writes the packed values of an output to the next file for tag, in the background if output_async is set.
+    void writeOutputFile( const std::string& tag, std::vector<double>&& values );
+
     const Opm::parameter::ParameterGroup param_;
+    int grid_dim_;
+    std::tuple<int, int, int> dims_; //!< Number of interior cells. The z-dimension is 1 for 2D grids.
+    int ghost_width_;
+    int temporal_block_depth_;
+    int temporal_block_rows_;
+    bool output_to_file_;
+    bool output_binary_;
+    bool output_ghost_cells_;
+    bool output_async_;
+    std::map<std::string, int> outputcount_;
+    std::future<void> pending_output_; //!< The file being written in the background, if any.
 };
 
 /**
@@ -66,7 +164,7 @@ public:
         negX, posX, negY, posY, negZ, posZ
     };
 
-    typedef std::array<int, 2> strideArray;
+    typedef std::array<int, 3> strideArray;
 
     CartesianGrid();
     ~CartesianGrid();
@@ -78,17 +176,26 @@ public:
      */
     explicit CartesianGrid(std::tuple<int, int> dims, int ghostWidth );
 
+    /**
+     * @brief CartesianGrid constructor for 3D-grids.
+     * @param dims number of cells in x, y and z dimension.
+     * @param ghostWidth width of ghost boundary. Assumed to be uniform in all directions.
+     */
+    explicit CartesianGrid(std::tuple<int, int, int> dims, int ghostWidth );
+
 
-    std::array<int, 2> cartdims{{-1,-1}}; //!< Number of interior cells in each dimension.
+    std::array<int, 3> cartdims{{-1,-1,-1}}; //!< Number of interior cells in each dimension. The z-dimension is 1 for 2D grids.
     strideArray cellStrides;
 
-    std::array<strideArray, 2>       faceStrides;
-    std::array<int, 2 >              number_of_faces_with_ghost_cells;
+    std::array<strideArray, 3>       faceStrides;
+    std::array<int, 3 >              number_of_faces_with_ghost_cells;
 
     int dimensions;            //!< Number of spatial dimensions.
     int number_of_cells;       //!< Number of interior cells in the grid.
     int ghost_width;           //!< Width of ghost cell boundary. Assumed to be the same for all directions and on every side of the domain.
     int number_of_cells_and_ghost_cells; //!< Total number of cells and ghost cells in grid.
+    int number_of_faces_and_ghost_faces; //!< Total number of faces in a face collection, including those of the ghost cells.
+    std::array<int, 3> faceBlockOffsets; //!< Position of the first x-, y- and z-face in the data of a face collection.
 
 
     /**
@@ -98,29 +205,93 @@ public:
      * @param coll  A scalar collection representing face values in the grid.
      * @return The value of the collection at the given edge.
      */
-    double& cellAt( StencilCollOfScalar& coll, int i, int j ) const;
-    const double& cellAt( const StencilCollOfScalar& coll, int i, int j ) const;
+    /**
+     * @brief cellIndex Return the position of cell(i,j,k) in the data of a collection on this grid.
+     */
+    int cellIndex( int i, int j, int k = 0 ) const
+    {
+        return cellOrigin + k*cellStrides[2] + j*cellStrides[1] + i*cellStrides[0];
+    }
+
+    inline double& cellAt( StencilCollOfScalar& coll, int i, int j ) const;
+    inline const double& cellAt( const StencilCollOfScalar& coll, int i, int j ) const;
+
+    /**
+     * @brief cellAt Return a reference to an element of cell(i,j,k) in a 3D grid.
+     */
+    inline double& cellAt( StencilCollOfScalar& coll, int i, int j, int k ) const;
+    inline const double& cellAt( const StencilCollOfScalar& coll, int i, int j, int k ) const;
+
+    /**
+     * @brief faceIndex Return the position of a face of cell(i,j,k) in the data of a face collection on this grid.
+     *
+     * The negX face of cell i is the posX face of cell i-1, and similarly in the other directions.
+     */
+    int faceIndex( int i, int j, int k, Face face ) const
+    {
+        const int d = static_cast<int>( face ) / 2;
+        const int pos = static_cast<int>( face ) % 2;
+        return faceBlockOffsets[d]
+            + ( i + ghost_width + ( d == 0 ? pos : 0 ) ) * faceStrides[d][0]
+            + ( j + ghost_width + ( d == 1 ? pos : 0 ) ) * faceStrides[d][1]
+            + ( k + ghost_width + ( d == 2 ? pos : 0 ) ) * faceStrides[d][2];
+    }
 
     /**
      * @brief faceAt Return a reference to an element of a face adjacent to cell (i,j).
      *
      * The method is intended both for reading from and writing to a variable.
+     * @param coll A scalar collection representing face values in the grid.
      * @param i Index i of cell
      * @param j Index j of cell
      * @param face Id of which adjacent face one is referring to.
-     * @param coll A scalar collection representing face values in the grid.
      * @return The value of the collection at the given face.
-     * /
-    double& faceAt( int i, int j, Face face, CartesianCollOfFace& coll ) const;
-    const double& faceAt( int i, int j, Face face, const CartesianCollOfFace& coll ) const;
-    */
+     */
+    inline double& faceAt( FaceStencilCollOfScalar& coll, int i, int j, Face face ) const;
+    inline const double& faceAt( const FaceStencilCollOfScalar& coll, int i, int j, Face face ) const;
+
+    /**
+     * @brief faceAt Return a reference to an element of a face adjacent to cell (i,j,k) in a 3D grid.
+     */
+    inline double& faceAt( FaceStencilCollOfScalar& coll, int i, int j, int k, Face face ) const;
+    inline const double& faceAt( const FaceStencilCollOfScalar& coll, int i, int j, int k, Face face ) const;
 
     /**
      * @brief dumpGrid a grid to a stream or file.
      * @param grid
      * @param stream
+     * @param with_ghost_cells Write the whole padded array instead of the interior cells only.
+     */
+    void dumpGridCells( const StencilCollOfScalar& grid, std::ostream& stream, bool with_ghost_cells = true ) const;
+
+    /**
+     * @brief dumpGridFaces Writes the faces of one direction, including ghost faces, with one row per line.
+     * @param face Either face of the direction to write, e.g. negX or posX for the x-faces.
+     */
+    void dumpGridFaces( const FaceStencilCollOfScalar& faces, Face face, std::ostream& stream ) const;
+
+    /**
+     * @brief packCells Copies the cells of coll to buffer, with i running fastest, then j and k.
+     * @param with_ghost_cells Copy the whole padded array instead of the interior cells only.
      */
-    void dumpGridCells( const StencilCollOfScalar& grid, std::ostream& stream ) const;
+    void packCells( const StencilCollOfScalar& coll, bool with_ghost_cells, std::vector<double>& buffer ) const;
+
+    /**
+     * @brief unpackCells Sets the cells of coll from buffer, in the order written by packCells.
+     */
+    void unpackCells( const std::vector<double>& buffer, bool with_ghost_cells, StencilCollOfScalar& coll ) const;
+
+    /**
+     * @brief applyBoundaryCondition Fills the ghost cells of coll on one side of the domain.
+     *
+     * Ghost cells along x are filled for interior rows only, ghost cells along y include the
+     * x-ghost columns, and ghost cells along z include both. Corners are therefore correct
+     * when the sides are filled in x, y, z order.
+     * @param side Which side of the domain to fill.
+     * @param bc How to fill it.
+     * @param value Boundary value, only used by BoundaryCondition::Dirichlet.
+     */
+    void applyBoundaryCondition( StencilCollOfScalar& coll, Face side, BoundaryCondition bc, double value = 0.0 ) const;
     //void dumpGridFaces( /*const*/ CartesianCollectionOfScalar& grid, Face, std::ostream& stream );
 
     /**
@@ -129,9 +300,11 @@ public:
     CellRange allCells();
     FaceRange allXFaces();
     FaceRange allYFaces();
+    FaceRange allZFaces();
 
 private:
     void init2D( std::tuple<int, int> dims, int ghostWidth );
+    void init3D( std::tuple<int, int, int> dims, int ghostWidth );
     int cellOrigin;
 };
 
@@ -139,33 +312,138 @@ private:
 
 
 
+namespace detail {
+
+    /// Calls stencil(i, j, k) if the stencil takes three indices.
+    template <class Stencil>
+    auto invokeStencil(const Stencil& stencil, const int i, const int j, const int k, int)
+        -> decltype(stencil(i, j, k), void())
+    {
+        stencil(i, j, k);
+    }
+
+    /// Calls stencil(i, j) for two-dimensional stencils.
+    template <class Stencil>
+    void invokeStencil(const Stencil& stencil, const int i, const int j, const int /*k*/, long)
+    {
+        stencil(i, j);
+    }
+
+    /// Calls stencil(step, dst, src, i, j, k) if the stencil takes three indices.
+    template <class TimeStencil>
+    auto invokeTimeStencil(const TimeStencil& stencil, const int step, StencilCollOfScalar& dst, const StencilCollOfScalar& src,
+                           const int i, const int j, const int k, int)
+        -> decltype(stencil(step, dst, src, i, j, k), void())
+    {
+        stencil(step, dst, src, i, j, k);
+    }
+
+    /// Calls stencil(step, dst, src, i, j) for two-dimensional stencils.
+    template <class TimeStencil>
+    void invokeTimeStencil(const TimeStencil& stencil, const int step, StencilCollOfScalar& dst, const StencilCollOfScalar& src,
+                           const int i, const int j, const int /*k*/, long)
+    {
+        stencil(step, dst, src, i, j);
+    }
+
+    /**
+     * @brief executeRange Calls stencil(i, j[, k]) for every i in [i_begin, i_end), j in [j_begin, j_end)
+     *        and k in [k_begin, k_end).
+     *
+     * The stencil is a template parameter so that the generated lambda is inlined into the loop.
+     * Rows (or tiles of rows) are distributed over OpenMP threads, and the loop over i is vectorized
+     * when possible. The stencil must not write to values read by other cells within the same range.
+     * Two-dimensional stencils are called with (i, j) only, and should be given k_begin = 0, k_end = 1.
+     *
+     * @param tile_i Number of cells in the i-direction per tile, or 0 for no tiling.
+     * @param tile_j Number of rows per tile, or 0 for one row per tile.
+     */
+    template <class Stencil>
+    void executeRange(const int i_begin, const int i_end, const int j_begin, const int j_end,
+                      const int k_begin, const int k_end,
+                      const int tile_i, const int tile_j, const Stencil& stencil)
+    {
+        const int ti = tile_i > 0 ? tile_i : std::max(i_end - i_begin, 1);
+        const int tj = tile_j > 0 ? tile_j : 1;
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2) schedule(static)
+#endif
+        for (int k = k_begin; k < k_end; ++k) {
+            for (int jj = j_begin; jj < j_end; jj += tj) {
+                const int j_stop = std::min(jj + tj, j_end);
+                for (int ii = i_begin; ii < i_end; ii += ti) {
+                    const int i_stop = std::min(ii + ti, i_end);
+                    for (int j = jj; j < j_stop; ++j) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+                        for (int i = ii; i < i_stop; ++i) {
+                            invokeStencil(stencil, i, j, k, 0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+} // namespace detail
+
+
 /**
  * Class that enables execution of a stencil on all cells within the range
  */
 class CartesianGrid::CellRange {
 public:
-    CellRange(int i0, int i1, int j0, int j1)
-        : i_begin(i0), i_end(i1), j_begin(j0), j_end(j1)
+    CellRange(int i0, int i1, int j0, int j1, int k0 = 0, int k1 = 1)
+        : i_begin(i0), i_end(i1), j_begin(j0), j_end(j1), k_begin(k0), k_end(k1), tile_i(0), tile_j(0)
     {
 
     }
 
-    void execute(std::function<void(int, int)> stencil)
+    /**
+     * @brief tiled Returns a copy of this range that is traversed in tiles of the given size.
+     */
+    CellRange tiled(int tileI, int tileJ) const
     {
-//#pragma omp parallel for here for parallelism
-        for (int j=j_begin; j < j_end; ++j) {
-            for (int i=i_begin; i < i_end; ++i) {
-                stencil(i, j);
-            }
-        }
+        CellRange r(*this);
+        r.tile_i = tileI;
+        r.tile_j = tileJ;
+        return r;
     }
 
+    template <class Stencil>
+    void execute(const Stencil& stencil) const
+    {
+        detail::executeRange(i_begin, i_end, j_begin, j_end, k_begin, k_end, tile_i, tile_j, stencil);
+    }
+
+    /**
+     * @brief executeTimeSteps Runs steps explicit time steps of a stencil over this range, alternating between u and u0.
+     *
+     * Gives the same result as calling execute() with stencil(step, u, u0, i, j[, k]) followed by
+     * u0.swapAssign(u) for every step. With depth > 1 the steps after the first are temporally blocked:
+     * bands of band_size rows (layers in 3D) are advanced depth steps at a time while still in cache,
+     * each step lagging width rows behind the previous one so that every cell it reads is up to date.
+     *
+     * @param width Must be at least the stencil width.
+     * @param depth Number of time steps per band. 1 gives ordinary sweeps over the whole range.
+     */
+    template <class TimeStencil>
+    void executeTimeSteps(int steps, int depth, int width, int band_size,
+                          StencilCollOfScalar& u, StencilCollOfScalar& u0, const TimeStencil& stencil) const;
+
 private:
     int i_begin;
     int i_end;
 
     int j_begin;
     int j_end;
+
+    int k_begin;
+    int k_end;
+
+    int tile_i;
+    int tile_j;
 };
 
 /**
@@ -173,20 +451,41 @@ private:
  */
 class CartesianGrid::FaceRange {
 public:
-    FaceRange(int i0, int i1, int j0, int j1)
-        : i_begin(i0), i_end(i1), j_begin(j0), j_end(j1)
+    FaceRange(int i0, int i1, int j0, int j1, int k0 = 0, int k1 = 1)
+        : i_begin(i0), i_end(i1), j_begin(j0), j_end(j1), k_begin(k0), k_end(k1), tile_i(0), tile_j(0)
     {
 
     }
 
-    void execute(std::function<void(int, int)> stencil)
+    FaceRange tiled(int tileI, int tileJ) const
     {
-//#pragma omp parallel for here for parallelism
-        for (int j=j_begin; j < j_end; ++j) {
-            for (int i=i_begin; i < i_end; ++i) {
-                stencil(i, j);
-            }
-        }
+        FaceRange r(*this);
+        r.tile_i = tileI;
+        r.tile_j = tileJ;
+        return r;
+    }
+
+    /**
+     * @brief shifted Returns a copy of this range with all indices moved by (di, dj, dk).
+     *
+     * Used when the stencil writes to face i+0.5 instead of face i-0.5, i.e. with i running from -1.
+     */
+    FaceRange shifted(int di, int dj, int dk) const
+    {
+        FaceRange r(*this);
+        r.i_begin += di;
+        r.i_end += di;
+        r.j_begin += dj;
+        r.j_end += dj;
+        r.k_begin += dk;
+        r.k_end += dk;
+        return r;
+    }
+
+    template <class Stencil>
+    void execute(const Stencil& stencil) const
+    {
+        detail::executeRange(i_begin, i_end, j_begin, j_end, k_begin, k_end, tile_i, tile_j, stencil);
     }
 
 private:
@@ -195,6 +494,12 @@ private:
 
     int j_begin;
     int j_end;
+
+    int k_begin;
+    int k_end;
+
+    int tile_i;
+    int tile_j;
 };
 
 
@@ -215,6 +520,35 @@ public:
     		}
     	}
 	}
+	StencilCollOfScalar(std::tuple<int, int, int> dims, int ghostWidth, double default_value=0.0f)
+    	: grid(dims, ghostWidth)
+    {
+    	data.resize(grid.number_of_cells_and_ghost_cells, 0.0f);
+
+    	//Set internal domain if non-zero.
+    	if (default_value != 0.0f) {
+    		for (int k=0; k<std::get<2>(dims); ++k) {
+    			for (int j=0; j<std::get<1>(dims); ++j) {
+    				double* begin = &grid.cellAt(*this, 0, j, k);
+    				double* end = begin + std::get<0>(dims);
+    				std::fill(begin, end, default_value);
+    			}
+    		}
+    	}
+	}
+
+    /**
+     * @brief swapAssign Makes this collection equal to source by swapping their buffers.
+     *
+     * Only the ghost cells of source are restored afterwards, its interior cells are left
+     * with the old values of this collection. This is used by the generated code for
+     * ping-pong updates such as u0 = u, where u is overwritten before it is read again.
+     * Falls back to a plain copy if the collections are on different grids.
+     */
+    void swapAssign( StencilCollOfScalar& source );
+
+    /// Copies the ghost cells, but not the interior cells, of a collection on the same grid.
+    void copyGhostCellsFrom( const StencilCollOfScalar& other );
 
     std::vector<double> data;
     CartesianGrid grid;
@@ -223,4 +557,175 @@ private:
 };
 
 
+/**
+ * A scalar collection on the faces of a cartesian grid, used for staggered fields such as fluxes.
+ *
+ * The x-faces are stored first, then the y-faces (and z-faces). The faces of the ghost cells are
+ * included, so that face i along x runs from -ghost_width to nx + ghost_width.
+ */
+class FaceStencilCollOfScalar {
+public:
+    FaceStencilCollOfScalar() {}
+
+    /// Creates a collection on grid g, with the interior faces (including the boundary faces) set to default_value.
+    explicit FaceStencilCollOfScalar( const CartesianGrid& g, double default_value = 0.0 );
+
+    std::vector<double> data;
+    CartesianGrid grid;
+};
+
+
+/**
+ * @brief The MultiStencilCollOfScalar class holds several scalar fields on the same cartesian grid,
+ *        such as [h, hu, hv] for the shallow water equations.
+ *
+ * Sharing the grid means the index arithmetic of cellAt is done once per cell for all components.
+ * With the AoSoA layout, the components of block_size consecutive cells are stored next to each other,
+ * so that a stencil updating all components touches fewer memory pages than with the SoA layout.
+ */
+class MultiStencilCollOfScalar {
+public:
+    static const int block_size = 8; //!< Number of cells per block in the AoSoA layout.
+
+    MultiStencilCollOfScalar() : num_components(0), layout(ComponentLayout::SoA) {}
+    MultiStencilCollOfScalar( int numComponents, const CartesianGrid& g, ComponentLayout l = ComponentLayout::SoA );
+
+    double& cellAt( int c, int i, int j )
+    {
+        return data[ offset( c, grid.cellIndex( i, j ) ) ];
+    }
+    const double& cellAt( int c, int i, int j ) const
+    {
+        return data[ offset( c, grid.cellIndex( i, j ) ) ];
+    }
+    double& cellAt( int c, int i, int j, int k )
+    {
+        return data[ offset( c, grid.cellIndex( i, j, k ) ) ];
+    }
+    const double& cellAt( int c, int i, int j, int k ) const
+    {
+        return data[ offset( c, grid.cellIndex( i, j, k ) ) ];
+    }
+
+    /// Copy of component c, including ghost cells.
+    StencilCollOfScalar component( int c ) const;
+    /// Sets component c, including ghost cells, from a collection on the same grid.
+    void setComponent( int c, const StencilCollOfScalar& values );
+
+    std::vector<double> data;
+    CartesianGrid grid;
+    int num_components;
+    ComponentLayout layout;
+
+private:
+    int offset( int c, int cell ) const
+    {
+        if ( layout == ComponentLayout::SoA ) {
+            return c*grid.number_of_cells_and_ghost_cells + cell;
+        }
+        return (cell / block_size)*block_size*num_components + c*block_size + cell % block_size;
+    }
+};
+
+
+// cellAt is defined here, and not in the source file, so that it can be inlined into the stencils.
+inline double& CartesianGrid::cellAt( StencilCollOfScalar &coll,  const int i, const int j ) const
+{
+    return coll.data[ cellIndex( i, j ) ];
+}
+
+inline const double& CartesianGrid::cellAt( const StencilCollOfScalar &coll,  const int i, const int j ) const
+{
+    return coll.data[ cellIndex( i, j ) ];
+}
+
+inline double& CartesianGrid::cellAt( StencilCollOfScalar &coll,  const int i, const int j, const int k ) const
+{
+    return coll.data[ cellIndex( i, j, k ) ];
+}
+
+inline const double& CartesianGrid::cellAt( const StencilCollOfScalar &coll,  const int i, const int j, const int k ) const
+{
+    return coll.data[ cellIndex( i, j, k ) ];
+}
+
+inline double& CartesianGrid::faceAt( FaceStencilCollOfScalar &coll, const int i, const int j, const Face face ) const
+{
+    return coll.data[ faceIndex( i, j, 0, face ) ];
+}
+
+inline const double& CartesianGrid::faceAt( const FaceStencilCollOfScalar &coll, const int i, const int j, const Face face ) const
+{
+    return coll.data[ faceIndex( i, j, 0, face ) ];
+}
+
+inline double& CartesianGrid::faceAt( FaceStencilCollOfScalar &coll, const int i, const int j, const int k, const Face face ) const
+{
+    return coll.data[ faceIndex( i, j, k, face ) ];
+}
+
+inline const double& CartesianGrid::faceAt( const FaceStencilCollOfScalar &coll, const int i, const int j, const int k, const Face face ) const
+{
+    return coll.data[ faceIndex( i, j, k, face ) ];
+}
+
+
+template <class TimeStencil>
+void CartesianGrid::CellRange::executeTimeSteps(const int steps, const int depth, const int width, const int band_size,
+                                                StencilCollOfScalar& u, StencilCollOfScalar& u0,
+                                                const TimeStencil& stencil) const
+{
+    if (steps <= 0) {
+        return;
+    }
+    // The first step reads the ghost cells of u0, the later ones those of u. Doing the first
+    // step on its own lets both buffers share the ghost cells of u for the rest of the loop.
+    execute([&](const int i, const int j, const int k) {
+        detail::invokeTimeStencil(stencil, 0, u, u0, i, j, k, 0);
+    });
+    u0.copyGhostCellsFrom(u);
+
+    // Even steps write to u, odd steps to u0. Bands move along the outermost dimension.
+    const bool layered = k_end - k_begin > 1;
+    const int outer_begin = layered ? k_begin : j_begin;
+    const int outer_end = layered ? k_end : j_end;
+    for (int first = 1; first < steps; first += std::max(depth, 1)) {
+        const int chunk = std::min(std::max(depth, 1), steps - first);
+        const int band = chunk > 1 ? std::max(band_size, 1) : outer_end - outer_begin;
+        for (int band_start = outer_begin; band_start - (chunk - 1)*width < outer_end; band_start += band) {
+            for (int t = 0; t < chunk; ++t) {
+                const int lo = std::max(band_start - t*width, outer_begin);
+                const int hi = std::min(band_start + band - t*width, outer_end);
+                if (lo >= hi) {
+                    continue;
+                }
+                const int step = first + t;
+                StencilCollOfScalar& dst = step % 2 == 0 ? u : u0;
+                const StencilCollOfScalar& src = step % 2 == 0 ? u0 : u;
+                auto sweep = [&](const int i, const int j, const int k) {
+                    detail::invokeTimeStencil(stencil, step, dst, src, i, j, k, 0);
+                };
+                if (layered) {
+                    detail::executeRange(i_begin, i_end, j_begin, j_end, lo, hi, tile_i, tile_j, sweep);
+                } else {
+                    detail::executeRange(i_begin, i_end, lo, hi, k_begin, k_end, tile_i, tile_j, sweep);
+                }
+            }
+        }
+    }
+    // The newest values must end up in u0, as after u0 = u.
+    if ((steps - 1) % 2 == 0) {
+        u0.swapAssign(u);
+    }
+}
+
+template <class TimeStencil>
+void CartesianEquelleRuntime::executeTimeLoop( const int steps, StencilCollOfScalar& u, StencilCollOfScalar& u0,
+                                               const TimeStencil& stencil ) const
+{
+    u.grid.allCells().executeTimeSteps( steps, temporal_block_depth_, u.grid.ghost_width, temporal_block_rows_,
+                                        u, u0, stencil );
+}
+
+
 } // namespace equelle
@@ -14,6 +14,8 @@
 #include <map>
 
 #include "equelle/equelleTypes.hpp"
+#include "equelle/GridRenumbering.hpp"
+#include "equelle/StructuredGrid.hpp"
 
 namespace equelle {
 
@@ -102,6 +104,11 @@ public:
     ///@{
     void output(const String& tag, Scalar val) const;
     void output(const String& tag, const CollOfScalar& vals);
+    /// Output of a collection On domain. With grid_renumbering the values are
+    /// written in the order of the indices of domain in the input grid, which
+    /// is the order the input files for domain use.
+    void output(const String& tag, const CollOfScalar& vals, const CollOfCell& domain);
+    void output(const String& tag, const CollOfScalar& vals, const CollOfFace& domain);
     ///@}
 
     /// @name Input
@@ -125,6 +132,21 @@ public:
 private:
     /// Topology helpers
     bool boundaryCell(const int cell_index) const;
+    static bool interiorFace(const UnstructuredGrid& grid, const int face_index);
+    static int countInteriorFaces(const UnstructuredGrid& grid);
+
+    /// Discrete operators, built on first use.
+    const Opm::HelperOps& ops() const;
+
+    /// Structure-of-arrays copy of the grid geometry, built on first use.
+    /// The grid stores vectors interleaved and face normals scaled by
+    /// face areas, so we keep one array per dimension and unit normals.
+    struct GeometryCache {
+        std::vector<CollOfScalar::V> cell_centroids;
+        std::vector<CollOfScalar::V> face_centroids;
+        std::vector<CollOfScalar::V> face_unit_normals;
+    };
+    const GeometryCache& geometry() const;
 
     /// Creating primary variables.
     static CollOfScalar singlePrimaryVariable(const CollOfScalar& initial_values);
@@ -135,10 +157,24 @@ private:
     /// Norms.
     Scalar twoNorm(const CollOfScalar& vals) const;
 
+    /// Translation to the enumeration of the input grid, used for I/O when the grid is renumbered.
+    std::vector<int> originalIndices(const CollOfCell& cells) const;
+    std::vector<int> originalIndices(const CollOfFace& faces) const;
+    /// Positions of the elements of a collection, ordered by their original indices.
+    static std::vector<int> originalOrder(const std::vector<int>& original_indices);
+    /// Writes vals[order[0]], vals[order[1]], ... to a file or to stdout.
+    void writeOutput(const String& tag, const CollOfScalar& vals, const std::vector<int>& order);
+
     /// Data members.
     std::unique_ptr<Opm::GridManager> grid_manager_;
+    std::unique_ptr<RenumberedGrid> renumbering_;
     const UnstructuredGrid& grid_;
-    Opm::HelperOps ops_;
+    int num_interior_faces_;
+    /// Set when grid_ is a regular box, to use the stride-based kernels
+    /// instead of face_cells and the sparse operators.
+    std::unique_ptr<StructuredGrid> structured_;
+    mutable std::unique_ptr<Opm::HelperOps> ops_;
+    mutable std::unique_ptr<GeometryCache> geometry_;
     Opm::LinearSolverFactory linsolver_;
     bool output_to_file_;
     int verbose_;
@@ -152,6 +188,14 @@ private:
 
 Opm::GridManager* createGridManager(const Opm::parameter::ParameterGroup& param);
 
+/// Returns a renumbered copy of grid as selected by the grid_renumbering parameter
+/// (none, rcm or sfc), or a null pointer if no renumbering is requested.
+RenumberedGrid* createRenumberedGrid(const UnstructuredGrid& grid, const Opm::parameter::ParameterGroup& param);
+
+/// Returns the implicit description of grid if it is a regular box, unless the
+/// structured_fast_path parameter is false (default true), or else a null pointer.
+StructuredGrid* createStructuredGrid(const UnstructuredGrid& grid, const Opm::parameter::ParameterGroup& param);
+
 
 } // namespace equelle
 
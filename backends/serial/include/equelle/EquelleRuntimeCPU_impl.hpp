@@ -7,6 +7,8 @@
 #include <fstream>
 #include <iterator>
 #include <array>
+#include <algorithm>
+#include <numeric>
 #include <opm/core/utility/StopWatch.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
 
@@ -357,6 +359,16 @@ CollOfScalar EquelleRuntimeCPU::inputCollectionOfScalar(const String& name,
         if (int(data.size()) != size) {
             OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
         }
+        if (renumbering_) {
+            // The file is ordered by the original indices of the collection,
+            // so element i of coll is found at the rank of its original index.
+            const std::vector<int> file_order = originalOrder(originalIndices(coll));
+            CollOfScalar::V values(size);
+            for (int pos = 0; pos < size; ++pos) {
+                values[file_order[pos]] = data[pos];
+            }
+            return CollOfScalar(values);
+        }
         return CollOfScalar(CollOfScalar::V(Eigen::Map<CollOfScalar::V>(&data[0], size)));
     } else {
         // Uniform values.
@@ -0,0 +1,74 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct UnstructuredGrid;
+
+namespace equelle {
+
+/** RenumberedGrid is a copy of an Opm::UnstructuredGrid where cells and faces
+ *  have been permuted, together with the permutation tables needed to translate
+ *  between the renumbered and the original enumeration.
+ */
+struct RenumberedGrid {
+    UnstructuredGrid* c_grid; //! Pointer to the renumbered grid. Owned by this class.
+
+    std::vector<int> cell_new_to_old; //! Maps renumbered cell indices to original cell indices.
+    std::vector<int> cell_old_to_new; //! The inverse of cell_new_to_old.
+    std::vector<int> face_new_to_old; //! Maps renumbered face indices to original face indices.
+    std::vector<int> face_old_to_new; //! The inverse of face_new_to_old.
+
+    RenumberedGrid();
+    ~RenumberedGrid();
+
+private:
+    RenumberedGrid(const RenumberedGrid&);
+    RenumberedGrid& operator=(const RenumberedGrid&);
+};
+
+/** GridRenumbering reorders the cells and faces of an Opm::UnstructuredGrid
+ *  to improve memory locality of the sparse operators and gathers used by the runtime.
+ *
+ *  Cells are ordered first, either by reverse Cuthill-McKee on the cell adjacency
+ *  graph or along a space-filling (Morton) curve through the cell centroids.
+ *  Faces are then ordered by the new index of their neighbouring cells.
+ *  Nodes are left untouched.
+ */
+class GridRenumbering
+{
+public:
+    enum Method { None, ReverseCuthillMcKee, SpaceFillingCurve };
+
+    /**
+     * @brief methodFromString Parses the value of the grid_renumbering parameter.
+     * @param name One of "none", "rcm" or "sfc".
+     */
+    static Method methodFromString(const std::string& name);
+
+    /**
+     * @brief build a renumbered copy of grid.
+     * @param grid The grid to renumber. It is not modified.
+     * @param method Which cell ordering to use. Must not be None.
+     * @return A new RenumberedGrid, owned by the caller.
+     */
+    static RenumberedGrid* build(const UnstructuredGrid& grid, const Method method);
+
+    /** Return the original cell index of each new cell, using reverse Cuthill-McKee. */
+    static std::vector<int> cellOrderRCM(const UnstructuredGrid& grid);
+
+    /** Return the original cell index of each new cell, sorted along a Morton curve through the cell centroids. */
+    static std::vector<int> cellOrderSFC(const UnstructuredGrid& grid);
+
+    /** Return the original face index of each new face, given the new cell enumeration. */
+    static std::vector<int> faceOrder(const UnstructuredGrid& grid, const std::vector<int>& cell_old_to_new);
+
+private:
+    GridRenumbering();
+};
+
+} // namespace equelle
@@ -0,0 +1,97 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#pragma once
+
+#include <array>
+
+struct UnstructuredGrid;
+
+namespace equelle {
+
+/** StructuredGrid describes an Opm::UnstructuredGrid that is a regular box of
+ *  nx*ny(*nz) equal cells, enumerated the way Opm::GridManager creates them from
+ *  nx, ny (and nz): cells with i running fastest, then all x-faces, all y-faces
+ *  (and all z-faces), each block with i running fastest.
+ *
+ *  For such grids the topology and geometry follow from the cell indices, so the
+ *  runtime can use the stride-based kernels below instead of face_cells and the
+ *  sparse operators.
+ */
+class StructuredGrid
+{
+public:
+    /**
+     * @brief detect Checks whether grid is a regular box with the enumeration described above.
+     *
+     * Every cell and face is compared against the implicit topology and geometry, so
+     * grids read from file, or renumbered, are only accepted if they are really equal.
+     * @return A new StructuredGrid, owned by the caller, or a null pointer if grid is not such a box.
+     */
+    static StructuredGrid* detect(const UnstructuredGrid& grid);
+
+    int dimensions;                 //!< Number of spatial dimensions, 2 or 3.
+    std::array<int, 3> dims;        //!< Number of cells in each direction. The z-dimension is 1 for 2D grids.
+    std::array<double, 3> origin;   //!< Position of the lower corner of the grid.
+    std::array<double, 3> spacing;  //!< Size of the cells in each direction.
+    std::array<int, 4> face_start;  //!< Index of the first x-, y- and z-face, and the number of faces.
+    std::array<int, 4> interior_face_start; //!< Same as face_start, counting interior faces only.
+
+    int numCells() const { return dims[0]*dims[1]*dims[2]; }
+    int numFaces() const { return face_start[dimensions]; }
+    int numInteriorFaces() const { return interior_face_start[dimensions]; }
+
+    /// Stride between neighbouring cells in direction d.
+    int cellStride(const int d) const
+    {
+        return d == 0 ? 1 : (d == 1 ? dims[0] : dims[0]*dims[1]);
+    }
+
+    /// The cell on the negative side of face, or -1 on the boundary.
+    int firstCell(const int face) const;
+
+    /// The cell on the positive side of face, or -1 on the boundary.
+    int secondCell(const int face) const;
+
+    /// The direction normal to face.
+    int faceDirection(const int face) const;
+
+    /// Area of the faces normal to direction d (length in 2D).
+    double faceArea(const int d) const;
+
+    /// Volume of every cell (area in 2D).
+    double cellVolume() const;
+
+    /// Writes the centroid of cell to c[0..dimensions).
+    void cellCentroid(const int cell, double* c) const;
+
+    /// Writes the centroid of face to c[0..dimensions).
+    void faceCentroid(const int face, double* c) const;
+
+    /**
+     * @brief gradient Computes u(second cell) - u(first cell) for all interior faces, in the order of interiorFaces().
+     */
+    void gradient(const double* cell_values, double* interior_face_values) const;
+
+    /**
+     * @brief divergence Sums the fluxes out of every cell, taking the flux of all faces in face order.
+     */
+    void divergence(const double* face_values, double* cell_values) const;
+
+    /**
+     * @brief interiorDivergence Like divergence, but with fluxes for the interior faces only.
+     */
+    void interiorDivergence(const double* interior_face_values, double* cell_values) const;
+
+private:
+    StructuredGrid();
+
+    /// Number of faces normal to direction d in each direction.
+    std::array<int, 3> faceDims(const int d) const;
+
+    /// Splits a face index into its direction and the indices (i, j, k) of the cell on its positive side.
+    int faceIndices(const int face, int& i, int& j, int& k) const;
+};
+
+} // namespace equelle
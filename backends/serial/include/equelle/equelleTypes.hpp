@@ -2,7 +2,9 @@
 
 #include <opm/autodiff/AutoDiffBlock.hpp>
 
+#include <cassert>
 #include <vector>
+#include <cmath>
 #include <string>
 
 namespace equelle {
@@ -230,10 +232,109 @@ public:
     {
         return v.size();
     }
+    /// True if no component carries derivatives.
+    bool isConstant() const
+    {
+        for (const CollOfScalar& c : v) {
+            if (!c.derivative().empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
 private:
     std::vector<CollOfScalar> v;
 };
 
+
+/// Kernels for vector collections of compile-time dimension. Each one
+/// makes a single pass over the component values with the loop over
+/// dimensions unrolled, and sums the Jacobians of the components
+/// directly instead of creating a temporary AutoDiffBlock per component.
+namespace VectorKernels
+{
+    /// Adds diag(scale) * dx/dy to jac, which is sized on first use.
+    inline void addScaledJacobian(const CollOfScalar& x, const CollOfScalar::V& scale,
+                                  std::vector<CollOfScalar::M>& jac)
+    {
+        const auto& xjac = x.derivative();
+        if (xjac.empty()) {
+            return;
+        }
+        const int num_blocks = xjac.size();
+        if (jac.empty()) {
+            jac.resize(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jac[block].resize(xjac[block].rows(), xjac[block].cols());
+            }
+        }
+        typedef Eigen::DiagonalMatrix<Scalar, Eigen::Dynamic> D;
+        const D s = scale.matrix().asDiagonal();
+        for (int block = 0; block < num_blocks; ++block) {
+            jac[block] += s * xjac[block];
+        }
+    }
+
+    template <int Dim>
+    CollOfScalar dot(const CollOfVector& v1, const CollOfVector& v2)
+    {
+        assert(v1.numCols() == Dim && v2.numCols() == Dim);
+        const double* a[Dim];
+        const double* b[Dim];
+        for (int d = 0; d < Dim; ++d) {
+            a[d] = v1.col(d).value().data();
+            b[d] = v2.col(d).value().data();
+        }
+        const int n = v1.col(0).size();
+        CollOfScalar::V result(n);
+        for (int i = 0; i < n; ++i) {
+            double sum = a[0][i] * b[0][i];
+            for (int d = 1; d < Dim; ++d) {
+                sum += a[d][i] * b[d][i];
+            }
+            result[i] = sum;
+        }
+        if (v1.isConstant() && v2.isConstant()) {
+            return CollOfScalar(result);
+        }
+        // d(v1.v2)/dy = sum over d of v2_d * d(v1_d)/dy + v1_d * d(v2_d)/dy
+        std::vector<CollOfScalar::M> jac;
+        for (int d = 0; d < Dim; ++d) {
+            addScaledJacobian(v1.col(d), v2.col(d).value(), jac);
+            addScaledJacobian(v2.col(d), v1.col(d).value(), jac);
+        }
+        return CollOfScalar::ADB::function(result, jac);
+    }
+
+    template <int Dim>
+    CollOfScalar norm(const CollOfVector& v)
+    {
+        assert(v.numCols() == Dim);
+        const double* a[Dim];
+        for (int d = 0; d < Dim; ++d) {
+            a[d] = v.col(d).value().data();
+        }
+        const int n = v.col(0).size();
+        CollOfScalar::V result(n);
+        for (int i = 0; i < n; ++i) {
+            double sum = a[0][i] * a[0][i];
+            for (int d = 1; d < Dim; ++d) {
+                sum += a[d][i] * a[d][i];
+            }
+            result[i] = std::sqrt(sum);
+        }
+        if (v.isConstant()) {
+            return CollOfScalar(result);
+        }
+        // d|v|/dy = sum over d of v_d / |v| * d(v_d)/dy
+        std::vector<CollOfScalar::M> jac;
+        for (int d = 0; d < Dim; ++d) {
+            addScaledJacobian(v.col(d), v.col(d).value() / result, jac);
+        }
+        return CollOfScalar::ADB::function(result, jac);
+    }
+} // namespace VectorKernels
+
 inline CollOfVector operator+(const CollOfVector& v1, const CollOfVector& v2)
 {
     const int dim = v1.numCols();
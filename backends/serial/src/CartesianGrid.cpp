@@ -6,6 +6,9 @@
 #include <iomanip>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
 
 #include <opm/autodiff/AutoDiffHelpers.hpp>
 
@@ -21,40 +24,98 @@ equelle::CartesianGrid::CartesianGrid()
 equelle::CartesianEquelleRuntime::CartesianEquelleRuntime(const Opm::parameter::ParameterGroup &param)
     : param_( param )
 {
-    int grid_dim = param.getDefault( "grid_dim", 2 );
-    if ( grid_dim != 2 ) {
-        throw std::runtime_error( "Only 2D-cartesian grids are supported, so far..." );
+    grid_dim_ = param.getDefault( "grid_dim", 2 );
+    if ( grid_dim_ != 2 && grid_dim_ != 3 ) {
+        throw std::runtime_error( "Only 2D- and 3D-cartesian grids are supported." );
     }
+    param_.get( "nx", std::get<0>(dims_) );
+    param_.get( "ny", std::get<1>(dims_) );
+    std::get<2>(dims_) = 1;
+    if ( grid_dim_ == 3 ) {
+        param_.get( "nz", std::get<2>(dims_) );
+    }
+    ghost_width_ = param_.getDefault( "ghost_width", 1 );
+    temporal_block_depth_ = param_.getDefault( "temporal_block_depth", 1 );
+    temporal_block_rows_ = param_.getDefault( "temporal_block_rows", 16 );
+    const std::string format = param_.getDefault<std::string>( "output_format", "text" );
+    if ( format != "text" && format != "binary" ) {
+        OPM_THROW(std::runtime_error, "Unknown output_format " << format << " (expected text or binary).");
+    }
+    output_binary_ = format == "binary";
+    output_to_file_ = output_binary_ || param_.getDefault( "output_to_file", false );
+    output_ghost_cells_ = param_.getDefault( "output_ghost_cells", true );
+    output_async_ = param_.getDefault( "output_async", false );
 }
 
-equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputCellCollectionOfScalar(std::string name)
+equelle::CartesianEquelleRuntime::~CartesianEquelleRuntime()
 {
-    std::tuple<int, int> dims;
-    param_.get( "nx", std::get<0>(dims) );
-    param_.get( "ny", std::get<1>(dims) );
-    int ghostWidth = param_.getDefault( "ghost_width", 1 );
+    // An error from the last background write cannot be thrown from here, so it is reported instead.
+    if ( pending_output_.valid() ) {
+        try {
+            pending_output_.get();
+        } catch ( const std::exception& e ) {
+            std::cerr << "Writing output failed: " << e.what() << std::endl;
+        }
+    }
+}
 
-    StencilCollOfScalar v(dims, ghostWidth);
+equelle::CartesianGrid equelle::CartesianEquelleRuntime::createGrid() const
+{
+    if ( grid_dim_ == 3 ) {
+        return CartesianGrid( dims_, ghost_width_ );
+    }
+    return CartesianGrid( std::make_tuple( std::get<0>(dims_), std::get<1>(dims_) ), ghost_width_ );
+}
+
+equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::createCollection( double value ) const
+{
+    if ( grid_dim_ == 3 ) {
+        return StencilCollOfScalar( dims_, ghost_width_, value );
+    }
+    return StencilCollOfScalar( std::make_tuple( std::get<0>(dims_), std::get<1>(dims_) ), ghost_width_, value );
+}
+
+equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputCellCollectionOfScalar(std::string name)
+{
+    StencilCollOfScalar v = createCollection( 0.0 );
 
     const bool from_file = param_.getDefault(name + "_from_file", false);
     if ( from_file ) {
         const String filename = param_.get<String>(name + "_filename");
-        std::ifstream is(filename.c_str());
+        const bool binary = param_.getDefault(name + "_binary", false);
+        const bool with_ghost_cells = param_.getDefault(name + "_ghost_cells", false);
+        const size_t expected = with_ghost_cells ? v.grid.number_of_cells_and_ghost_cells : v.grid.number_of_cells;
+        std::ifstream is(filename.c_str(), binary ? std::ios::in | std::ios::binary : std::ios::in);
         if (!is) {
             OPM_THROW(std::runtime_error, "Could not find file " << filename);
         }
-        std::istream_iterator<double> beg(is);
-        std::istream_iterator<double> end;
 
-        for( int j = 0; j < std::get<1>(dims); ++j ) {
-            for( int i = 0; i < std::get<0>(dims); ++i ) {
-                if ( beg == end ) {
-                    OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
-                }
-                v.grid.cellAt( v, i, j ) = *beg;
-                beg++;
+        // The file is ordered with i running fastest, then j, then k.
+        std::vector<double> values;
+        if ( binary ) {
+            is.seekg( 0, std::ios::end );
+            const std::streamoff bytes = is.tellg();
+            is.seekg( 0, std::ios::beg );
+            if ( bytes != std::streamoff( expected*sizeof(double) ) ) {
+                OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename
+                          << ": expected " << expected << " doubles, got " << bytes << " bytes.");
+            }
+            values.resize( expected );
+            if ( !is.read( reinterpret_cast<char*>( values.data() ), bytes ) ) {
+                OPM_THROW(std::runtime_error, "Could not read " << filename);
+            }
+        } else {
+            values.reserve( expected );
+            std::istream_iterator<double> beg(is);
+            std::istream_iterator<double> end;
+            for ( size_t n = 0; n < expected && beg != end; ++n, ++beg ) {
+                values.push_back( *beg );
+            }
+            if ( values.size() != expected ) {
+                OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
             }
         }
+        v.grid.unpackCells( values, with_ghost_cells, v );
         return v;
     } else { // Constant value
         const double value = param_.get<double>( name );
@@ -63,13 +124,12 @@ equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputCellCollecti
 }
 
 
-/*
-equelle::CartesianGrid::CartesianCollectionOfScalar equelle::CartesianGrid::inputFaceCollectionOfScalar(std::string name)
+equelle::FaceStencilCollOfScalar equelle::CartesianEquelleRuntime::inputFaceCollectionOfScalar(std::string name)
 {
-    CartesianCollectionOfScalar v;
-
     const bool from_file = param_.getDefault(name + "_from_file", false);
     if ( from_file ) {
+        FaceStencilCollOfScalar v( createGrid() );
+        const CartesianGrid& g = v.grid;
         const String filename = param_.get<String>(name + "_filename");
         std::ifstream is(filename.c_str());
         if (!is) {
@@ -78,89 +138,174 @@ equelle::CartesianGrid::CartesianCollectionOfScalar equelle::CartesianGrid::inpu
         std::istream_iterator<double> beg(is);
         std::istream_iterator<double> end;
 
-        int num = number_of_faces_with_ghost_cells[Dimension::x] * (cartdims[1]+2*ghost_width) +
-                number_of_faces_with_ghost_cells[Dimension::y] * (cartdims[0]+2*ghost_width);
-
-        v.resize( num, 0.0 );
-
-        // X-faces
-        for( int j = 0; j < cartdims[1]; ++j ) {
-            for( int i = 0; i <= cartdims[0]; ++i ) {
-                if ( beg == end ) {
-                    OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
-                }
-                faceAt( i, j, Face::negX, v ) = *beg;
-                beg++;
+        // Face n along direction d is the negative face of the cell with index n along d.
+        const CartesianGrid::Face neg[3] = { CartesianGrid::Face::negX, CartesianGrid::Face::negY, CartesianGrid::Face::negZ };
+        for( int d = 0; d < g.dimensions; ++d ) {
+            // Index loops from fastest to slowest: the normal direction first, then the others in order.
+            int order[3] = { d, d == 0 ? 1 : 0, d == 2 ? 1 : 2 };
+            int count[3];
+            for( int n = 0; n < 3; ++n ) {
+                count[n] = g.cartdims[order[n]] + ( order[n] == d ? 1 : 0 );
             }
-        }
-
-        // Y-faces        
-        // NB. Here we have switch the order we traverse the dimensions, in order to allow for
-        // the natural indexing of storing y-data in input files.
-        for( int i = 0; i < cartdims[0]; ++i ) {
-            for( int j = 0; j <= cartdims[1]; ++j ) {
-                if ( beg == end ) {
-                    OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
+            int index[3];
+            for( int c = 0; c < count[2]; ++c ) {
+                for( int b = 0; b < count[1]; ++b ) {
+                    for( int a = 0; a < count[0]; ++a ) {
+                        if ( beg == end ) {
+                            OPM_THROW(std::runtime_error, "Unexpected size of input data for " << name << " in file " << filename);
+                        }
+                        index[order[0]] = a;
+                        index[order[1]] = b;
+                        index[order[2]] = c;
+                        g.faceAt( v, index[0], index[1], index[2], neg[d] ) = *beg;
+                        beg++;
+                    }
                 }
-                faceAt( i, j, Face::negY, v ) = *beg;
-                beg++;
             }
         }
+        return v;
     } else { // Constant value
         const double value = param_.get<double>( name );
-        v = inputFaceScalarWithDefault( name, value );
+        return inputFaceScalarWithDefault( name, value );
     }
-
-    return v;
 }
-*/
 
 equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputCellScalarWithDefault(std::string /*name*/, double d)
 {    
-    std::tuple<int, int> dims;
-    param_.get( "nx", std::get<0>(dims) );
-    param_.get( "ny", std::get<1>(dims) );
-    int ghostWidth = param_.getDefault( "ghost_width", 1 );
-
-    return StencilCollOfScalar(dims, ghostWidth, d);
+    return createCollection( d );
 }
 
-/*
-equelle::CartesianGrid::CartesianCollectionOfScalar equelle::CartesianGrid::inputFaceScalarWithDefault(std::string , double d )
+equelle::FaceStencilCollOfScalar equelle::CartesianEquelleRuntime::inputFaceScalarWithDefault(std::string /*name*/, double d)
 {
-    int num = number_of_faces_with_ghost_cells[Dimension::x] * (cartdims[1]+2*ghost_width) +
-            number_of_faces_with_ghost_cells[Dimension::y] * (cartdims[0]+2*ghost_width);
+    return FaceStencilCollOfScalar( createGrid(), d );
+}
 
-    CartesianCollectionOfScalar v( num, 0.0 );
 
-    for( int j = 0; j < cartdims[1]; ++j ) {
-        for( int i = 0; i <= cartdims[0]; ++i ) {
-            faceAt( i, j, Face::negX, v ) = d;
-        }
-    }
 
-    for( int j = 0; j <= cartdims[1]; ++j ) {
-        for( int i = 0; i < cartdims[0]; ++i ) {
-            faceAt( i, j, Face::negY, v ) = d;
-        }
-    }
+equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputStencilCollectionOfScalar( std::string name, CollOfCell) {
+		return inputCellCollectionOfScalar(name);
+}
+
+equelle::FaceStencilCollOfScalar equelle::CartesianEquelleRuntime::inputStencilCollectionOfScalar( std::string name, CollOfFace) {
+    return inputFaceCollectionOfScalar(name);
+}
 
+equelle::MultiStencilCollOfScalar equelle::CartesianEquelleRuntime::inputCellMultiCollectionOfScalar( const std::vector<std::string>& names,
+                                                                                                     ComponentLayout layout )
+{
+    const StencilCollOfScalar first = inputCellCollectionOfScalar( names.at(0) );
+    MultiStencilCollOfScalar v( names.size(), first.grid, layout );
+    v.setComponent( 0, first );
+    for ( int c = 1; c < int(names.size()); ++c ) {
+        v.setComponent( c, inputCellCollectionOfScalar( names[c] ) );
+    }
     return v;
 }
-*/
 
+void equelle::CartesianEquelleRuntime::output(std::string var_name_, const equelle::MultiStencilCollOfScalar& var_) {
+    for ( int c = 0; c < var_.num_components; ++c ) {
+        std::ostringstream name;
+        name << var_name_ << "[" << c << "]";
+        output( name.str(), var_.component( c ) );
+    }
+}
 
+void equelle::CartesianEquelleRuntime::ensureGhostWidthMin( int width )
+{
+    if ( !param_.has( "ghost_width" ) ) {
+        ghost_width_ = width;
+    } else if ( ghost_width_ < width ) {
+        OPM_THROW(std::runtime_error, "The stencils of this program need a ghost width of at least " << width
+                  << ", but ghost_width is " << ghost_width_ << ".");
+    }
+}
 
-equelle::StencilCollOfScalar equelle::CartesianEquelleRuntime::inputStencilCollectionOfScalar( std::string name, CollOfCell) {
-		return inputCellCollectionOfScalar(name);
+void equelle::CartesianEquelleRuntime::applyCartesianBoundaryConditions( StencilCollOfScalar& coll, const std::string& conditions )
+{
+    std::istringstream is( conditions );
+    std::vector<std::string> tokens( (std::istream_iterator<std::string>( is )), std::istream_iterator<std::string>() );
+    const int num_sides = 2*coll.grid.dimensions;
+    if ( tokens.size() != 1 && int(tokens.size()) != num_sides ) {
+        OPM_THROW(std::runtime_error, "Expected 1 or " << num_sides << " boundary conditions, got \"" << conditions << "\".");
+    }
+    for ( int side = 0; side < num_sides; ++side ) {
+        const std::string& token = tokens.size() == 1 ? tokens[0] : tokens[side];
+        BoundaryCondition bc;
+        double value = 0.0;
+        if ( token == "periodic" ) {
+            bc = BoundaryCondition::Periodic;
+        } else if ( token == "reflective" ) {
+            bc = BoundaryCondition::Reflective;
+        } else if ( token == "negated_reflective" ) {
+            bc = BoundaryCondition::NegatedReflective;
+        } else if ( token == "extrapolate" ) {
+            bc = BoundaryCondition::Extrapolate;
+        } else if ( token.compare( 0, 10, "dirichlet=" ) == 0 ) {
+            bc = BoundaryCondition::Dirichlet;
+            value = std::stod( token.substr( 10 ) );
+        } else {
+            OPM_THROW(std::runtime_error, "Unknown boundary condition \"" << token << "\".");
+        }
+        coll.grid.applyBoundaryCondition( coll, static_cast<CartesianGrid::Face>( side ), bc, value );
+    }
 }
 
 void equelle::CartesianEquelleRuntime::output(std::string var_name_, const equelle::StencilCollOfScalar& var_) {
+    if ( output_to_file_ ) {
+        std::vector<double> values;
+        var_.grid.packCells( var_, output_ghost_cells_, values );
+        writeOutputFile( var_name_, std::move( values ) );
+        return;
+    }
 	std::cout << var_name_ << " = [" << std::endl;
-	var_.grid.dumpGridCells(var_, std::cout);
+	var_.grid.dumpGridCells(var_, std::cout, output_ghost_cells_);
 	std::cout << "]" << std::endl;
 }
 
+void equelle::CartesianEquelleRuntime::writeOutputFile( const std::string& tag, std::vector<double>&& values )
+{
+    const int count = outputcount_[tag]++;
+    std::ostringstream fname;
+    fname << tag << "-" << std::setw(5) << std::setfill('0') << count << ( output_binary_ ? ".bin" : ".output" );
+
+    const bool binary = output_binary_;
+    auto write = [binary]( const std::string& filename, const std::vector<double>& data ) {
+        std::ofstream file( filename.c_str(), binary ? std::ios::out | std::ios::binary : std::ios::out );
+        if ( !file ) {
+            OPM_THROW(std::runtime_error, "Failed to open " << filename);
+        }
+        if ( binary ) {
+            file.write( reinterpret_cast<const char*>( data.data() ), data.size()*sizeof(double) );
+        } else {
+            file.precision(16);
+            std::copy( data.begin(), data.end(), std::ostream_iterator<double>( file, "\n" ) );
+        }
+        if ( !file ) {
+            OPM_THROW(std::runtime_error, "Failed to write " << filename);
+        }
+    };
+
+    // At most one file is written in the background. Waiting for it here also
+    // reports any error from writing it.
+    if ( pending_output_.valid() ) {
+        pending_output_.get();
+    }
+    if ( output_async_ ) {
+        pending_output_ = std::async( std::launch::async, write, fname.str(), std::move( values ) );
+    } else {
+        write( fname.str(), values );
+    }
+}
+
+void equelle::CartesianEquelleRuntime::output(std::string var_name_, const equelle::FaceStencilCollOfScalar& var_) {
+    const char* directions = "xyz";
+    for ( int d = 0; d < var_.grid.dimensions; ++d ) {
+        std::cout << var_name_ << "." << directions[d] << " = [" << std::endl;
+        var_.grid.dumpGridFaces( var_, static_cast<CartesianGrid::Face>( 2*d ), std::cout );
+        std::cout << "]" << std::endl;
+    }
+}
+
 
 
 
@@ -176,11 +321,15 @@ void equelle::CartesianGrid::init2D( std::tuple<int, int> dims, int ghostWidth )
     cartdims[0] = std::get<0>( dims );
     cartdims[1] = std::get<1>( dims );
 
+    cartdims[2] = 1;
+
     cellStrides[0] = 1;
     cellStrides[1] = 2*ghostWidth + cartdims[0];
+    cellStrides[2] = cellStrides[1] * (2*ghostWidth + cartdims[1]);
 
-    faceStrides[Dimension::x] = {{1, cellStrides[1] + 1}};
-    faceStrides[Dimension::y] = {{1, cellStrides[1]}};
+    faceStrides[Dimension::x] = {{1, cellStrides[1] + 1, 0}};
+    faceStrides[Dimension::y] = {{1, cellStrides[1], 0}};
+    faceStrides[Dimension::z] = {{0, 0, 0}};
 
 
     this->ghost_width = ghostWidth;
@@ -192,6 +341,43 @@ void equelle::CartesianGrid::init2D( std::tuple<int, int> dims, int ghostWidth )
 
     number_of_faces_with_ghost_cells[Dimension::x] = (cartdims[0]+2*ghostWidth+1);
     number_of_faces_with_ghost_cells[Dimension::y] = (cartdims[1]+2*ghostWidth+1);
+    number_of_faces_with_ghost_cells[Dimension::z] = 0;
+
+    faceBlockOffsets[Dimension::x] = 0;
+    faceBlockOffsets[Dimension::y] = number_of_faces_with_ghost_cells[Dimension::x] * (cartdims[1]+2*ghostWidth);
+    faceBlockOffsets[Dimension::z] = faceBlockOffsets[Dimension::y] + (cartdims[0]+2*ghostWidth) * number_of_faces_with_ghost_cells[Dimension::y];
+    number_of_faces_and_ghost_faces = faceBlockOffsets[Dimension::z];
+}
+
+void equelle::CartesianGrid::init3D( std::tuple<int, int, int> dims, int ghostWidth )
+{
+    cartdims[0] = std::get<0>( dims );
+    cartdims[1] = std::get<1>( dims );
+    cartdims[2] = std::get<2>( dims );
+
+    cellStrides[0] = 1;
+    cellStrides[1] = 2*ghostWidth + cartdims[0];
+    cellStrides[2] = cellStrides[1] * (2*ghostWidth + cartdims[1]);
+
+    faceStrides[Dimension::x] = {{1, cellStrides[1] + 1, (cellStrides[1] + 1) * (2*ghostWidth + cartdims[1])}};
+    faceStrides[Dimension::y] = {{1, cellStrides[1], cellStrides[1] * (2*ghostWidth + cartdims[1] + 1)}};
+    faceStrides[Dimension::z] = {{1, cellStrides[1], cellStrides[2]}};
+
+    this->ghost_width = ghostWidth;
+    this->dimensions = 3;
+    this->number_of_cells = cartdims[0]*cartdims[1]*cartdims[2];
+
+    this->number_of_cells_and_ghost_cells = (cartdims[0]+2*ghostWidth) * (cartdims[1]+2*ghostWidth) * (cartdims[2]+2*ghostWidth);
+    this->cellOrigin = ghost_width * cellStrides[2] + ghost_width * cellStrides[1] + ghost_width * cellStrides[0];
+
+    number_of_faces_with_ghost_cells[Dimension::x] = (cartdims[0]+2*ghostWidth+1);
+    number_of_faces_with_ghost_cells[Dimension::y] = (cartdims[1]+2*ghostWidth+1);
+    number_of_faces_with_ghost_cells[Dimension::z] = (cartdims[2]+2*ghostWidth+1);
+
+    faceBlockOffsets[Dimension::x] = 0;
+    faceBlockOffsets[Dimension::y] = faceStrides[Dimension::x][2] * (cartdims[2]+2*ghostWidth);
+    faceBlockOffsets[Dimension::z] = faceBlockOffsets[Dimension::y] + faceStrides[Dimension::y][2] * (cartdims[2]+2*ghostWidth);
+    number_of_faces_and_ghost_faces = faceBlockOffsets[Dimension::z] + faceStrides[Dimension::z][2] * number_of_faces_with_ghost_cells[Dimension::z];
 }
 
 equelle::CartesianGrid::CartesianGrid( std::tuple<int, int> dims, int ghostWidth )
@@ -199,6 +385,11 @@ equelle::CartesianGrid::CartesianGrid( std::tuple<int, int> dims, int ghostWidth
     init2D( dims, ghostWidth );
 }
 
+equelle::CartesianGrid::CartesianGrid( std::tuple<int, int, int> dims, int ghostWidth )
+{
+    init3D( dims, ghostWidth );
+}
+
 equelle::CartesianGrid::~CartesianGrid()
 {
 
@@ -206,160 +397,255 @@ equelle::CartesianGrid::~CartesianGrid()
 
 
 
-double& equelle::CartesianGrid::cellAt( equelle::StencilCollOfScalar &coll,  const int i, const int j ) const
+equelle::FaceStencilCollOfScalar::FaceStencilCollOfScalar( const CartesianGrid& g, double default_value )
+    : grid( g )
 {
-    const int index = cellOrigin + j*cellStrides[1] + i*cellStrides[0];
-    return coll.data[ index ];
+    data.resize( grid.number_of_faces_and_ghost_faces, 0.0 );
+    if ( default_value == 0.0 ) {
+        return;
+    }
+    // All faces of the interior cells, including the faces on the domain boundary.
+    const CartesianGrid::Face neg[3] = { CartesianGrid::Face::negX, CartesianGrid::Face::negY, CartesianGrid::Face::negZ };
+    for ( int d = 0; d < grid.dimensions; ++d ) {
+        const int ni = grid.cartdims[0] + ( d == 0 ? 1 : 0 );
+        const int nj = grid.cartdims[1] + ( d == 1 ? 1 : 0 );
+        const int nk = grid.cartdims[2] + ( d == 2 ? 1 : 0 );
+        for ( int k = 0; k < nk; ++k ) {
+            for ( int j = 0; j < nj; ++j ) {
+                double* begin = &grid.faceAt( *this, 0, j, k, neg[d] );
+                std::fill( begin, begin + ni, default_value );
+            }
+        }
+    }
 }
 
-const double &equelle::CartesianGrid::cellAt( const equelle::StencilCollOfScalar &coll,  const int i, const int j) const
+void equelle::CartesianGrid::packCells( const equelle::StencilCollOfScalar& coll, bool with_ghost_cells,
+                                        std::vector<double>& buffer ) const
 {
-    const int index = cellOrigin + j*cellStrides[1] + i*cellStrides[0];
-    return coll.data[ index ];
+    if ( with_ghost_cells ) {
+        buffer.assign( coll.data.begin(), coll.data.end() );
+        return;
+    }
+    // One contiguous copy per row of interior cells.
+    buffer.resize( number_of_cells );
+    double* out = buffer.data();
+    for ( int k = 0; k < cartdims[2]; ++k ) {
+        for ( int j = 0; j < cartdims[1]; ++j ) {
+            out = std::copy_n( coll.data.data() + cellIndex( 0, j, k ), cartdims[0], out );
+        }
+    }
 }
 
-/*
-double &equelle::CartesianGrid::faceAt(int i, int j, const equelle::CartesianGrid::Face face, equelle::CartesianGrid::CartesianCollectionOfScalar &coll) const
+void equelle::CartesianGrid::unpackCells( const std::vector<double>& buffer, bool with_ghost_cells,
+                                          equelle::StencilCollOfScalar& coll ) const
 {
-    i += ghost_width;
-    j += ghost_width;
-
-    // Update index to the correct cell.
-    switch (face) {
-    case Face::posX:
-        ++i;
-        break;
-    case Face::posY:
-        ++j;
-        break;
-    default:
-        // Intentional, the other faces does not need index manipulation.
-        break;
-    }
-
-    int offset = 0;
-    strideArray strides;
-
-    switch (face) {
-    case Face::posX:
-    case Face::negX:
-        offset = 0;
-        strides = faceStrides[Dimension::x];
-        break;
-    case Face::posY:
-    case Face::negY:
-        offset = number_of_faces_with_ghost_cells[Dimension::x] * ( cartdims[1] + 2*ghost_width );
-        strides = faceStrides[Dimension::y];
-        break;
-    default:
-        throw std::runtime_error("Only 2D-cartesian grids are supported, so far...");
-        break;
-    }
-
-    return coll[offset + j*strides[1] + i*strides[0] ];
-}
-
-const double &equelle::CartesianGrid::faceAt(int i, int j, equelle::CartesianGrid::Face face, const equelle::CartesianGrid::CartesianCollectionOfScalar &coll) const
+    if ( with_ghost_cells ) {
+        assert( int(buffer.size()) == number_of_cells_and_ghost_cells );
+        std::copy( buffer.begin(), buffer.end(), coll.data.begin() );
+        return;
+    }
+    assert( int(buffer.size()) == number_of_cells );
+    const double* in = buffer.data();
+    for ( int k = 0; k < cartdims[2]; ++k ) {
+        for ( int j = 0; j < cartdims[1]; ++j ) {
+            std::copy_n( in, cartdims[0], coll.data.data() + cellIndex( 0, j, k ) );
+            in += cartdims[0];
+        }
+    }
+}
+
+void equelle::CartesianGrid::dumpGridCells(const equelle::StencilCollOfScalar &cells, std::ostream &stream, bool with_ghost_cells) const
 {
-    i += ghost_width;
-    j += ghost_width;
-
-    // Update index to the correct cell.
-    switch (face) {
-    case Face::posX:
-        ++i;
-        break;
-    case Face::posY:
-        ++j;
-        break;
-    default:
-        // Intentional, the other faces does not need index manipulation.
-        break;
-    }
-
-    int offset = 0;
-    strideArray strides;
-
-    switch (face) {
-    case Face::posX:
-    case Face::negX:
-        offset = 0;
-        strides = faceStrides[Dimension::x];
-        break;
-    case Face::posY:
-    case Face::negY:
-        offset = number_of_faces_with_ghost_cells[Dimension::x] * ( cartdims[1] + 2*ghost_width );
-        strides = faceStrides[Dimension::y];
-        break;
-    default:
-        throw std::runtime_error("Only 2D-cartesian grids are supported, so far...");
-        break;
-    }
-
-    return coll[offset + j*strides[1] + i*strides[0] ];
-}
-*/
-
-void equelle::CartesianGrid::dumpGridCells(const equelle::StencilCollOfScalar &cells, std::ostream &stream) const
+    // 3D grids are written as one 2D layer after the other, separated by an empty line.
+    const int gw = with_ghost_cells ? ghost_width : 0;
+    const int gz = dimensions == 3 ? gw : 0;
+    const int num_columns = cartdims[0] + 2*gw;
+    for( int k = -gz; k < cartdims[2] + gz; ++k ) {
+        if ( k > -gz ) {
+            stream << std::endl;
+        }
+        for( int j = -gw; j < cartdims[1] + gw; ++j ) {
+            const int row_offset = cellIndex( -gw, j, k );
+            std::copy_n( cells.data.begin() + row_offset, num_columns - 1, std::ostream_iterator<double>( stream, "," ) );
+            stream << cells.data[row_offset + num_columns-1];
+            stream << std::endl;
+        }
+    }
+}
+
+
+void equelle::StencilCollOfScalar::swapAssign( StencilCollOfScalar& source )
 {
-    int num_columns = cartdims[0] + 2*ghost_width;
-    for( int j = 0; j < cartdims[1] + 2*ghost_width; ++j ) {
-        int row_offset  = j*cellStrides[1];
-        std::copy_n( cells.data.begin() + row_offset, num_columns - 1, std::ostream_iterator<double>( stream, "," ) );
-        stream << cells.data[row_offset + num_columns-1];
-        stream << std::endl;
+    if ( data.size() != source.data.size() || grid.cartdims != source.grid.cartdims
+         || grid.ghost_width != source.grid.ghost_width ) {
+        *this = source;
+        return;
     }
+    std::swap( data, source.data );
+    source.copyGhostCellsFrom( *this );
 }
 
+void equelle::StencilCollOfScalar::copyGhostCellsFrom( const StencilCollOfScalar& other )
+{
+    if ( data.size() != other.data.size() ) {
+        throw std::runtime_error( "Cannot copy ghost cells between collections on different grids." );
+    }
+    // Copy row by row. Rows outside the interior in y (or z) are ghost cells only,
+    // the other rows have ghost_width cells at each end.
+    const CartesianGrid& g = grid;
+    const int gw = g.ghost_width;
+    const int row_length = g.cartdims[0] + 2*gw;
+    const int gz = g.dimensions == 3 ? gw : 0;
+    for ( int k = -gz; k < g.cartdims[2] + gz; ++k ) {
+        for ( int j = -gw; j < g.cartdims[1] + gw; ++j ) {
+            const int row = g.cellIndex( -gw, j, k );
+            if ( j < 0 || j >= g.cartdims[1] || k < 0 || k >= g.cartdims[2] ) {
+                std::copy_n( other.data.begin() + row, row_length, data.begin() + row );
+            }
+            else {
+                std::copy_n( other.data.begin() + row, gw, data.begin() + row );
+                const int right = row + gw + g.cartdims[0];
+                std::copy_n( other.data.begin() + right, gw, data.begin() + right );
+            }
+        }
+    }
+}
+
+
+equelle::MultiStencilCollOfScalar::MultiStencilCollOfScalar( int numComponents, const CartesianGrid& g, ComponentLayout l )
+    : grid( g ), num_components( numComponents ), layout( l )
+{
+    int size = numComponents * grid.number_of_cells_and_ghost_cells;
+    if ( layout == ComponentLayout::AoSoA ) {
+        const int num_blocks = ( grid.number_of_cells_and_ghost_cells + block_size - 1 ) / block_size;
+        size = num_blocks * block_size * numComponents;
+    }
+    data.resize( size, 0.0 );
+}
 
-/*
-void equelle::CartesianGrid::dumpGridFaces( equelle::CartesianGrid::CartesianCollectionOfScalar &faces, Face input_face, std::ostream &stream)
+equelle::StencilCollOfScalar equelle::MultiStencilCollOfScalar::component( int c ) const
 {
-    Face face = input_face;
-    int face_offset_x = 0;
-    int face_offset_y = 0;
-
-    switch(face) {
-    case Face::posX:
-    case Face::negX:
-        face = Face::negX;
-        face_offset_x = 1;
-        break;
-    case Face::posY:
-    case Face::negY:
-        face = Face::negY;
-        face_offset_y = 1;
-        break;
-    default:
-        throw std::runtime_error("Unknown face position");
-    }
-
-    int start_x = -ghost_width;
-    int end_x = cartdims[0] + ghost_width + face_offset_x;
-
-    int start_y = -ghost_width;
-    int end_y = cartdims[1] + ghost_width + face_offset_y;
-
-
-    for( int j = start_y; j < end_y; ++j ) {
-        stream << faceAt( start_x, j, face, faces);
-        for( int i = start_x+1; i < end_x; ++i ) {
-            stream << "," << faceAt( i, j, face, faces);
+    StencilCollOfScalar v;
+    v.grid = grid;
+    v.data.resize( grid.number_of_cells_and_ghost_cells );
+    for ( int cell = 0; cell < grid.number_of_cells_and_ghost_cells; ++cell ) {
+        v.data[cell] = data[ offset( c, cell ) ];
+    }
+    return v;
+}
+
+void equelle::MultiStencilCollOfScalar::setComponent( int c, const StencilCollOfScalar& values )
+{
+    if ( int(values.data.size()) != grid.number_of_cells_and_ghost_cells ) {
+        throw std::runtime_error( "Component does not match the grid of the multi-component collection." );
+    }
+    for ( int cell = 0; cell < grid.number_of_cells_and_ghost_cells; ++cell ) {
+        data[ offset( c, cell ) ] = values.data[cell];
+    }
+}
+
+void equelle::CartesianGrid::applyBoundaryCondition( equelle::StencilCollOfScalar &coll, Face side, BoundaryCondition bc, double value ) const
+{
+    const int d = static_cast<int>( side ) / 2;
+    const bool positive = ( static_cast<int>( side ) % 2 ) == 1;
+    if ( d >= dimensions ) {
+        throw std::runtime_error( "Boundary condition given for a side the grid does not have." );
+    }
+    const int n = cartdims[d];
+    if ( n < ghost_width && bc != BoundaryCondition::Extrapolate ) {
+        throw std::runtime_error( "The grid is too thin for the ghost width to apply this boundary condition." );
+    }
+
+    // Each ghost cell is set to scale*source + offset.
+    double scale = 1.0;
+    double offset = 0.0;
+    if ( bc == BoundaryCondition::NegatedReflective ) {
+        scale = -1.0;
+    } else if ( bc == BoundaryCondition::Dirichlet ) {
+        scale = -1.0;
+        offset = 2.0*value;
+    }
+
+    // Ranges of the two other dimensions of the ghost planes, see the header.
+    // The inner one is contiguous in memory except when filling x-ghosts.
+    const int a = ( d == 0 ) ? 1 : 0;
+    const int b = 3 - d - a;
+    int lo[3];
+    int hi[3];
+    for ( int e = 0; e < 3; ++e ) {
+        const int gw = ( e < d ) ? ghost_width : 0;
+        lo[e] = -gw;
+        hi[e] = cartdims[e] + gw;
+    }
+
+    double* base = coll.data.data() + cellOrigin;
+    const int sa = cellStrides[a];
+    for ( int g = 1; g <= ghost_width; ++g ) {
+        const int dst_plane = positive ? n - 1 + g : -g;
+        int src_plane = 0;
+        switch ( bc ) {
+        case BoundaryCondition::Periodic:
+            src_plane = positive ? g - 1 : n - g;
+            break;
+        case BoundaryCondition::Extrapolate:
+            src_plane = positive ? n - 1 : 0;
+            break;
+        default:
+            src_plane = positive ? n - g : g - 1;
+            break;
+        }
+        for ( int y = lo[b]; y < hi[b]; ++y ) {
+            double* dst = base + dst_plane*cellStrides[d] + y*cellStrides[b];
+            const double* src = base + src_plane*cellStrides[d] + y*cellStrides[b];
+            for ( int x = lo[a]; x < hi[a]; ++x ) {
+                dst[x*sa] = scale*src[x*sa] + offset;
+            }
+        }
+    }
+}
+
+void equelle::CartesianGrid::dumpGridFaces( const equelle::FaceStencilCollOfScalar &faces, Face face, std::ostream &stream ) const
+{
+    const int d = static_cast<int>( face ) / 2;
+    if ( d >= dimensions ) {
+        throw std::runtime_error( "The grid has no faces in the given direction." );
+    }
+    const Face neg = static_cast<Face>( 2*d );
+    const int end_x = cartdims[0] + ghost_width + ( d == 0 ? 1 : 0 );
+    const int end_y = cartdims[1] + ghost_width + ( d == 1 ? 1 : 0 );
+    const int start_z = dimensions == 3 ? -ghost_width : 0;
+    const int end_z = dimensions == 3 ? cartdims[2] + ghost_width + ( d == 2 ? 1 : 0 ) : 1;
+
+    for( int k = start_z; k < end_z; ++k ) {
+        if ( k > start_z ) {
+            stream << std::endl;
+        }
+        for( int j = -ghost_width; j < end_y; ++j ) {
+            stream << faceAt( faces, -ghost_width, j, k, neg );
+            for( int i = -ghost_width+1; i < end_x; ++i ) {
+                stream << "," << faceAt( faces, i, j, k, neg );
+            }
+            stream << std::endl;
         }
-        stream << std::endl;
     }
 }
-*/
 
 equelle::CartesianGrid::CellRange equelle::CartesianGrid::allCells() {
-    return CellRange(0, cartdims[0], 0, cartdims[1]);
+    return CellRange(0, cartdims[0], 0, cartdims[1], 0, cartdims[2]);
 }
 
 equelle::CartesianGrid::FaceRange equelle::CartesianGrid::allXFaces() {
-    return FaceRange(0, cartdims[0]+1, 0, cartdims[1]);
+    return FaceRange(0, cartdims[0]+1, 0, cartdims[1], 0, cartdims[2]);
 }
 
 equelle::CartesianGrid::FaceRange equelle::CartesianGrid::allYFaces() {
-    return FaceRange(0, cartdims[0], 0, cartdims[1]+1);
+    return FaceRange(0, cartdims[0], 0, cartdims[1]+1, 0, cartdims[2]);
+}
+
+equelle::CartesianGrid::FaceRange equelle::CartesianGrid::allZFaces() {
+    if ( dimensions != 3 ) {
+        throw std::runtime_error( "Z-faces are only defined for 3D-cartesian grids." );
+    }
+    return FaceRange(0, cartdims[0], 0, cartdims[1], 0, cartdims[2]+1);
 }
 
@@ -11,6 +11,7 @@
 #include <iterator>
 #include <stdexcept>
 #include <set>
+#include <numeric>
 
 
 
@@ -49,12 +50,34 @@ Opm::GridManager* createGridManager(const Opm::parameter::ParameterGroup& param)
 }
 
 
+RenumberedGrid* createRenumberedGrid(const UnstructuredGrid& grid, const Opm::parameter::ParameterGroup& param)
+{
+    const String method_name = param.getDefault<String>("grid_renumbering", "none");
+    const GridRenumbering::Method method = GridRenumbering::methodFromString(method_name);
+    if (method == GridRenumbering::None) {
+        return nullptr;
+    }
+    return GridRenumbering::build(grid, method);
+}
+
+
+StructuredGrid* createStructuredGrid(const UnstructuredGrid& grid, const Opm::parameter::ParameterGroup& param)
+{
+    if (!param.getDefault("structured_fast_path", true)) {
+        return nullptr;
+    }
+    return StructuredGrid::detect(grid);
+}
+
+
 
 
 EquelleRuntimeCPU::EquelleRuntimeCPU(const Opm::parameter::ParameterGroup& param)
     : grid_manager_(equelle::createGridManager(param)),
-      grid_(*(grid_manager_->c_grid())),
-      ops_(grid_),
+      renumbering_(equelle::createRenumberedGrid(*(grid_manager_->c_grid()), param)),
+      grid_(renumbering_ ? *(renumbering_->c_grid) : *(grid_manager_->c_grid())),
+      num_interior_faces_(countInteriorFaces(grid_)),
+      structured_(equelle::createStructuredGrid(grid_, param)),
       linsolver_(param),
       output_to_file_(param.getDefault("output_to_file", false)),
       verbose_(param.getDefault("verbose", 0)),
@@ -66,7 +89,8 @@ EquelleRuntimeCPU::EquelleRuntimeCPU(const Opm::parameter::ParameterGroup& param
 
 EquelleRuntimeCPU::EquelleRuntimeCPU(const UnstructuredGrid *grid, const Opm::parameter::ParameterGroup &param)
     : grid_( *grid ),
-      ops_(grid_),
+      num_interior_faces_(countInteriorFaces(grid_)),
+      structured_(equelle::createStructuredGrid(grid_, param)),
       linsolver_(param),
       output_to_file_(param.getDefault("output_to_file", false)),
       verbose_(param.getDefault("verbose", 0)),
@@ -144,40 +168,50 @@ CollOfFace EquelleRuntimeCPU::allFaces() const
 
 // Again... this is kind of botched for a 1D grid implemented as a 2D(n, 1) or 2D(1, n) grid...
 
-CollOfFace EquelleRuntimeCPU::boundaryFaces() const
+bool EquelleRuntimeCPU::interiorFace(const UnstructuredGrid& grid, const int face_index)
 {
-    const int nif = ops_.internal_faces.size();
-    const int nbf = grid_.number_of_faces - nif;
-    CollOfFace bfaces(nbf);
-    int if_cursor = 0;
-    int bf_cursor = 0;
+    return grid.face_cells[2*face_index] >= 0 && grid.face_cells[2*face_index + 1] >= 0;
+}
 
-    // This works as long as ops_.internal_faces(i)<ops_.internal_faces(i+1), which it currently is.
-    // Would be better to extend HelperOps to support this functionality.
 
-    for (int i = 0; i < grid_.number_of_faces; ++i) {
-        // Advance if_cursor so that the next internal face to look out for has larger or equal index to i
-        while ( (if_cursor < nif) && (i > ops_.internal_faces[if_cursor]) ) {
-            ++if_cursor;
-        }
-        // Now if_cursor points beyond the last internal face, or internal_face[if_cursor]>=i.
-        // If (if_cursor points beyond the last internal face) or (internal_face[if_cursor] is truly > i), we surely have a boundary face...
-        if ( (if_cursor == nif) || (ops_.internal_faces[if_cursor] > i) ) {
-            bfaces[bf_cursor].index = i;
-            ++bf_cursor;
+int EquelleRuntimeCPU::countInteriorFaces(const UnstructuredGrid& grid)
+{
+    int count = 0;
+    for (int f = 0; f < grid.number_of_faces; ++f) {
+        if (interiorFace(grid, f)) {
+            ++count;
         }
     }
+    return count;
+}
+
 
+// The face sets are computed directly from face_cells, using the same definition
+// of interior faces as Opm::HelperOps, so that they do not require the operators to be built.
+
+CollOfFace EquelleRuntimeCPU::boundaryFaces() const
+{
+    const int nf = grid_.number_of_faces;
+    CollOfFace bfaces;
+    bfaces.reserve(nf - num_interior_faces_);
+    for (int f = 0; f < nf; ++f) {
+        if (!interiorFace(grid_, f)) {
+            bfaces.emplace_back(Face(f));
+        }
+    }
     return bfaces;
 }
 
 
 CollOfFace EquelleRuntimeCPU::interiorFaces() const
 {
-    const int nif = ops_.internal_faces.size();
-    CollOfFace ifaces(nif);
-    for (int i = 0; i < nif; ++i) {
-        ifaces[i].index = ops_.internal_faces(i);
+    const int nf = grid_.number_of_faces;
+    CollOfFace ifaces;
+    ifaces.reserve(num_interior_faces_);
+    for (int f = 0; f < nf; ++f) {
+        if (interiorFace(grid_, f)) {
+            ifaces.emplace_back(Face(f));
+        }
     }
     return ifaces;
 }
@@ -187,6 +221,12 @@ CollOfCell EquelleRuntimeCPU::firstCell(const CollOfFace& faces) const
 {
     const int n = faces.size();
     CollOfCell fcells(n);
+    if (structured_) {
+        for (int i = 0; i < n; ++i) {
+            fcells[i].index = structured_->firstCell(faces[i].index);
+        }
+        return fcells;
+    }
     for (int i = 0; i < n; ++i) {
         fcells[i].index = grid_.face_cells[2*faces[i].index];
     }
@@ -198,6 +238,12 @@ CollOfCell EquelleRuntimeCPU::secondCell(const CollOfFace& faces) const
 {
     const int n = faces.size();
     CollOfCell fcells(n);
+    if (structured_) {
+        for (int i = 0; i < n; ++i) {
+            fcells[i].index = structured_->secondCell(faces[i].index);
+        }
+        return fcells;
+    }
     for (int i = 0; i < n; ++i) {
         fcells[i].index = grid_.face_cells[2*faces[i].index + 1];
     }
@@ -209,6 +255,12 @@ CollOfScalar EquelleRuntimeCPU::norm(const CollOfFace& faces) const
 {
     const int n = faces.size();
     CollOfScalar::V areas(n);
+    if (structured_) {
+        for (int i = 0; i < n; ++i) {
+            areas[i] = structured_->faceArea(structured_->faceDirection(faces[i].index));
+        }
+        return areas;
+    }
     for (int i = 0; i < n; ++i) {
         areas[i] = grid_.face_areas[faces[i].index];
     }
@@ -219,6 +271,9 @@ CollOfScalar EquelleRuntimeCPU::norm(const CollOfFace& faces) const
 CollOfScalar EquelleRuntimeCPU::norm(const CollOfCell& cells) const
 {
     const int n = cells.size();
+    if (structured_) {
+        return CollOfScalar::V(CollOfScalar::V::Constant(n, structured_->cellVolume()));
+    }
     CollOfScalar::V volumes(n);
     for (int i = 0; i < n; ++i) {
         volumes[i] = grid_.cell_volumes[cells[i].index];
@@ -229,6 +284,14 @@ CollOfScalar EquelleRuntimeCPU::norm(const CollOfCell& cells) const
 
 CollOfScalar EquelleRuntimeCPU::norm(const CollOfVector& vectors) const
 {
+    switch (vectors.numCols()) {
+    case 2:
+        return VectorKernels::norm<2>(vectors);
+    case 3:
+        return VectorKernels::norm<3>(vectors);
+    default:
+        break;
+    }
     CollOfScalar norm2 = vectors.col(0) * vectors.col(0);
     const int dim = vectors.numCols();
     for (int d = 1; d < dim; ++d) {
@@ -238,63 +301,126 @@ CollOfScalar EquelleRuntimeCPU::norm(const CollOfVector& vectors) const
 }
 
 
-CollOfVector EquelleRuntimeCPU::centroid(const CollOfFace& faces) const
+namespace
 {
-    const int n = faces.size();
-    const int dim = grid_.dimensions;
-    Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> c(n, dim);
-    for (int i = 0; i < n; ++i) {
-        const double* fc = grid_.face_centroids + dim * faces[i].index;
+    /// Gather the entries of a per-entity array for the given cells or faces.
+    template <class EntityCollection>
+    CollOfScalar::V gatherEntities(const CollOfScalar::V& source, const EntityCollection& entities)
+    {
+        const int n = entities.size();
+        CollOfScalar::V result(n);
+        for (int i = 0; i < n; ++i) {
+            result[i] = source[entities[i].index];
+        }
+        return result;
+    }
+
+    template <class EntityCollection>
+    CollOfVector gatherVectors(const std::vector<CollOfScalar::V>& source, const EntityCollection& entities)
+    {
+        const int dim = source.size();
+        CollOfVector result(dim);
+        for (int d = 0; d < dim; ++d) {
+            result.col(d) = CollOfScalar(gatherEntities(source[d], entities));
+        }
+        return result;
+    }
+
+    /// Computes the centroids of the given cells or faces of a structured grid from their indices.
+    template <class EntityCollection>
+    CollOfVector implicitCentroids(const StructuredGrid& sg, const EntityCollection& entities,
+                                   void (StructuredGrid::*centroid)(const int, double*) const)
+    {
+        const int dim = sg.dimensions;
+        const int n = entities.size();
+        std::vector<CollOfScalar::V> components(dim, CollOfScalar::V(n));
+        double c[3];
+        for (int i = 0; i < n; ++i) {
+            (sg.*centroid)(entities[i].index, c);
+            for (int d = 0; d < dim; ++d) {
+                components[d][i] = c[d];
+            }
+        }
+        CollOfVector result(dim);
         for (int d = 0; d < dim; ++d) {
-            c(i, d) = fc[d];
+            result.col(d) = CollOfScalar(components[d]);
         }
+        return result;
     }
-    CollOfVector centroids(dim);
-    for (int d = 0; d < dim; ++d) {
-        centroids.col(d) = CollOfScalar(c.col(d));
+
+    std::vector<CollOfScalar::V> splitComponents(const double* data, const int num, const int dim)
+    {
+        std::vector<CollOfScalar::V> components(dim, CollOfScalar::V(num));
+        for (int i = 0; i < num; ++i) {
+            for (int d = 0; d < dim; ++d) {
+                components[d][i] = data[dim*i + d];
+            }
+        }
+        return components;
     }
-    return centroids;
-}
+} // anonymous namespace
 
 
-CollOfVector EquelleRuntimeCPU::centroid(const CollOfCell& cells) const
+const EquelleRuntimeCPU::GeometryCache& EquelleRuntimeCPU::geometry() const
 {
-    const int n = cells.size();
-    const int dim = grid_.dimensions;
-    Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> c(n, dim);
-    for (int i = 0; i < n; ++i) {
-        const double* fc = grid_.cell_centroids + dim * cells[i].index;
+    if (!geometry_) {
+        const int dim = grid_.dimensions;
+        const int nc = grid_.number_of_cells;
+        const int nf = grid_.number_of_faces;
+        std::unique_ptr<GeometryCache> geom(new GeometryCache);
+        geom->cell_centroids = splitComponents(grid_.cell_centroids, nc, dim);
+        geom->face_centroids = splitComponents(grid_.face_centroids, nf, dim);
+        geom->face_unit_normals = splitComponents(grid_.face_normals, nf, dim);
+        // Since the UnstructuredGrid uses the unorthodox convention that face
+        // normals are scaled with the face areas, we must renormalize them.
+        CollOfScalar::V length = CollOfScalar::V::Zero(nf);
+        for (int d = 0; d < dim; ++d) {
+            length += geom->face_unit_normals[d].square();
+        }
+        length = length.sqrt();
         for (int d = 0; d < dim; ++d) {
-            c(i, d) = fc[d];
+            geom->face_unit_normals[d] /= length;
         }
+        geometry_ = std::move(geom);
     }
-    CollOfVector centroids(dim);
-    for (int d = 0; d < dim; ++d) {
-        centroids.col(d) = CollOfScalar(c.col(d));
+    return *geometry_;
+}
+
+
+CollOfVector EquelleRuntimeCPU::centroid(const CollOfFace& faces) const
+{
+    if (structured_) {
+        return implicitCentroids(*structured_, faces, &StructuredGrid::faceCentroid);
     }
-    return centroids;
+    return gatherVectors(geometry().face_centroids, faces);
+}
+
+
+CollOfVector EquelleRuntimeCPU::centroid(const CollOfCell& cells) const
+{
+    if (structured_) {
+        return implicitCentroids(*structured_, cells, &StructuredGrid::cellCentroid);
+    }
+    return gatherVectors(geometry().cell_centroids, cells);
 }
 
 
 CollOfVector EquelleRuntimeCPU::normal(const CollOfFace& faces) const
 {
-    const int n = faces.size();
-    const int dim = grid_.dimensions;
-    Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> nor(n, dim);
-    for (int i = 0; i < n; ++i) {
-        const double* fn = grid_.face_normals + dim * faces[i].index;
+    if (structured_) {
+        const int dim = structured_->dimensions;
+        const int n = faces.size();
+        std::vector<CollOfScalar::V> components(dim, CollOfScalar::V::Zero(n));
+        for (int i = 0; i < n; ++i) {
+            components[structured_->faceDirection(faces[i].index)][i] = 1.0;
+        }
+        CollOfVector result(dim);
         for (int d = 0; d < dim; ++d) {
-            nor(i, d) = fn[d];
+            result.col(d) = CollOfScalar(components[d]);
         }
+        return result;
     }
-    // Since the UnstructuredGrid uses the unorthodox convention that face
-    // normals are scaled with the face areas, we must renormalize them.
-    nor.colwise() /= nor.matrix().rowwise().norm().array();
-    CollOfVector normals(dim);
-    for (int d = 0; d < dim; ++d) {
-        normals.col(d) = CollOfScalar(nor.col(d));
-    }
-    return normals;
+    return gatherVectors(geometry().face_unit_normals, faces);
 }
 
 
@@ -311,7 +437,15 @@ CollOfScalar EquelleRuntimeCPU::dot(const CollOfVector& v1, const CollOfVector&
     if (v1.col(0).size() != v2.col(0).size()) {
         OPM_THROW(std::logic_error, "Non-matching size of Vector collections for dot().");
     }
-    const int dim = grid_.dimensions;
+    switch (v1.numCols()) {
+    case 2:
+        return VectorKernels::dot<2>(v1, v2);
+    case 3:
+        return VectorKernels::dot<3>(v1, v2);
+    default:
+        break;
+    }
+    const int dim = v1.numCols();
     CollOfScalar result = v1.col(0) * v2.col(0);
     for (int d = 1; d < dim; ++d) {
         result += v1.col(d) * v2.col(d);
@@ -320,32 +454,65 @@ CollOfScalar EquelleRuntimeCPU::dot(const CollOfVector& v1, const CollOfVector&
 }
 
 
+const Opm::HelperOps& EquelleRuntimeCPU::ops() const
+{
+    // The gradient and divergence matrices are only needed by programs
+    // that use them, so they are not built until first requested.
+    if (!ops_) {
+        ops_.reset(new Opm::HelperOps(grid_));
+    }
+    return *ops_;
+}
+
+
+// On structured grids, fields without derivatives are handled by the stride-based
+// kernels. Fields with derivatives still use the sparse operators, since their
+// Jacobians must be multiplied by the operator matrices anyway.
+
 CollOfScalar EquelleRuntimeCPU::gradient(const CollOfScalar& cell_scalarfield) const
 {
-    return ops_.grad * cell_scalarfield;//.matrix();
+    if (structured_ && cell_scalarfield.derivative().empty()) {
+        CollOfScalar::V grad(structured_->numInteriorFaces());
+        structured_->gradient(cell_scalarfield.value().data(), grad.data());
+        return grad;
+    }
+    return ops().grad * cell_scalarfield;//.matrix();
 }
 
 
 CollOfScalar EquelleRuntimeCPU::negGradient(const CollOfScalar& cell_scalarfield) const
 {
-    return ops_.ngrad * cell_scalarfield;//.matrix();
+    if (structured_ && cell_scalarfield.derivative().empty()) {
+        return -gradient(cell_scalarfield);
+    }
+    return ops().ngrad * cell_scalarfield;//.matrix();
 }
 
 
 CollOfScalar EquelleRuntimeCPU::divergence(const CollOfScalar& face_fluxes) const
 {
-    if (face_fluxes.size() == ops_.internal_faces.size()) {
+    if (face_fluxes.size() == num_interior_faces_) {
         // This is actually a hack, the compiler should know to emit interiorDivergence()
         // eventually, but as a temporary measure we do this.
         return interiorDivergence(face_fluxes);
     }
-    return ops_.fulldiv * face_fluxes;//.matrix();
+    if (structured_ && face_fluxes.derivative().empty()) {
+        CollOfScalar::V div(grid_.number_of_cells);
+        structured_->divergence(face_fluxes.value().data(), div.data());
+        return div;
+    }
+    return ops().fulldiv * face_fluxes;//.matrix();
 }
 
 
 CollOfScalar EquelleRuntimeCPU::interiorDivergence(const CollOfScalar& face_fluxes) const
 {
-    return ops_.div * face_fluxes;//.matrix();
+    if (structured_ && face_fluxes.derivative().empty()) {
+        CollOfScalar::V div(grid_.number_of_cells);
+        structured_->interiorDivergence(face_fluxes.value().data(), div.data());
+        return div;
+    }
+    return ops().div * face_fluxes;//.matrix();
 }
 
 
@@ -429,6 +596,36 @@ double EquelleRuntimeCPU::twoNorm(const CollOfScalar& vals) const
 }
 
 
+std::vector<int> EquelleRuntimeCPU::originalIndices(const CollOfCell& cells) const
+{
+    std::vector<int> orig(cells.size());
+    for (size_t i = 0; i < cells.size(); ++i) {
+        orig[i] = renumbering_ ? renumbering_->cell_new_to_old[cells[i].index] : cells[i].index;
+    }
+    return orig;
+}
+
+
+std::vector<int> EquelleRuntimeCPU::originalIndices(const CollOfFace& faces) const
+{
+    std::vector<int> orig(faces.size());
+    for (size_t i = 0; i < faces.size(); ++i) {
+        orig[i] = renumbering_ ? renumbering_->face_new_to_old[faces[i].index] : faces[i].index;
+    }
+    return orig;
+}
+
+
+std::vector<int> EquelleRuntimeCPU::originalOrder(const std::vector<int>& original_indices)
+{
+    std::vector<int> order(original_indices.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&original_indices](const int a, const int b) { return original_indices[a] < original_indices[b]; });
+    return order;
+}
+
+
 void EquelleRuntimeCPU::output(const String& tag, const double val) const
 {
     std::cout << tag << " = " << val << std::endl;
@@ -436,6 +633,47 @@ void EquelleRuntimeCPU::output(const String& tag, const double val) const
 
 
 void EquelleRuntimeCPU::output(const String& tag, const CollOfScalar& vals)
+{
+    if (renumbering_) {
+        OPM_THROW(std::logic_error, "Output of the collection " << tag << " needs its domain when grid_renumbering is used.");
+    }
+    std::vector<int> order(vals.size());
+    std::iota(order.begin(), order.end(), 0);
+    writeOutput(tag, vals, order);
+}
+
+
+void EquelleRuntimeCPU::output(const String& tag, const CollOfScalar& vals, const CollOfCell& domain)
+{
+    if (vals.size() != int(domain.size())) {
+        OPM_THROW(std::runtime_error, "Output of " << tag << " has " << vals.size() << " values for " << domain.size() << " cells.");
+    }
+    std::vector<int> order(vals.size());
+    if (renumbering_) {
+        order = originalOrder(originalIndices(domain));
+    } else {
+        std::iota(order.begin(), order.end(), 0);
+    }
+    writeOutput(tag, vals, order);
+}
+
+
+void EquelleRuntimeCPU::output(const String& tag, const CollOfScalar& vals, const CollOfFace& domain)
+{
+    if (vals.size() != int(domain.size())) {
+        OPM_THROW(std::runtime_error, "Output of " << tag << " has " << vals.size() << " values for " << domain.size() << " faces.");
+    }
+    std::vector<int> order(vals.size());
+    if (renumbering_) {
+        order = originalOrder(originalIndices(domain));
+    } else {
+        std::iota(order.begin(), order.end(), 0);
+    }
+    writeOutput(tag, vals, order);
+}
+
+
+void EquelleRuntimeCPU::writeOutput(const String& tag, const CollOfScalar& vals, const std::vector<int>& order)
 {
     if (output_to_file_) {
         int count = -1;
@@ -454,10 +692,12 @@ void EquelleRuntimeCPU::output(const String& tag, const CollOfScalar& vals)
             OPM_THROW(std::runtime_error, "Failed to open " << fname.str());
         }
         file.precision(16);
-        std::copy(vals.value().data(), vals.value().data() + vals.size(), std::ostream_iterator<double>(file, "\n"));
+        for (const int i : order) {
+            file << vals.value()[i] << '\n';
+        }
     } else {
         std::cout << tag << " =\n";
-        for (int i = 0; i < vals.size(); ++i) {
+        for (const int i : order) {
             std::cout << std::setw(15) << std::left << ( vals.value()[i] ) << " ";
         }
         std::cout << std::endl;
@@ -489,6 +729,12 @@ CollOfFace EquelleRuntimeCPU::inputDomainSubsetOf(const String& name,
     if (!is_sorted(data.begin(), data.end())) {
         OPM_THROW(std::runtime_error, "Input set of faces was not sorted in ascending order.");
     }
+    if (renumbering_) {
+        for (auto& e : data) {
+            e.index = renumbering_->face_old_to_new[e.index];
+        }
+        std::sort(data.begin(), data.end());
+    }
     if (!includes(face_superset.begin(), face_superset.end(), data.begin(), data.end())) {
         OPM_THROW(std::runtime_error, "Given faces are not in the assumed subset.");
     }
@@ -513,6 +759,12 @@ CollOfCell EquelleRuntimeCPU::inputDomainSubsetOf(const String& name,
     if (!is_sorted(data.begin(), data.end())) {
         OPM_THROW(std::runtime_error, "Input set of cells was not sorted in ascending order.");
     }
+    if (renumbering_) {
+        for (auto& e : data) {
+            e.index = renumbering_->cell_old_to_new[e.index];
+        }
+        std::sort(data.begin(), data.end());
+    }
     if (!includes(cell_superset.begin(), cell_superset.end(), data.begin(), data.end())) {
         OPM_THROW(std::runtime_error, "Given cells are not in the assumed subset.");
     }
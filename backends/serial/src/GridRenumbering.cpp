@@ -0,0 +1,300 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/GridRenumbering.hpp"
+#include "equelle/equelleTypes.hpp"
+
+#include <opm/core/grid.h>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+
+namespace equelle {
+
+RenumberedGrid::RenumberedGrid()
+    : c_grid(nullptr)
+{
+}
+
+RenumberedGrid::~RenumberedGrid()
+{
+    if (c_grid) {
+        destroy_grid(c_grid);
+    }
+}
+
+
+GridRenumbering::Method GridRenumbering::methodFromString(const std::string& name)
+{
+    if (name == "none") {
+        return None;
+    } else if (name == "rcm") {
+        return ReverseCuthillMcKee;
+    } else if (name == "sfc") {
+        return SpaceFillingCurve;
+    }
+    OPM_THROW(std::runtime_error, "Unknown grid_renumbering method " << name << " (expected none, rcm or sfc).");
+}
+
+
+namespace {
+
+    /// Compressed cell-to-cell adjacency built from face_cells.
+    struct CellAdjacency {
+        std::vector<int> pos;
+        std::vector<int> nbrs;
+
+        explicit CellAdjacency(const UnstructuredGrid& grid)
+            : pos(grid.number_of_cells + 1, 0)
+        {
+            const int nf = grid.number_of_faces;
+            for (int f = 0; f < nf; ++f) {
+                const int c0 = grid.face_cells[2*f];
+                const int c1 = grid.face_cells[2*f + 1];
+                if (c0 >= 0 && c1 >= 0) {
+                    ++pos[c0 + 1];
+                    ++pos[c1 + 1];
+                }
+            }
+            for (int c = 0; c < grid.number_of_cells; ++c) {
+                pos[c + 1] += pos[c];
+            }
+            nbrs.resize(pos.back());
+            std::vector<int> cursor(pos.begin(), pos.end() - 1);
+            for (int f = 0; f < nf; ++f) {
+                const int c0 = grid.face_cells[2*f];
+                const int c1 = grid.face_cells[2*f + 1];
+                if (c0 >= 0 && c1 >= 0) {
+                    nbrs[cursor[c0]++] = c1;
+                    nbrs[cursor[c1]++] = c0;
+                }
+            }
+        }
+
+        int degree(const int cell) const
+        {
+            return pos[cell + 1] - pos[cell];
+        }
+    };
+
+    /// Spread the lower bits of x so that there are (stride - 1) zero bits between each of them.
+    uint64_t spreadBits(uint64_t x, const int bits, const int stride)
+    {
+        uint64_t result = 0;
+        for (int b = 0; b < bits; ++b) {
+            result |= ((x >> b) & uint64_t(1)) << (b*stride);
+        }
+        return result;
+    }
+
+    template <typename T>
+    void permuteBlocks(const T* src, T* dst, const std::vector<int>& new_to_old, const int blocksize)
+    {
+        const int n = new_to_old.size();
+        for (int i = 0; i < n; ++i) {
+            std::copy_n(src + blocksize*new_to_old[i], blocksize, dst + blocksize*i);
+        }
+    }
+
+    std::vector<int> invert(const std::vector<int>& perm)
+    {
+        std::vector<int> inverse(perm.size());
+        for (int i = 0; i < int(perm.size()); ++i) {
+            inverse[perm[i]] = i;
+        }
+        return inverse;
+    }
+
+} // anonymous namespace
+
+
+std::vector<int> GridRenumbering::cellOrderRCM(const UnstructuredGrid& grid)
+{
+    const int nc = grid.number_of_cells;
+    const CellAdjacency adj(grid);
+
+    std::vector<int> order;
+    order.reserve(nc);
+    std::vector<bool> visited(nc, false);
+    std::vector<int> candidates;
+    std::deque<int> queue;
+
+    // Each pass of the outer loop handles one connected component, starting
+    // in the unvisited cell of lowest degree as a cheap pseudo-peripheral cell.
+    while (int(order.size()) < nc) {
+        int start = -1;
+        for (int c = 0; c < nc; ++c) {
+            if (!visited[c] && (start < 0 || adj.degree(c) < adj.degree(start))) {
+                start = c;
+            }
+        }
+        visited[start] = true;
+        queue.push_back(start);
+        while (!queue.empty()) {
+            const int cell = queue.front();
+            queue.pop_front();
+            order.push_back(cell);
+
+            candidates.clear();
+            for (int i = adj.pos[cell]; i < adj.pos[cell + 1]; ++i) {
+                const int nbr = adj.nbrs[i];
+                if (!visited[nbr]) {
+                    visited[nbr] = true;
+                    candidates.push_back(nbr);
+                }
+            }
+            std::stable_sort(candidates.begin(), candidates.end(),
+                             [&adj](const int a, const int b) { return adj.degree(a) < adj.degree(b); });
+            queue.insert(queue.end(), candidates.begin(), candidates.end());
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+
+std::vector<int> GridRenumbering::cellOrderSFC(const UnstructuredGrid& grid)
+{
+    const int nc = grid.number_of_cells;
+    const int dim = grid.dimensions;
+    // Number of bits used per coordinate, so that the interleaved key fits in 64 bits.
+    const int bits = std::min(62 / dim, 31);
+    const double maxq = double((uint64_t(1) << bits) - 1);
+
+    std::vector<double> lo(dim, std::numeric_limits<double>::max());
+    std::vector<double> hi(dim, std::numeric_limits<double>::lowest());
+    for (int c = 0; c < nc; ++c) {
+        for (int d = 0; d < dim; ++d) {
+            const double x = grid.cell_centroids[dim*c + d];
+            lo[d] = std::min(lo[d], x);
+            hi[d] = std::max(hi[d], x);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, int> > keys(nc);
+    for (int c = 0; c < nc; ++c) {
+        uint64_t key = 0;
+        for (int d = 0; d < dim; ++d) {
+            const double extent = hi[d] - lo[d];
+            const double rel = extent > 0.0 ? (grid.cell_centroids[dim*c + d] - lo[d]) / extent : 0.0;
+            const uint64_t q = uint64_t(rel * maxq);
+            key |= spreadBits(q, bits, dim) << d;
+        }
+        keys[c] = std::make_pair(key, c);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order(nc);
+    for (int c = 0; c < nc; ++c) {
+        order[c] = keys[c].second;
+    }
+    return order;
+}
+
+
+std::vector<int> GridRenumbering::faceOrder(const UnstructuredGrid& grid, const std::vector<int>& cell_old_to_new)
+{
+    // Faces are sorted by the lowest new index among their neighbour cells, then by the
+    // other neighbour, so that the faces of a cell are stored close to each other.
+    // Boundary faces come after the interior faces of the same cell.
+    const int nf = grid.number_of_faces;
+    const int outside = std::numeric_limits<int>::max();
+    std::vector<std::tuple<int, int, int> > keys(nf);
+    for (int f = 0; f < nf; ++f) {
+        const int c0 = grid.face_cells[2*f];
+        const int c1 = grid.face_cells[2*f + 1];
+        const int n0 = c0 >= 0 ? cell_old_to_new[c0] : outside;
+        const int n1 = c1 >= 0 ? cell_old_to_new[c1] : outside;
+        keys[f] = std::make_tuple(std::min(n0, n1), std::max(n0, n1), f);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order(nf);
+    for (int f = 0; f < nf; ++f) {
+        order[f] = std::get<2>(keys[f]);
+    }
+    return order;
+}
+
+
+RenumberedGrid* GridRenumbering::build(const UnstructuredGrid& grid, const Method method)
+{
+    std::unique_ptr<RenumberedGrid> rg(new RenumberedGrid);
+
+    switch (method) {
+    case ReverseCuthillMcKee:
+        rg->cell_new_to_old = cellOrderRCM(grid);
+        break;
+    case SpaceFillingCurve:
+        rg->cell_new_to_old = cellOrderSFC(grid);
+        break;
+    default:
+        OPM_THROW(std::logic_error, "GridRenumbering::build() called without a renumbering method.");
+    }
+    rg->cell_old_to_new = invert(rg->cell_new_to_old);
+    rg->face_new_to_old = faceOrder(grid, rg->cell_old_to_new);
+    rg->face_old_to_new = invert(rg->face_new_to_old);
+
+    const int dim = grid.dimensions;
+    const int nc = grid.number_of_cells;
+    const int nf = grid.number_of_faces;
+    const int nn = grid.number_of_nodes;
+
+    rg->c_grid = allocate_grid(dim, nc, nf, grid.face_nodepos[nf], grid.cell_facepos[nc], nn);
+    if (!rg->c_grid) {
+        OPM_THROW(std::runtime_error, "Could not allocate renumbered grid.");
+    }
+    UnstructuredGrid& g = *rg->c_grid;
+    std::copy(grid.cartdims, grid.cartdims + 3, g.cartdims);
+
+    // Nodes keep their enumeration.
+    std::copy_n(grid.node_coordinates, dim*nn, g.node_coordinates);
+
+    // Faces.
+    const std::vector<int>& fn2o = rg->face_new_to_old;
+    g.face_nodepos[0] = 0;
+    for (int f = 0; f < nf; ++f) {
+        const int old = fn2o[f];
+        const int* beg = grid.face_nodes + grid.face_nodepos[old];
+        const int* end = grid.face_nodes + grid.face_nodepos[old + 1];
+        std::copy(beg, end, g.face_nodes + g.face_nodepos[f]);
+        g.face_nodepos[f + 1] = g.face_nodepos[f] + (end - beg);
+        for (int i = 0; i < 2; ++i) {
+            const int c = grid.face_cells[2*old + i];
+            g.face_cells[2*f + i] = c >= 0 ? rg->cell_old_to_new[c] : c;
+        }
+    }
+    permuteBlocks(grid.face_centroids, g.face_centroids, fn2o, dim);
+    permuteBlocks(grid.face_normals, g.face_normals, fn2o, dim);
+    permuteBlocks(grid.face_areas, g.face_areas, fn2o, 1);
+
+    // Cells.
+    const std::vector<int>& cn2o = rg->cell_new_to_old;
+    const bool has_tags = grid.cell_facetag && g.cell_facetag;
+    g.cell_facepos[0] = 0;
+    for (int c = 0; c < nc; ++c) {
+        const int old = cn2o[c];
+        int pos = g.cell_facepos[c];
+        for (int hf = grid.cell_facepos[old]; hf < grid.cell_facepos[old + 1]; ++hf, ++pos) {
+            g.cell_faces[pos] = rg->face_old_to_new[grid.cell_faces[hf]];
+            if (has_tags) {
+                g.cell_facetag[pos] = grid.cell_facetag[hf];
+            }
+        }
+        g.cell_facepos[c + 1] = pos;
+    }
+    permuteBlocks(grid.cell_centroids, g.cell_centroids, cn2o, dim);
+    permuteBlocks(grid.cell_volumes, g.cell_volumes, cn2o, 1);
+
+    return rg.release();
+}
+
+} // namespace equelle
@@ -0,0 +1,273 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+*/
+
+#include "equelle/StructuredGrid.hpp"
+
+#include <opm/core/grid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace equelle {
+
+StructuredGrid::StructuredGrid()
+    : dimensions(0)
+{
+}
+
+
+namespace {
+
+    /// Relative comparison of grid geometry, which is computed in floating point by the grid builder.
+    bool close(const double a, const double b, const double scale)
+    {
+        return std::fabs(a - b) <= 1e-10 * scale;
+    }
+
+} // anonymous namespace
+
+
+StructuredGrid* StructuredGrid::detect(const UnstructuredGrid& grid)
+{
+    const int dim = grid.dimensions;
+    if (dim != 2 && dim != 3) {
+        return nullptr;
+    }
+    std::unique_ptr<StructuredGrid> sg(new StructuredGrid);
+    sg->dimensions = dim;
+    sg->dims = {{ 1, 1, 1 }};
+    for (int d = 0; d < dim; ++d) {
+        sg->dims[d] = grid.cartdims[d];
+    }
+    if (sg->dims[0] < 1 || sg->dims[1] < 1 || sg->dims[2] < 1 || sg->numCells() != grid.number_of_cells) {
+        return nullptr;
+    }
+    sg->face_start = {{ 0, 0, 0, 0 }};
+    sg->interior_face_start = {{ 0, 0, 0, 0 }};
+    for (int d = 0; d < dim; ++d) {
+        const std::array<int, 3> fd = sg->faceDims(d);
+        sg->face_start[d + 1] = sg->face_start[d] + fd[0]*fd[1]*fd[2];
+        sg->interior_face_start[d + 1] = sg->interior_face_start[d] + fd[0]*fd[1]*fd[2] / fd[d] * (fd[d] - 2);
+    }
+    for (int d = dim + 1; d < 4; ++d) {
+        sg->face_start[d] = sg->face_start[dim];
+        sg->interior_face_start[d] = sg->interior_face_start[dim];
+    }
+    if (sg->numFaces() != grid.number_of_faces) {
+        return nullptr;
+    }
+
+    // The first two faces normal to each direction give the origin and spacing.
+    // Within the faces normal to d, the stride along d is the same as for cells.
+    sg->origin = {{ 0.0, 0.0, 0.0 }};
+    sg->spacing = {{ 1.0, 1.0, 1.0 }};
+    for (int d = 0; d < dim; ++d) {
+        const int f0 = sg->face_start[d];
+        const int f1 = f0 + sg->cellStride(d);
+        sg->origin[d] = grid.face_centroids[dim*f0 + d];
+        sg->spacing[d] = grid.face_centroids[dim*f1 + d] - sg->origin[d];
+        if (!(sg->spacing[d] > 0.0)) {
+            return nullptr;
+        }
+    }
+
+    // Compare all cells and faces with the implicit topology and geometry.
+    double scale = 0.0;
+    for (int d = 0; d < dim; ++d) {
+        scale = std::max(scale, std::fabs(sg->origin[d]) + sg->spacing[d]*sg->dims[d]);
+    }
+    const double volume = sg->cellVolume();
+    double c[3];
+    for (int cell = 0; cell < grid.number_of_cells; ++cell) {
+        if (!close(grid.cell_volumes[cell], volume, volume)) {
+            return nullptr;
+        }
+        sg->cellCentroid(cell, c);
+        for (int d = 0; d < dim; ++d) {
+            if (!close(grid.cell_centroids[dim*cell + d], c[d], scale)) {
+                return nullptr;
+            }
+        }
+    }
+    for (int face = 0; face < grid.number_of_faces; ++face) {
+        if (grid.face_cells[2*face] != sg->firstCell(face) || grid.face_cells[2*face + 1] != sg->secondCell(face)) {
+            return nullptr;
+        }
+        const double area = sg->faceArea(sg->faceDirection(face));
+        if (!close(grid.face_areas[face], area, area)) {
+            return nullptr;
+        }
+        sg->faceCentroid(face, c);
+        for (int d = 0; d < dim; ++d) {
+            if (!close(grid.face_centroids[dim*face + d], c[d], scale)) {
+                return nullptr;
+            }
+        }
+    }
+    return sg.release();
+}
+
+
+std::array<int, 3> StructuredGrid::faceDims(const int d) const
+{
+    std::array<int, 3> fd = dims;
+    fd[d] += 1;
+    return fd;
+}
+
+
+int StructuredGrid::faceDirection(const int face) const
+{
+    int d = 0;
+    while (face >= face_start[d + 1]) {
+        ++d;
+    }
+    return d;
+}
+
+
+int StructuredGrid::faceIndices(const int face, int& i, int& j, int& k) const
+{
+    const int d = faceDirection(face);
+    const std::array<int, 3> fd = faceDims(d);
+    const int local = face - face_start[d];
+    i = local % fd[0];
+    j = (local / fd[0]) % fd[1];
+    k = local / (fd[0]*fd[1]);
+    return d;
+}
+
+
+int StructuredGrid::firstCell(const int face) const
+{
+    int ijk[3];
+    const int d = faceIndices(face, ijk[0], ijk[1], ijk[2]);
+    if (ijk[d] == 0) {
+        return -1;
+    }
+    ijk[d] -= 1;
+    return (ijk[2]*dims[1] + ijk[1])*dims[0] + ijk[0];
+}
+
+
+int StructuredGrid::secondCell(const int face) const
+{
+    int ijk[3];
+    const int d = faceIndices(face, ijk[0], ijk[1], ijk[2]);
+    if (ijk[d] == dims[d]) {
+        return -1;
+    }
+    return (ijk[2]*dims[1] + ijk[1])*dims[0] + ijk[0];
+}
+
+
+double StructuredGrid::faceArea(const int d) const
+{
+    double area = 1.0;
+    for (int e = 0; e < dimensions; ++e) {
+        if (e != d) {
+            area *= spacing[e];
+        }
+    }
+    return area;
+}
+
+
+double StructuredGrid::cellVolume() const
+{
+    double volume = 1.0;
+    for (int d = 0; d < dimensions; ++d) {
+        volume *= spacing[d];
+    }
+    return volume;
+}
+
+
+void StructuredGrid::cellCentroid(const int cell, double* c) const
+{
+    const int ijk[3] = { cell % dims[0], (cell / dims[0]) % dims[1], cell / (dims[0]*dims[1]) };
+    for (int d = 0; d < dimensions; ++d) {
+        c[d] = origin[d] + (ijk[d] + 0.5)*spacing[d];
+    }
+}
+
+
+void StructuredGrid::faceCentroid(const int face, double* c) const
+{
+    int ijk[3];
+    const int n = faceIndices(face, ijk[0], ijk[1], ijk[2]);
+    for (int d = 0; d < dimensions; ++d) {
+        c[d] = origin[d] + (ijk[d] + (d == n ? 0.0 : 0.5))*spacing[d];
+    }
+}
+
+
+void StructuredGrid::gradient(const double* u, double* grad) const
+{
+    // Interior faces normal to d, in face order: all (i, j, k) with 1 <= index d < dims[d].
+    for (int d = 0; d < dimensions; ++d) {
+        const int stride = cellStride(d);
+        double* out = grad + interior_face_start[d];
+        for (int k = (d == 2 ? 1 : 0); k < dims[2]; ++k) {
+            for (int j = (d == 1 ? 1 : 0); j < dims[1]; ++j) {
+                const double* row = u + (k*dims[1] + j)*dims[0];
+                const int i_begin = d == 0 ? 1 : 0;
+                for (int i = i_begin; i < dims[0]; ++i) {
+                    *out++ = row[i] - row[i - stride];
+                }
+            }
+        }
+    }
+}
+
+
+void StructuredGrid::divergence(const double* flux, double* div) const
+{
+    std::fill(div, div + numCells(), 0.0);
+    for (int d = 0; d < dimensions; ++d) {
+        const std::array<int, 3> fd = faceDims(d);
+        const int stride = cellStride(d);
+        const double* in = flux + face_start[d];
+        for (int k = 0; k < fd[2]; ++k) {
+            for (int j = 0; j < fd[1]; ++j) {
+                for (int i = 0; i < fd[0]; ++i) {
+                    const int ijk[3] = { i, j, k };
+                    // The face lies on the negative side of cell (i, j, k) and the positive side of its lower neighbour.
+                    const int cell = (k*dims[1] + j)*dims[0] + i;
+                    const double f = *in++;
+                    if (ijk[d] > 0) {
+                        div[cell - stride] += f;
+                    }
+                    if (ijk[d] < dims[d]) {
+                        div[cell] -= f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void StructuredGrid::interiorDivergence(const double* flux, double* div) const
+{
+    std::fill(div, div + numCells(), 0.0);
+    for (int d = 0; d < dimensions; ++d) {
+        const int stride = cellStride(d);
+        const double* in = flux + interior_face_start[d];
+        for (int k = (d == 2 ? 1 : 0); k < dims[2]; ++k) {
+            for (int j = (d == 1 ? 1 : 0); j < dims[1]; ++j) {
+                double* row = div + (k*dims[1] + j)*dims[0];
+                const int i_begin = d == 0 ? 1 : 0;
+                for (int i = i_begin; i < dims[0]; ++i) {
+                    const double f = *in++;
+                    row[i - stride] += f;
+                    row[i] -= f;
+                }
+            }
+        }
+    }
+}
+
+} // namespace equelle
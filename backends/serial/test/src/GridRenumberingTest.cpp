@@ -0,0 +1,150 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE EquelleSerialBackendTest
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opm/core/grid.h>
+#include <opm/core/grid/GridManager.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+
+#include "equelle/EquelleRuntimeCPU.hpp"
+#include "equelle/GridRenumbering.hpp"
+
+using namespace equelle;
+
+namespace {
+
+    void checkIsPermutation( const std::vector<int>& new_to_old, const std::vector<int>& old_to_new, const int size )
+    {
+        BOOST_REQUIRE_EQUAL( new_to_old.size(), size );
+        BOOST_REQUIRE_EQUAL( old_to_new.size(), size );
+        std::vector<int> sorted( new_to_old );
+        std::sort( sorted.begin(), sorted.end() );
+        std::vector<int> identity( size );
+        std::iota( identity.begin(), identity.end(), 0 );
+        BOOST_CHECK( sorted == identity );
+        for ( int i = 0; i < size; ++i ) {
+            BOOST_CHECK_EQUAL( old_to_new[ new_to_old[i] ], i );
+        }
+    }
+
+    /// Every face of a cell has the cell as one of its neighbours, and every face is
+    /// listed by the cells it separates. The faces also separate the same cells as in the original grid.
+    void checkTopology( const UnstructuredGrid& orig, const RenumberedGrid& renumbered )
+    {
+        const UnstructuredGrid& g = *renumbered.c_grid;
+        BOOST_REQUIRE_EQUAL( g.number_of_cells, orig.number_of_cells );
+        BOOST_REQUIRE_EQUAL( g.number_of_faces, orig.number_of_faces );
+
+        std::vector<int> listed( g.number_of_faces, 0 );
+        for ( int c = 0; c < g.number_of_cells; ++c ) {
+            for ( int hf = g.cell_facepos[c]; hf < g.cell_facepos[c + 1]; ++hf ) {
+                const int f = g.cell_faces[hf];
+                BOOST_CHECK( g.face_cells[2*f] == c || g.face_cells[2*f + 1] == c );
+                ++listed[f];
+            }
+        }
+        for ( int f = 0; f < g.number_of_faces; ++f ) {
+            const int num_cells = ( g.face_cells[2*f] >= 0 ) + ( g.face_cells[2*f + 1] >= 0 );
+            BOOST_CHECK_EQUAL( listed[f], num_cells );
+
+            const int of = renumbered.face_new_to_old[f];
+            for ( int side = 0; side < 2; ++side ) {
+                const int oc = orig.face_cells[2*of + side];
+                BOOST_CHECK_EQUAL( g.face_cells[2*f + side], oc < 0 ? oc : renumbered.cell_old_to_new[oc] );
+            }
+            BOOST_CHECK_EQUAL( g.face_areas[f], orig.face_areas[of] );
+        }
+    }
+
+    template <class T>
+    std::vector<T> readFile( const std::string& filename )
+    {
+        std::ifstream is( filename.c_str() );
+        BOOST_REQUIRE( is );
+        return std::vector<T>( std::istream_iterator<T>( is ), std::istream_iterator<T>() );
+    }
+
+    template <class T>
+    void writeFile( const std::string& filename, const std::vector<T>& data )
+    {
+        std::ofstream os( filename.c_str() );
+        os.precision( 16 );
+        std::copy( data.begin(), data.end(), std::ostream_iterator<T>( os, "\n" ) );
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE( renumberingIsConsistent ) {
+    const Opm::GridManager grid2d( 7, 5 );
+    const Opm::GridManager grid3d( 4, 3, 3 );
+    for ( const Opm::GridManager* gm : { &grid2d, &grid3d } ) {
+        const UnstructuredGrid& orig = *gm->c_grid();
+        for ( const auto method : { GridRenumbering::ReverseCuthillMcKee, GridRenumbering::SpaceFillingCurve } ) {
+            std::unique_ptr<RenumberedGrid> renumbered( GridRenumbering::build( orig, method ) );
+            checkIsPermutation( renumbered->cell_new_to_old, renumbered->cell_old_to_new, orig.number_of_cells );
+            checkIsPermutation( renumbered->face_new_to_old, renumbered->face_old_to_new, orig.number_of_faces );
+            checkTopology( orig, *renumbered );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( cellOrdersArePermutations ) {
+    const Opm::GridManager gm( 6, 6 );
+    const UnstructuredGrid& grid = *gm.c_grid();
+    std::vector<int> identity( grid.number_of_cells );
+    std::iota( identity.begin(), identity.end(), 0 );
+    for ( std::vector<int> order : { GridRenumbering::cellOrderRCM( grid ), GridRenumbering::cellOrderSFC( grid ) } ) {
+        std::sort( order.begin(), order.end() );
+        BOOST_CHECK( order == identity );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( outputRestoresInputOrder ) {
+    Opm::parameter::ParameterGroup param;
+    param.disableOutput();
+    param.insertParameter( "nx", "7" );
+    param.insertParameter( "ny", "5" );
+    param.insertParameter( "grid_renumbering", "rcm" );
+    param.insertParameter( "output_to_file", "true" );
+
+    // A value per cell, and the boundary faces on the south side (the first y-faces) with a value each.
+    std::vector<double> cell_values( 7*5 );
+    for ( size_t i = 0; i < cell_values.size(); ++i ) {
+        cell_values[i] = 0.5 + i;
+    }
+    const int first_y_face = 8*5;
+    std::vector<int> south_faces( 7 );
+    std::iota( south_faces.begin(), south_faces.end(), first_y_face );
+    const std::vector<double> face_values = { 3.0, 1.0, 4.0, 1.5, 9.0, 2.5, 6.0 };
+    writeFile( "renumbering_cells.mockdata", cell_values );
+    writeFile( "renumbering_south.mockdata", south_faces );
+    writeFile( "renumbering_south_values.mockdata", face_values );
+    param.insertParameter( "u_from_file", "true" );
+    param.insertParameter( "u_filename", "renumbering_cells.mockdata" );
+    param.insertParameter( "south_filename", "renumbering_south.mockdata" );
+    param.insertParameter( "b_from_file", "true" );
+    param.insertParameter( "b_filename", "renumbering_south_values.mockdata" );
+
+    EquelleRuntimeCPU er( param );
+    const CollOfScalar u = er.inputCollectionOfScalar( "u", er.allCells() );
+    const CollOfFace south = er.inputDomainSubsetOf( "south", er.boundaryFaces() );
+    const CollOfScalar b = er.inputCollectionOfScalar( "b", south );
+
+    er.output( "renumbering_u", u, er.allCells() );
+    er.output( "renumbering_b", b, south );
+
+    BOOST_CHECK( readFile<double>( "renumbering_u-00000.output" ) == cell_values );
+    BOOST_CHECK( readFile<double>( "renumbering_b-00000.output" ) == face_values );
+
+    // Without the domain, the order of the input grid cannot be restored.
+    BOOST_CHECK_THROW( er.output( "renumbering_u", u ), std::logic_error );
+}
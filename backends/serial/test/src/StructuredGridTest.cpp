@@ -0,0 +1,175 @@
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <opm/core/grid.h>
+#include <opm/core/grid/GridManager.hpp>
+#include <opm/core/grid/cart_grid.h>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+
+#include "equelle/EquelleRuntimeCPU.hpp"
+#include "equelle/GridRenumbering.hpp"
+#include "equelle/StructuredGrid.hpp"
+
+using namespace equelle;
+
+namespace {
+
+    /// Parameters for a box of cells of unequal size in each direction, with nz = 0 for 2D.
+    Opm::parameter::ParameterGroup boxParameters( const int nx, const int ny, const int nz, const bool fast_path )
+    {
+        Opm::parameter::ParameterGroup param;
+        param.disableOutput();
+        param.insertParameter( "grid_dim", nz > 0 ? "3" : "2" );
+        param.insertParameter( "nx", std::to_string( nx ) );
+        param.insertParameter( "ny", std::to_string( ny ) );
+        param.insertParameter( "dx", "0.5" );
+        param.insertParameter( "dy", "2.0" );
+        if ( nz > 0 ) {
+            param.insertParameter( "nz", std::to_string( nz ) );
+            param.insertParameter( "dz", "1.5" );
+        }
+        param.insertParameter( "structured_fast_path", fast_path ? "true" : "false" );
+        return param;
+    }
+
+    template <class EntityCollection>
+    void checkSameEntities( const EntityCollection& fast, const EntityCollection& slow )
+    {
+        BOOST_REQUIRE_EQUAL( fast.size(), slow.size() );
+        for ( size_t i = 0; i < slow.size(); ++i ) {
+            BOOST_CHECK_EQUAL( fast[i].index, slow[i].index );
+        }
+    }
+
+    void checkSame( const CollOfScalar& fast, const CollOfScalar& slow )
+    {
+        BOOST_REQUIRE_EQUAL( fast.size(), slow.size() );
+        for ( int i = 0; i < slow.size(); ++i ) {
+            BOOST_CHECK_SMALL( fast.value()[i] - slow.value()[i], 1e-10 );
+        }
+        BOOST_REQUIRE_EQUAL( fast.derivative().size(), slow.derivative().size() );
+        for ( size_t block = 0; block < slow.derivative().size(); ++block ) {
+            const Eigen::MatrixXd a( fast.derivative()[block] );
+            const Eigen::MatrixXd b( slow.derivative()[block] );
+            BOOST_REQUIRE_EQUAL( a.rows(), b.rows() );
+            BOOST_REQUIRE_EQUAL( a.cols(), b.cols() );
+            BOOST_CHECK_SMALL( ( a - b ).cwiseAbs().maxCoeff(), 1e-12 );
+        }
+    }
+
+    void checkSame( const CollOfVector& fast, const CollOfVector& slow )
+    {
+        BOOST_REQUIRE_EQUAL( fast.numCols(), slow.numCols() );
+        for ( int d = 0; d < slow.numCols(); ++d ) {
+            checkSame( fast.col( d ), slow.col( d ) );
+        }
+    }
+
+    /// A field of n values, with derivatives with respect to itself if ad is true.
+    CollOfScalar makeField( const int n, const double offset, const bool ad )
+    {
+        CollOfScalar::V values( n );
+        for ( int i = 0; i < n; ++i ) {
+            values[i] = offset + 0.5*i - 0.01*i*i;
+        }
+        if ( ad ) {
+            return CollOfScalar::ADB::variable( 0, values, std::vector<int>{ n } );
+        }
+        return CollOfScalar( values );
+    }
+
+    /// Every operator with a structured fast path gives the same result as the general one.
+    void checkFastPath( const int nx, const int ny, const int nz )
+    {
+        EquelleRuntimeCPU fast( boxParameters( nx, ny, nz, true ) );
+        EquelleRuntimeCPU slow( boxParameters( nx, ny, nz, false ) );
+
+        const CollOfCell cells = slow.allCells();
+        const CollOfFace faces = slow.allFaces();
+        const CollOfFace ifaces = slow.interiorFaces();
+        checkSameEntities( fast.allCells(), cells );
+        checkSameEntities( fast.allFaces(), faces );
+        checkSameEntities( fast.interiorFaces(), ifaces );
+
+        for ( const CollOfFace* fs : { &faces, &ifaces } ) {
+            checkSameEntities( fast.firstCell( *fs ), slow.firstCell( *fs ) );
+            checkSameEntities( fast.secondCell( *fs ), slow.secondCell( *fs ) );
+            checkSame( fast.norm( *fs ), slow.norm( *fs ) );
+            checkSame( fast.centroid( *fs ), slow.centroid( *fs ) );
+            checkSame( fast.normal( *fs ), slow.normal( *fs ) );
+        }
+        checkSame( fast.norm( cells ), slow.norm( cells ) );
+        checkSame( fast.centroid( cells ), slow.centroid( cells ) );
+
+        for ( const bool ad : { false, true } ) {
+            const CollOfScalar u = makeField( cells.size(), 1.0, ad );
+            const CollOfScalar flux = makeField( faces.size(), -2.0, ad );
+            const CollOfScalar iflux = makeField( ifaces.size(), 3.0, ad );
+            checkSame( fast.gradient( u ), slow.gradient( u ) );
+            checkSame( fast.negGradient( u ), slow.negGradient( u ) );
+            checkSame( fast.divergence( flux ), slow.divergence( flux ) );
+            checkSame( fast.divergence( iflux ), slow.divergence( iflux ) );
+            checkSame( fast.interiorDivergence( iflux ), slow.interiorDivergence( iflux ) );
+        }
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE( structuredFastPathMatchesGeneral ) {
+    checkFastPath( 7, 5, 0 );
+    checkFastPath( 6, 1, 0 );
+    checkFastPath( 4, 3, 2 );
+}
+
+BOOST_AUTO_TEST_CASE( detectAcceptsBoxes ) {
+    const Opm::GridManager grid2d( 7, 5, 0.5, 2.0 );
+    const Opm::GridManager grid3d( 4, 3, 2, 0.5, 2.0, 1.5 );
+    for ( const Opm::GridManager* gm : { &grid2d, &grid3d } ) {
+        const UnstructuredGrid& grid = *gm->c_grid();
+        std::unique_ptr<StructuredGrid> sg( StructuredGrid::detect( grid ) );
+        BOOST_REQUIRE( sg );
+        BOOST_CHECK_EQUAL( sg->dimensions, grid.dimensions );
+        BOOST_CHECK_EQUAL( sg->numCells(), grid.number_of_cells );
+        BOOST_CHECK_EQUAL( sg->numFaces(), grid.number_of_faces );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( detectRejectsRenumberedGrids ) {
+    const Opm::GridManager grid2d( 7, 5 );
+    const Opm::GridManager grid3d( 4, 3, 3 );
+    for ( const Opm::GridManager* gm : { &grid2d, &grid3d } ) {
+        const UnstructuredGrid& orig = *gm->c_grid();
+        for ( const auto method : { GridRenumbering::ReverseCuthillMcKee, GridRenumbering::SpaceFillingCurve } ) {
+            std::unique_ptr<RenumberedGrid> renumbered( GridRenumbering::build( orig, method ) );
+            std::vector<int> identity( orig.number_of_cells );
+            std::iota( identity.begin(), identity.end(), 0 );
+            BOOST_REQUIRE( renumbered->cell_new_to_old != identity );
+            std::unique_ptr<StructuredGrid> sg( StructuredGrid::detect( *renumbered->c_grid ) );
+            BOOST_CHECK( !sg );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( detectRejectsNonUniformGrids ) {
+    // A tensor grid with the same topology as a box, but cells of unequal width.
+    const double x[] = { 0.0, 1.0, 2.0, 3.5, 4.0 };
+    const double y[] = { 0.0, 1.0, 2.0, 3.0 };
+    UnstructuredGrid* grid = create_grid_tensor2d( 4, 3, x, y );
+    BOOST_REQUIRE( grid );
+    std::unique_ptr<StructuredGrid> sg( StructuredGrid::detect( *grid ) );
+    BOOST_CHECK( !sg );
+    destroy_grid( grid );
+
+    // A uniform tensor grid is a box, so the comparison above is not vacuous.
+    const double xu[] = { 0.0, 1.0, 2.0, 3.0, 4.0 };
+    grid = create_grid_tensor2d( 4, 3, xu, y );
+    BOOST_REQUIRE( grid );
+    sg.reset( StructuredGrid::detect( *grid ) );
+    BOOST_CHECK( sg );
+    destroy_grid( grid );
+}
@@ -0,0 +1,100 @@
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "equelle/equelleTypes.hpp"
+
+using namespace equelle;
+
+namespace {
+
+    const int n = 5;
+
+    /// Two primary variables of n values each.
+    std::vector<CollOfScalar> primaryVariables()
+    {
+        const std::vector<int> blocks = { n, n };
+        CollOfScalar::V p( n );
+        CollOfScalar::V s( n );
+        for ( int i = 0; i < n; ++i ) {
+            p[i] = 1.0 + 0.5*i;
+            s[i] = 0.25 - 0.1*i;
+        }
+        return { CollOfScalar::ADB::variable( 0, p, blocks ), CollOfScalar::ADB::variable( 1, s, blocks ) };
+    }
+
+    /// A vector collection whose components depend on the primary variables,
+    /// except for the last one, which is constant. With no variables, all are constant.
+    CollOfVector makeVectors( const int dim, const std::vector<CollOfScalar>& vars, const double shift )
+    {
+        CollOfVector v( dim );
+        for ( int d = 0; d < dim; ++d ) {
+            CollOfScalar::V x( n );
+            for ( int i = 0; i < n; ++i ) {
+                x[i] = shift + d - 0.3*i;
+            }
+            v.col( d ) = CollOfScalar( x );
+            if ( !vars.empty() && d < dim - 1 ) {
+                v.col( d ) = v.col( d ) * vars[d % vars.size()];
+            }
+        }
+        return v;
+    }
+
+    /// The dot product and norm as composed from AutoDiffBlock operations.
+    CollOfScalar dotAutoDiff( const CollOfVector& v1, const CollOfVector& v2 )
+    {
+        CollOfScalar result = v1.col( 0 ) * v2.col( 0 );
+        for ( int d = 1; d < v1.numCols(); ++d ) {
+            result += v1.col( d ) * v2.col( d );
+        }
+        return result;
+    }
+
+    CollOfScalar normAutoDiff( const CollOfVector& v )
+    {
+        return sqrt( dotAutoDiff( v, v ) );
+    }
+
+    void checkSame( const CollOfScalar& fused, const CollOfScalar& expected )
+    {
+        BOOST_REQUIRE_EQUAL( fused.size(), expected.size() );
+        for ( int i = 0; i < expected.size(); ++i ) {
+            BOOST_CHECK_CLOSE( fused.value()[i], expected.value()[i], 1e-10 );
+        }
+        BOOST_REQUIRE_EQUAL( fused.derivative().size(), expected.derivative().size() );
+        for ( size_t block = 0; block < expected.derivative().size(); ++block ) {
+            const Eigen::MatrixXd a( fused.derivative()[block] );
+            const Eigen::MatrixXd b( expected.derivative()[block] );
+            BOOST_REQUIRE_EQUAL( a.rows(), b.rows() );
+            BOOST_REQUIRE_EQUAL( a.cols(), b.cols() );
+            BOOST_CHECK_SMALL( ( a - b ).cwiseAbs().maxCoeff(), 1e-12 );
+        }
+    }
+
+    template <int Dim>
+    void checkKernels()
+    {
+        const std::vector<CollOfScalar> vars = primaryVariables();
+        const std::vector<CollOfScalar> none;
+        const CollOfVector ad1 = makeVectors( Dim, vars, 1.0 );
+        const CollOfVector ad2 = makeVectors( Dim, { vars[1], vars[0] }, 2.5 );
+        const CollOfVector constant = makeVectors( Dim, none, -1.5 );
+
+        checkSame( VectorKernels::dot<Dim>( ad1, ad2 ), dotAutoDiff( ad1, ad2 ) );
+        checkSame( VectorKernels::dot<Dim>( ad1, constant ), dotAutoDiff( ad1, constant ) );
+        checkSame( VectorKernels::dot<Dim>( constant, ad2 ), dotAutoDiff( constant, ad2 ) );
+        checkSame( VectorKernels::dot<Dim>( constant, constant ), dotAutoDiff( constant, constant ) );
+
+        checkSame( VectorKernels::norm<Dim>( ad1 ), normAutoDiff( ad1 ) );
+        checkSame( VectorKernels::norm<Dim>( constant ), normAutoDiff( constant ) );
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE( vectorKernelsMatchAutoDiff ) {
+    checkKernels<2>();
+    checkKernels<3>();
+}
@@ -73,7 +73,7 @@ public:
         }
         visitor.postVisit(*this);
     }
-    const std::vector<Node*>& nodes() {
+    const std::vector<Node*>& nodes() const {
         return nodes_;
     }
 private:
@@ -315,6 +315,39 @@ private:
 
 
 
+class StencilTypeNode : public TypeNode
+{
+public:
+    explicit StencilTypeNode(TypeNode* btype)
+        : TypeNode(EquelleType()),
+          btype_(btype)
+    {
+    }
+    ~StencilTypeNode()
+    {
+        delete btype_;
+    }
+    const TypeNode* baseType() const
+    {
+        return btype_;
+    }
+    EquelleType type() const
+    {
+        EquelleType bt = btype_->type();
+        bt.setStencil(true);
+        return bt;
+    }
+    virtual void accept(ASTVisitorInterface& visitor)
+    {
+        visitor.visit(*this);
+    }
+
+private:
+    TypeNode* btype_;
+};
+
+
+
 enum BinaryOp { Add, Subtract, Multiply, Divide };
 
 
@@ -564,6 +597,14 @@ public:
     {
         return EquelleType(left_->type().basicType(), Collection, right_->type().gridMapping(), left_->type().subsetOf());
     }
+    const ExpressionNode* left() const
+    {
+        return left_;
+    }
+    const ExpressionNode* right() const
+    {
+        return right_;
+    }
     EquelleType leftType() const
     {
         return left_->type();
@@ -1019,6 +1060,10 @@ public:
     {
         return expr_->arrayDimension();
     }
+    const ExpressionNode* expression() const
+    {
+        return expr_;
+    }
     virtual void accept(ASTVisitorInterface& visitor)
     {
         visitor.visit(*this);
@@ -1065,6 +1110,14 @@ public:
     {
         return funcargs_;
     }
+    /// Hands the arguments over to the caller, when the start
+    /// turns out to be a stencil assignment u(i, j) = ...
+    FuncArgsNode* releaseArgs()
+    {
+        FuncArgsNode* args = funcargs_;
+        funcargs_ = nullptr;
+        return args;
+    }
     EquelleType type() const
     {
         return EquelleType();
@@ -1291,6 +1344,11 @@ public:
         return func_call_->type();
     }
 
+    const FuncCallNode* funcCall() const
+    {
+        return func_call_;
+    }
+
     virtual void accept(ASTVisitorInterface& visitor)
     {
         visitor.visit(*this);
@@ -1339,6 +1397,10 @@ public:
     {
         loop_block_ = loop_block;
     }
+    SequenceNode* block() const
+    {
+        return loop_block_;
+    }
     virtual void accept(ASTVisitorInterface& visitor)
     {
         visitor.visit(*this);
@@ -1365,7 +1427,7 @@ public:
     {
         delete expr_list_;
     }
-    const FuncArgsNode* expressionList()
+    const FuncArgsNode* expressionList() const
     {
         return expr_list_;
     }
@@ -1487,6 +1549,14 @@ public:
     const std::string& name() const {
         return lhs_->name();
     }
+
+    const StencilNode* lhs() const {
+        return lhs_;
+    }
+
+    const ExpressionNode* rhs() const {
+        return rhs_;
+    }
 private:
     StencilNode* lhs_;
     ExpressionNode* rhs_;
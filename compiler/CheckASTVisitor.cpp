@@ -5,16 +5,21 @@
 #include "CheckASTVisitor.hpp"
 #include "ASTNodes.hpp"
 #include "SymbolTable.hpp"
+#include "Common.hpp"
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
 
 
 CheckASTVisitor::CheckASTVisitor(const bool ignore_dimension)
     : checking_suppression_level_(0),
       next_loop_index_(0),
       ignore_dimension_(ignore_dimension),
-      valid_(true)
+      valid_(true),
+      stencil_width_(0),
+      stencil_lhs_(nullptr)
 {
 }
 
@@ -27,6 +32,11 @@ bool CheckASTVisitor::isValid()
 	return valid_;
 }
 
+int CheckASTVisitor::stencilWidth() const
+{
+    return stencil_width_;
+}
+
 
 void CheckASTVisitor::visit(SequenceNode&)
 {
@@ -798,6 +808,14 @@ void CheckASTVisitor::postVisit(FuncCallNode& node)
             return;
         }
     }
+    // Boundary conditions are applied in place, so they need a mutable variable.
+    if (node.name() == "ApplyCartesianBoundaryConditions") {
+        const VarNode* var = dynamic_cast<const VarNode*>(node.args()->arguments()[0]);
+        if (!var || !SymbolTable::variableType(var->name()).isMutable()) {
+            error("the first argument to ApplyCartesianBoundaryConditions must be a Mutable variable.", node.location());
+            return;
+        }
+    }
     // Special treatment for function templates.
     if (f.isTemplate()) {
         // All the arguments types will be defaulted, so checking in
@@ -1023,8 +1041,9 @@ void CheckASTVisitor::postVisit(RandomAccessNode& node)
     }
 }
 
-void CheckASTVisitor::visit(StencilAssignmentNode&)
+void CheckASTVisitor::visit(StencilAssignmentNode& node)
 {
+    stencil_lhs_ = node.lhs();
 }
 
 void CheckASTVisitor::midVisit(StencilAssignmentNode&)
@@ -1033,10 +1052,64 @@ void CheckASTVisitor::midVisit(StencilAssignmentNode&)
 
 void CheckASTVisitor::postVisit(StencilAssignmentNode&)
 {
+    stencil_lhs_ = nullptr;
 }
 
-void CheckASTVisitor::visit(StencilNode&)
+void CheckASTVisitor::visit(StencilNode& node)
 {
+    if (isCheckingSuppressed()) {
+        return;
+    }
+    // Collections on faces are accessed with exactly one half index, e.g. flux(i+0.5, j),
+    // while collections on cells only take whole indices.
+    const bool on_faces = isStencilOnFaces(SymbolTable::variableType(node.name()));
+    int half_indices = 0;
+    for (const ExpressionNode* arg : node.args()->arguments()) {
+        bool has_index = false;
+        double offset = 0.0;
+        if (stencilIndexOffset(arg, has_index, offset) && offset != std::floor(offset)) {
+            ++half_indices;
+            if (offset + 0.5 != std::floor(offset + 0.5)) {
+                error("stencil offsets must be whole or half numbers.", node.location());
+            }
+        }
+    }
+    if (on_faces && half_indices != 1) {
+        error("a Stencil Collection On faces must be accessed with exactly one half index, such as "
+              + node.name() + "(i+0.5, j).", node.location());
+    } else if (!on_faces && half_indices > 0) {
+        error("half indices can only be used for a Stencil Collection On faces.", node.location());
+    }
+    if (stencil_width_ < 0) {
+        return;
+    }
+    // Record the widest reach outside the grid, which decides how many ghost cells the runtime must allocate.
+    for (const ExpressionNode* arg : node.args()->arguments()) {
+        bool has_index = false;
+        double offset = 0.0;
+        if (!stencilIndexOffset(arg, has_index, offset) || !has_index) {
+            error("stencil indices must be a stencil index plus or minus a constant, such as "
+                  + node.name() + "(i+1, j), so that the number of ghost cells can be determined.",
+                  node.location());
+            stencil_width_ = -1;
+            return;
+        }
+    }
+    // A cell assignment runs over cells 0 to n-1 in each direction. An assignment to the faces
+    // normal to direction D of cell (i+s, j) runs over faces 0 to n along D, i.e. i from -s to n-s,
+    // and i from -s to n-1-s along the other directions. A face access is valid from 0 to n
+    // along its normal direction F, and a cell access from 0 to n-1.
+    std::vector<int> lhs_offsets;
+    const bool faces_lhs = stencil_lhs_ && isStencilOnFaces(SymbolTable::variableType(stencil_lhs_->name()));
+    const int lhs_direction = faces_lhs ? faceStencilOffsets(*stencil_lhs_, lhs_offsets) : -1;
+    std::vector<int> offsets;
+    const int direction = faceStencilOffsets(node, offsets);
+    for (int d = 0; d < int(offsets.size()); ++d) {
+        const int shift = d < int(lhs_offsets.size()) ? lhs_offsets[d] : 0;
+        const int below = shift - offsets[d];
+        const int above = offsets[d] - shift + (d == lhs_direction ? 1 : 0) - (d == direction ? 1 : 0);
+        stencil_width_ = std::max(stencil_width_, std::max(below, above));
+    }
 }
 
 void CheckASTVisitor::postVisit(StencilNode&)
@@ -92,11 +92,20 @@ public:
 
     bool isValid();
 
+    /// The number of ghost cells that the stencil accesses reach outside the grid, such as 2 for
+    /// u(i-2, j). Assignments to faces run over one face more than there are cells, shifted so
+    /// that the face written is face 0 at the start, which is taken into account.
+    /// Returns 0 if there are no stencil accesses, and -1 if an offset could not be determined
+    /// at compile time, which is reported as a compile error.
+    int stencilWidth() const;
+
 private:
     int checking_suppression_level_;
     int next_loop_index_;
     bool ignore_dimension_;
     bool valid_;
+    int stencil_width_;
+    const StencilNode* stencil_lhs_; // Written by the stencil assignment being checked.
     std::stack<std::string> undecl_func_stack;
     std::map<std::string, FuncAssignNode*> functemplates_;
     EquelleType instantiation_return_type_;
@@ -27,6 +27,7 @@ public:
             ("input,i", boost::program_options::value<std::string>()->required(), "Input Equelle file to compile")
             ("backend", boost::program_options::value<std::string>()->default_value("cpu"), "Backend of compiler to use (io, ast, ast_equelle, cpu*, cuda, mrst)")
             ("nondimensional", "Disable dimension checking")
+            ("cartesian", "Generate code for the cartesian stencil runtime (cpu backend only)")
             ("dump", boost::program_options::value<std::string>()->default_value("none"), "Dump compiler internals (symboltable, io)");
     }
 
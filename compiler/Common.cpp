@@ -3,7 +3,10 @@
 */
 
 #include "Common.hpp"
+#include "ASTNodes.hpp"
+#include "SymbolTable.hpp"
 
+#include <cmath>
 #include <string>
 #include <sstream>
 
@@ -32,3 +35,64 @@ int intFromString(const std::string& s)
     return num;
 }
 
+
+// ------ Utilities used by the AST visitors ------ 
+
+bool stencilIndexOffset(const ExpressionNode* expr, bool& has_index, double& offset)
+{
+    const BasicType bt = expr->type().basicType();
+    if (dynamic_cast<const VarNode*>(expr)
+        && (bt == StencilI || bt == StencilJ || bt == StencilK)) {
+        if (has_index) {
+            return false;
+        }
+        has_index = true;
+        return true;
+    }
+    if (const QuantityNode* q = dynamic_cast<const QuantityNode*>(expr)) {
+        offset += q->number();
+        return true;
+    }
+    if (const BinaryOpNode* b = dynamic_cast<const BinaryOpNode*>(expr)) {
+        if (b->op() == Add) {
+            return stencilIndexOffset(b->left(), has_index, offset)
+                && stencilIndexOffset(b->right(), has_index, offset);
+        }
+        if (b->op() == Subtract) {
+            bool right_has_index = false;
+            double right_offset = 0.0;
+            if (!stencilIndexOffset(b->left(), has_index, offset)
+                || !stencilIndexOffset(b->right(), right_has_index, right_offset)
+                || right_has_index) {
+                return false;
+            }
+            offset -= right_offset;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isStencilOnFaces(const EquelleType& type)
+{
+    return type.isStencil() && type.isCollection() && type.gridMapping() != NotApplicable
+        && SymbolTable::entitySetType(type.gridMapping()) == Face;
+}
+
+int faceStencilOffsets(const StencilNode& node, std::vector<int>& cell_offsets)
+{
+    int direction = -1;
+    cell_offsets.clear();
+    for (const ExpressionNode* arg : node.args()->arguments()) {
+        bool has_index = false;
+        double offset = 0.0;
+        stencilIndexOffset(arg, has_index, offset);
+        if (offset != std::floor(offset)) {
+            direction = cell_offsets.size();
+            // Face i+0.5 is the negative face of cell i+1, face i-0.5 that of cell i.
+            offset += 0.5;
+        }
+        cell_offsets.push_back(std::lround(offset));
+    }
+    return direction;
+}
@@ -6,6 +6,7 @@
 #define COMMON_HEADER_INCLUDED
 
 #include <string>
+#include <vector>
 
 
 // ------ Declarations needed for bison parser ------ 
@@ -19,5 +20,25 @@ extern int yylineno;
 double numFromString(const std::string& s);
 int intFromString(const std::string& s);
 
+// ------ Utilities used by the AST visitors ------ 
+
+class ExpressionNode;
+class EquelleType;
+class StencilNode;
+
+/// Computes the constant offset of a stencil index expression such as (i + 1) or (j - 2).
+/// The expression must be a stencil index plus or minus constants.
+/// Returns false if the offset cannot be determined at compile time.
+bool stencilIndexOffset(const ExpressionNode* expr, bool& has_index, double& offset);
+
+/// Returns true for stencil collections on a set of faces, which are accessed with half indices.
+bool isStencilOnFaces(const EquelleType& type);
+
+/// Splits the indices of a stencil access on faces, such as flux(i+0.5, j-1), into
+/// the index of the cell whose negative face is accessed, relative to (i, j, k), and
+/// the direction normal to that face. Returns the direction, or -1 if none of the
+/// indices is a half index, in which case cell_offsets are the offsets of a cell access.
+int faceStencilOffsets(const StencilNode& node, std::vector<int>& cell_offsets);
+
 
 #endif // COMMON_HEADER_INCLUDED
@@ -11,6 +11,29 @@
 #include <iostream>
 #include <typeinfo>
 #include <cmath>
+#include <set>
+
+
+
+namespace
+{
+    /// Names of the variables declared with a Stencil type. The symbol table is
+    /// only built after parsing, so this is how stencil accesses u(i, j) are told
+    /// apart from function calls while parsing.
+    std::set<std::string>& stencilVariables()
+    {
+        static std::set<std::string> names;
+        return names;
+    }
+
+    bool isStencilTypeNode(const TypeNode* type)
+    {
+        if (const MutableTypeNode* mt = dynamic_cast<const MutableTypeNode*>(type)) {
+            type = mt->baseType();
+        }
+        return dynamic_cast<const StencilTypeNode*>(type) != nullptr;
+    }
+}
 
 
 
@@ -104,6 +127,9 @@ ExpressionNode* handleIdentifier(const std::string& name)
 
 VarDeclNode* handleDeclaration(const std::string& name, TypeNode* type)
 {
+    if (isStencilTypeNode(type)) {
+        stencilVariables().insert(name);
+    }
     VarDeclNode* node = new VarDeclNode(name, type);
     node->setLocation(FileLocation(yylineno));
     return node;
@@ -202,11 +228,8 @@ CollectionTypeNode* handleCollection(TypeNode* btype, ExpressionNode* gridmappin
 
 TypeNode* handleStencilCollection(TypeNode* type_expr)
 {
-    EquelleType et = type_expr->type();
-    et.setStencil(true);
-    TypeNode* tn = new TypeNode(et);
+    StencilTypeNode* tn = new StencilTypeNode(type_expr);
     tn->setLocation(type_expr->location());
-    delete type_expr;
     return tn;
 }
 
@@ -261,6 +284,9 @@ FuncCallNode* handleFuncCall(const std::string& name, FuncArgsNode* args)
 
 FuncCallLikeNode* handleFuncCallLike(const std::string& name, FuncArgsNode* args)
 {
+    if (stencilVariables().count(name)) {
+        return handleStencilAccess(name, args);
+    }
     return handleFuncCall(name, args);
 #if 0
     if (SymbolTable::isFunctionDeclared(name)) {
@@ -460,7 +486,13 @@ SequenceNode* handleStencilAssignment(FuncCallLikeNode* lhs, ExpressionNode* rhs
     SequenceNode* retval = new SequenceNode();
     retval->setLocation(FileLocation(yylineno));
 
+    // The left hand side u(i, j) = is parsed as the start of a function definition.
     StencilNode* stencil = dynamic_cast<StencilNode*>(lhs);
+    FuncStartNode* start = dynamic_cast<FuncStartNode*>(lhs);
+    if (start && stencilVariables().count(start->name())) {
+        stencil = handleStencilAccess(start->name(), start->releaseArgs());
+        delete start;
+    }
     if (stencil == nullptr) {
         std::string err_msg = "Internal error: The stencil \"" + lhs->name() + "\" does not appear to be properly defined";
         yyerror(err_msg.c_str());
@@ -5,8 +5,11 @@
 #include "PrintCPUBackendASTVisitor.hpp"
 #include "ASTNodes.hpp"
 #include "SymbolTable.hpp"
+#include "Common.hpp"
 #include <iostream>
+#include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
 
@@ -24,17 +27,19 @@ PrintCPUBackendASTVisitor::PrintCPUBackendASTVisitor()
       sequence_depth_(0),
       instantiating_(false),
       next_funcstart_inst_(-1),
-      use_cartesian_(false)
+      use_cartesian_(false),
+      stencil_width_(-1)
 {
 }
 
-PrintCPUBackendASTVisitor::PrintCPUBackendASTVisitor(const bool use_cartesian)
+PrintCPUBackendASTVisitor::PrintCPUBackendASTVisitor(const bool use_cartesian, const int stencil_width)
     : suppression_level_(0),
       indent_(1),
       sequence_depth_(0),
       instantiating_(false),
       next_funcstart_inst_(-1),
-      use_cartesian_(use_cartesian)
+      use_cartesian_(use_cartesian),
+      stencil_width_(stencil_width)
 {
 }
 
@@ -42,14 +47,19 @@ PrintCPUBackendASTVisitor::~PrintCPUBackendASTVisitor()
 {
 }
 
-void PrintCPUBackendASTVisitor::visit(SequenceNode&)
+void PrintCPUBackendASTVisitor::visit(SequenceNode& node)
 {
     if (sequence_depth_ == 0) {
         // This is the root node of the program.
         std::cout << cppStartString();
         endl();
+        ghost_update_scopes_.assign(1, GhostUpdateScope{ {}, false, false });
+        findBufferSwaps(node);
+        findTemporalLoops(node);
     }
     ++sequence_depth_;
+    findFusableStencils(node);
+    findReductionBatches(node);
 }
 
 void PrintCPUBackendASTVisitor::midVisit(SequenceNode&)
@@ -76,6 +86,22 @@ void PrintCPUBackendASTVisitor::postVisit(SequenceNode&)
         }
         std::cout <<
             "}\n";
+        if (use_cartesian_) {
+            // Emit ensureCartesianRequirements() function.
+            std::cout <<
+                "\n"
+                "void ensureCartesianRequirements(" << namespaceNameString() <<
+                "::CartesianEquelleRuntime& er_cart)\n"
+                "{\n";
+            if (stencil_width_ >= 0) {
+                std::cout << "    er_cart.ensureGhostWidthMin(" << stencil_width_ << ");\n";
+            } else {
+                // Without a width the ghost layer may be too narrow, so the program must not build.
+                std::cout << "#error \"The stencil width could not be determined at compile time.\"\n";
+            }
+            std::cout <<
+                "}\n";
+        }
     }
 }
 
@@ -253,11 +279,25 @@ void PrintCPUBackendASTVisitor::visit(OnNode& node)
         std::cout << "er.operatorExtend(";
     } else {
         std::cout << "er.operatorOn(";
+        if (readsNeighbourCells(node)) {
+            if (const std::string* updated = findGhostUpdate(node)) {
+                // The field itself is not printed, only the variable holding its update.
+                std::cout << *updated;
+                ghost_update_reuses_.insert(&node);
+                suppress();
+            } else {
+                std::cout << ghostUpdateString() << '(';
+            }
+        }
     }
 }
 
 void PrintCPUBackendASTVisitor::midVisit(OnNode& node)
 {
+    const bool reused = ghost_update_reuses_.erase(&node) > 0;
+    if (reused) {
+        unsuppress();
+    }
     if (isSuppressed()) {
         return;
     }
@@ -267,17 +307,12 @@ void PrintCPUBackendASTVisitor::midVisit(OnNode& node)
     // is On. Example:
     // a : Collection Of Scalar On InteriorFaces()
     // a On AllFaces() ===> er.operatorOn(a, InteriorFaces(), AllFaces()).
+    if (!node.isExtend() && readsNeighbourCells(node) && !reused) {
+        std::cout << ')';
+    }
     std::cout << ", ";
     if (node.leftType().isCollection()) {
-        const std::string esname = SymbolTable::entitySetName(node.leftType().gridMapping());
-        // Now esname can be either a user-created named set or an Equelle built-in
-        // function call such as AllCells(). If the second, we must transform to
-        // proper call syntax for the C++ backend.
-        const char first = esname[0];
-        const std::string cppterm = std::isupper(first) ?
-            std::string("er.") + char(std::tolower(first)) + esname.substr(1)
-            : esname;
-        std::cout << cppterm;
+        std::cout << entitySetCppTerm(node.leftType().gridMapping());
         std::cout << ", ";
     }
 }
@@ -334,14 +369,43 @@ void PrintCPUBackendASTVisitor::postVisit(VarDeclNode&)
 
 void PrintCPUBackendASTVisitor::visit(VarAssignNode& node)
 {
+    if (isTemporalLoopSwap(node) || hoisted_statements_.count(&node)) {
+        // Done by the runtime after each time step, or already printed before the time loop.
+        suppress();
+        return;
+    }
     if (isSuppressed()) {
         return;
     }
+    const auto batch = reduction_batch_of_.find(&node);
+    if (batch != reduction_batch_of_.end()) {
+        // The partial reductions are printed as the entries of one call to the runtime.
+        const std::vector<const VarAssignNode*>& members = reduction_batches_[batch->second];
+        if (members.front() == &node) {
+            for (const VarAssignNode* member : members) {
+                printGhostUpdates(member->rhs());
+            }
+            std::cout << indent() << "const std::vector<Scalar> reductions" << batch->second
+                      << " = " << reductionBatchString() << "({";
+            ++indent_;
+            endl();
+        }
+        std::cout << indent();
+        return;
+    }
+    printGhostUpdates(node.rhs());
     std::cout << indent();
     if (node.type() == StencilI || node.type() == StencilJ || node.type() == StencilK) {
         //This goes into the stencil-lambda definition, and is only used during parsing.
         std::cout << "// Note: ";
     }
+    if (buffer_swaps_.count(&node)) {
+        if (defined_mutables_.count(node.name())) {
+            std::cout << node.name() << ".swapAssign(";
+            return;
+        }
+        buffer_swaps_.erase(&node);
+    }
     if (!SymbolTable::variableType(node.name()).isMutable()) {
 #if 0
         std::cout << "const auto ";
@@ -355,11 +419,37 @@ void PrintCPUBackendASTVisitor::visit(VarAssignNode& node)
     std::cout << node.name() << " = ";
 }
 
-void PrintCPUBackendASTVisitor::postVisit(VarAssignNode&)
+void PrintCPUBackendASTVisitor::postVisit(VarAssignNode& node)
 {
+    if (isTemporalLoopSwap(node) || hoisted_statements_.count(&node)) {
+        unsuppress();
+        return;
+    }
     if (isSuppressed()) {
         return;
     }
+    forgetGhostUpdate(node.name());
+    const auto batch = reduction_batch_of_.find(&node);
+    if (batch != reduction_batch_of_.end()) {
+        const std::vector<const VarAssignNode*>& members = reduction_batches_[batch->second];
+        if (members.back() != &node) {
+            std::cout << ',';
+            endl();
+            return;
+        }
+        std::cout << " });";
+        --indent_;
+        endl();
+        for (size_t m = 0; m < members.size(); ++m) {
+            std::cout << indent() << "const " << cppTypeString(members[m]->type()) << " " << members[m]->name()
+                      << " = reductions" << batch->second << "[" << m << "];";
+            endl();
+        }
+        return;
+    }
+    if (buffer_swaps_.count(&node)) {
+        std::cout << ')';
+    }
     std::cout << ';';
     endl();
 }
@@ -447,6 +537,7 @@ void PrintCPUBackendASTVisitor::visit(FuncStartNode& node)
     }
     suppress();
     ++indent_;
+    ghost_update_scopes_.push_back(GhostUpdateScope{ {}, true, false });
 }
 
 void PrintCPUBackendASTVisitor::postVisit(FuncStartNode& node)
@@ -513,6 +604,7 @@ void PrintCPUBackendASTVisitor::postVisit(FuncAssignNode& node)
     --indent_;
     std::cout << indent() << "};";
     endl();
+    ghost_update_scopes_.pop_back();
     SymbolTable::setCurrentFunction(SymbolTable::getCurrentFunction().parentScope());
 }
 
@@ -532,11 +624,12 @@ void PrintCPUBackendASTVisitor::postVisit(FuncArgsNode&)
 {
 }
 
-void PrintCPUBackendASTVisitor::visit(ReturnStatementNode&)
+void PrintCPUBackendASTVisitor::visit(ReturnStatementNode& node)
 {
     if (isSuppressed()) {
         return;
     }
+    printGhostUpdates(node.expression());
     std::cout << indent() << "return ";
 }
 
@@ -559,21 +652,26 @@ void PrintCPUBackendASTVisitor::visit(FuncCallNode& node)
         const char first = fname[0];
         std::string cppname;
         if (std::isupper(first)) {
-#if 0
             bool is_stencil = false;
             is_stencil = is_stencil | node.type().isStencil();
-            const std::vector<EquelleType>& types = node.args()->argumentTypes();
+            const std::vector<EquelleType> types = node.args()->argumentTypes();
             for (int i=0; i<types.size(); ++i) {
                 is_stencil = is_stencil | types[i].isStencil();
             }
-            if (is_stencil) {
+            // Builtins taking or returning stencil collections belong to the cartesian runtime.
+            if (use_cartesian_ && is_stencil) {
                 cppname += std::string("er_cart.");
             }
             else {
                 cppname += std::string("er.");
             }
-#endif
-            cppname += std::string("er.");
+            if (reductionBatchMember(node)) {
+                // MaxReduce becomes partialReduce(equelle::RuntimeMPI::Max, ...
+                cppname += std::string("partialReduce(") + namespaceNameString() + "::" + classNameString()
+                    + "::" + fname.substr(0, fname.find("Reduce")) + ", ";
+                std::cout << cppname;
+                return;
+            }
             cppname += char(std::tolower(first)) + fname.substr(1);
         } else {
             cppname += fname;
@@ -594,19 +692,33 @@ void PrintCPUBackendASTVisitor::visit(FuncCallNode& node)
     }
 }
 
-void PrintCPUBackendASTVisitor::postVisit(FuncCallNode&)
+void PrintCPUBackendASTVisitor::postVisit(FuncCallNode& node)
 {
     if (isSuppressed()) {
         return;
     }
+    const std::string& fname = node.name();
+    const bool is_reduction = fname == "MinReduce" || fname == "MaxReduce"
+        || fname == "SumReduce" || fname == "ProdReduce";
+    if (is_reduction && reductionsTakeDomain()) {
+        const EquelleType argtype = node.args()->argumentTypes().front();
+        std::cout << ", " << entitySetCppTerm(argtype.gridMapping());
+    }
+    if (fname == "Output" && outputTakesDomain()) {
+        const EquelleType argtype = node.args()->argumentTypes().back();
+        if (argtype.isCollection() && !argtype.isStencil()) {
+            std::cout << ", " << entitySetCppTerm(argtype.gridMapping());
+        }
+    }
     std::cout << ')';
 }
 
-void PrintCPUBackendASTVisitor::visit(FuncCallStatementNode&)
+void PrintCPUBackendASTVisitor::visit(FuncCallStatementNode& node)
 {
     if (isSuppressed()) {
         return;
     }
+    printGhostUpdates(node.funcCall());
     std::cout << indent();
 }
 
@@ -625,18 +737,61 @@ void PrintCPUBackendASTVisitor::visit(LoopNode& node)
         return;
     }
     SymbolTable::setCurrentFunction(node.loopName());
+    ghost_update_scopes_.push_back(GhostUpdateScope{ {}, false, true });
     BasicType loopvartype = SymbolTable::variableType(node.loopSet()).basicType();
+    const auto temporal = temporal_loops_.find(&node);
+    if (temporal != temporal_loops_.end()) {
+        const VarAssignNode* swap = temporal->second.swap;
+        const std::string& u = static_cast<const VarNode*>(swap->rhs())->name();
+        const bool is_3d = temporal->second.dimensions == 3;
+        std::cout << indent() << "{ // Start of temporally blocked time loop";
+        ++indent_;
+        endl();
+        printHoistedScalars(node, temporal->second);
+        std::cout << indent() << "auto time_stencil = [&]( int step, StencilCollOfScalar& " << u
+                  << ", const StencilCollOfScalar& " << swap->name()
+                  << (is_3d ? ", int i, int j, int k ) {" : ", int i, int j ) {");
+        ++indent_;
+        endl();
+        if (temporal->second.uses_loop_variable) {
+            std::cout << indent() << "const " << cppTypeString(loopvartype) << "& " << node.loopVariable()
+                      << " = " << node.loopSet() << "[step];";
+            endl();
+        }
+        for (const VarAssignNode* scalar : temporal->second.scalars) {
+            std::cout << indent() << "const " << cppTypeString(scalar->type()) << " " << scalar->name()
+                      << " = " << scalar->name() << "_steps[step];";
+            endl();
+        }
+        return;
+    }
     std::cout << indent() << "for (const " << cppTypeString(loopvartype) << "& "
               << node.loopVariable() << " : " << node.loopSet() << ") {";
     ++indent_;
     endl();
 }
 
-void PrintCPUBackendASTVisitor::postVisit(LoopNode&)
+void PrintCPUBackendASTVisitor::postVisit(LoopNode& node)
 {
     if (isSuppressed()) {
         return;
     }
+    ghost_update_scopes_.pop_back();
+    const auto temporal = temporal_loops_.find(&node);
+    if (temporal != temporal_loops_.end()) {
+        const VarAssignNode* swap = temporal->second.swap;
+        --indent_;
+        std::cout << indent() << "};";
+        endl();
+        std::cout << indent() << "er_cart.executeTimeLoop( " << node.loopSet() << ".size(), "
+                  << static_cast<const VarNode*>(swap->rhs())->name() << ", " << swap->name() << ", time_stencil );";
+        endl();
+        --indent_;
+        std::cout << indent() << "} // End of temporally blocked time loop";
+        endl();
+        SymbolTable::setCurrentFunction(SymbolTable::getCurrentFunction().parentScope());
+        return;
+    }
     --indent_;
     std::cout << indent() << "}";
     endl();
@@ -717,6 +872,201 @@ const char* PrintCPUBackendASTVisitor::namespaceNameString() const
     return "equelle";
 }
 
+const char* PrintCPUBackendASTVisitor::ghostUpdateString() const
+{
+    return "";
+}
+
+bool PrintCPUBackendASTVisitor::reductionsTakeDomain() const
+{
+    return false;
+}
+
+const char* PrintCPUBackendASTVisitor::reductionBatchString() const
+{
+    return "";
+}
+
+bool PrintCPUBackendASTVisitor::outputTakesDomain() const
+{
+    return true;
+}
+
+namespace
+{
+    /// Collects the subexpressions of type T of an expression, outermost first.
+    template <class T>
+    void collectNodes(const Node* expr, std::vector<const T*>& found)
+    {
+        if (const T* t = dynamic_cast<const T*>(expr)) {
+            found.push_back(t);
+        }
+        if (const OnNode* on = dynamic_cast<const OnNode*>(expr)) {
+            collectNodes(on->left(), found);
+            collectNodes(on->right(), found);
+        } else if (const BinaryOpNode* bn = dynamic_cast<const BinaryOpNode*>(expr)) {
+            collectNodes(bn->left(), found);
+            collectNodes(bn->right(), found);
+        } else if (const ComparisonOpNode* cn = dynamic_cast<const ComparisonOpNode*>(expr)) {
+            collectNodes(cn->left(), found);
+            collectNodes(cn->right(), found);
+        } else if (const UnaryNegationNode* un = dynamic_cast<const UnaryNegationNode*>(expr)) {
+            collectNodes(un->negatedExpression(), found);
+        } else if (const NormNode* nn = dynamic_cast<const NormNode*>(expr)) {
+            collectNodes(nn->normedExpression(), found);
+        } else if (const TrinaryIfNode* tn = dynamic_cast<const TrinaryIfNode*>(expr)) {
+            collectNodes(tn->predicate(), found);
+            collectNodes(tn->ifTrue(), found);
+            collectNodes(tn->ifFalse(), found);
+        } else if (const RandomAccessNode* rn = dynamic_cast<const RandomAccessNode*>(expr)) {
+            collectNodes(rn->expressionToAccess(), found);
+        } else if (const ArrayNode* an = dynamic_cast<const ArrayNode*>(expr)) {
+            for (const ExpressionNode* elem : an->expressionList()->arguments()) {
+                collectNodes(elem, found);
+            }
+        } else if (const FuncCallLikeNode* fn = dynamic_cast<const FuncCallLikeNode*>(expr)) {
+            for (const ExpressionNode* arg : fn->args()->arguments()) {
+                collectNodes(arg, found);
+            }
+        }
+    }
+
+    /// True if the expression reads a numeric variable. Geometry such as
+    /// Centroid(AllCells()) is computed for the ghost cells as well.
+    bool readsVariables(const Node* expr)
+    {
+        std::vector<const VarNode*> vars;
+        collectNodes(expr, vars);
+        for (const VarNode* var : vars) {
+            if (SymbolTable::isVariableDeclared(var->name())
+                && !SymbolTable::variableType(var->name()).isEntityCollection()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// A gathered field whose ghost update can be reused: a variable u or an
+    /// element q[0] of an array variable.
+    struct GhostField {
+        std::string variable; // The Equelle variable, u or q.
+        std::string key;      // u or q[0].
+        std::string cpp;      // u or std::get<0>(q).
+        std::string ghosts;   // u_ghosts or q0_ghosts, without the counter.
+    };
+
+    bool findGhostField(const ExpressionNode* expr, GhostField& field)
+    {
+        if (const VarNode* var = dynamic_cast<const VarNode*>(expr)) {
+            field.variable = field.key = field.cpp = var->name();
+            field.ghosts = var->name() + "_ghosts";
+            return true;
+        }
+        const RandomAccessNode* access = dynamic_cast<const RandomAccessNode*>(expr);
+        if (access && access->arrayAccess()) {
+            if (const VarNode* array = dynamic_cast<const VarNode*>(access->expressionToAccess())) {
+                const std::string index = std::to_string(access->index());
+                field.variable = array->name();
+                field.key = array->name() + "[" + index + "]";
+                field.cpp = "std::get<" + index + ">(" + array->name() + ")";
+                field.ghosts = array->name() + index + "_ghosts";
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool PrintCPUBackendASTVisitor::readsNeighbourCells(const OnNode& node) const
+{
+    // Cell values gathered onto faces, as in u On FirstCell(InteriorFaces()),
+    // include the ghost cells across the boundary of the local domain.
+    // Only scalar fields are exchanged by the runtime.
+    return *ghostUpdateString() != '\0'
+        && node.leftType().isCollection()
+        && node.leftType().basicType() == Scalar
+        && node.leftType().gridMapping() == AllCells
+        && node.rightType().basicType() == Cell
+        && SymbolTable::entitySetType(node.rightType().gridMapping()) == Face
+        && readsVariables(node.left());
+}
+
+/// Emits one ghost update for each field that the statement with the expression gathers onto
+/// faces, unless the field has been updated since it was last assigned. The gathers then use
+/// the updated variable, see visit(OnNode&).
+void PrintCPUBackendASTVisitor::printGhostUpdates(const Node* expr)
+{
+    if (*ghostUpdateString() == '\0') {
+        return;
+    }
+    std::vector<const OnNode*> ons;
+    collectNodes(expr, ons);
+    for (const OnNode* on : ons) {
+        GhostField field;
+        if (on->isExtend() || !findGhostField(on->left(), field) || !readsNeighbourCells(*on)
+            || findGhostUpdate(*on)) {
+            continue;
+        }
+        const int count = ++ghost_update_count_[field.ghosts];
+        std::ostringstream updated;
+        updated << field.ghosts;
+        if (count > 1) {
+            updated << count;
+        }
+        std::cout << indent() << "const " << cppTypeString(on->leftType()) << " " << updated.str()
+                  << " = " << ghostUpdateString() << '(' << field.cpp << ");";
+        endl();
+        ghost_update_scopes_.back().updated[field.key] = updated.str();
+    }
+}
+
+/// Returns the variable holding the updated ghost cells of the field gathered by node, if any.
+/// Mutable fields may be assigned later in a loop body, so the updates from outside the loop
+/// are not used for them, and function bodies only see their own updates.
+const std::string* PrintCPUBackendASTVisitor::findGhostUpdate(const OnNode& node) const
+{
+    GhostField field;
+    if (!findGhostField(node.left(), field)) {
+        return nullptr;
+    }
+    const bool is_mutable = SymbolTable::variableType(field.variable).isMutable();
+    for (auto scope = ghost_update_scopes_.rbegin(); scope != ghost_update_scopes_.rend(); ++scope) {
+        const auto it = scope->updated.find(field.key);
+        if (it != scope->updated.end()) {
+            return &it->second;
+        }
+        if (scope->is_function || (scope->is_loop && is_mutable)) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+/// Forgets the updates of a variable and of its array elements.
+void PrintCPUBackendASTVisitor::forgetGhostUpdate(const std::string& variable)
+{
+    for (GhostUpdateScope& scope : ghost_update_scopes_) {
+        scope.updated.erase(variable);
+        const std::string elements = variable + "[";
+        auto it = scope.updated.lower_bound(elements);
+        while (it != scope.updated.end() && it->first.compare(0, elements.size(), elements) == 0) {
+            it = scope.updated.erase(it);
+        }
+    }
+}
+
+std::string PrintCPUBackendASTVisitor::entitySetCppTerm(const int entity_set_index) const
+{
+    const std::string& esname = SymbolTable::entitySetName(entity_set_index);
+    // Now esname can be either a user-created named set or an Equelle built-in
+    // function call such as AllCells(). If the second, we must transform to
+    // proper call syntax for the C++ backend.
+    const char first = esname[0];
+    return std::isupper(first) ?
+        std::string("er.") + char(std::tolower(first)) + esname.substr(1)
+        : esname;
+}
+
 void PrintCPUBackendASTVisitor::endl() const
 {
     std::cout << '\n';
@@ -760,7 +1110,9 @@ std::string PrintCPUBackendASTVisitor::cppTypeString(const EquelleType& et) cons
         cppstring += ">";
         return cppstring;
     }
-    if (et.isStencil()) {
+    if (isStencilOnFaces(et)) {
+        cppstring += "FaceStencil";
+    } else if (et.isStencil()) {
         cppstring += "Stencil";
     }
     if (et.isCollection()) {
@@ -772,6 +1124,405 @@ std::string PrintCPUBackendASTVisitor::cppTypeString(const EquelleType& et) cons
     return cppstring;
 }
 
+namespace
+{
+    /// Collects the names of all variables read by a stencil expression.
+    /// Returns false for expressions we do not know how to analyse.
+    bool collectStencilReads(const Node* expr, std::set<std::string>& reads)
+    {
+        if (const StencilNode* sn = dynamic_cast<const StencilNode*>(expr)) {
+            reads.insert(sn->name());
+            for (const ExpressionNode* arg : sn->args()->arguments()) {
+                if (!collectStencilReads(arg, reads)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (const VarNode* vn = dynamic_cast<const VarNode*>(expr)) {
+            reads.insert(vn->name());
+            return true;
+        }
+        if (dynamic_cast<const QuantityNode*>(expr) || dynamic_cast<const NumberNode*>(expr)) {
+            return true;
+        }
+        if (const BinaryOpNode* bn = dynamic_cast<const BinaryOpNode*>(expr)) {
+            return collectStencilReads(bn->left(), reads) && collectStencilReads(bn->right(), reads);
+        }
+        if (const UnaryNegationNode* un = dynamic_cast<const UnaryNegationNode*>(expr)) {
+            return collectStencilReads(un->negatedExpression(), reads);
+        }
+        if (const FuncCallNode* fn = dynamic_cast<const FuncCallNode*>(expr)) {
+            for (const ExpressionNode* arg : fn->args()->arguments()) {
+                if (!collectStencilReads(arg, reads)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /// Returns the stencil assignment of a statement, which the parser wraps in a sequence.
+    StencilAssignmentNode* stencilAssignment(Node* statement)
+    {
+        if (SequenceNode* seq = dynamic_cast<SequenceNode*>(statement)) {
+            if (seq->nodes().size() == 1) {
+                return dynamic_cast<StencilAssignmentNode*>(seq->nodes()[0]);
+            }
+            return nullptr;
+        }
+        return dynamic_cast<StencilAssignmentNode*>(statement);
+    }
+
+    /// Returns true if node may read or write the variable name.
+    /// Calls to user-defined functions and nodes we do not know how to analyse count as mentions.
+    bool mentionsVariable(const Node* node, const std::string& name, const std::set<std::string>& user_functions)
+    {
+        if (!node || dynamic_cast<const NumberNode*>(node) || dynamic_cast<const StringNode*>(node)
+            || dynamic_cast<const QuantityNode*>(node) || dynamic_cast<const VarDeclNode*>(node)
+            || dynamic_cast<const FuncAssignNode*>(node)) {
+            return false;
+        }
+        if (const VarNode* vn = dynamic_cast<const VarNode*>(node)) {
+            return vn->name() == name;
+        }
+        if (const FuncCallLikeNode* fn = dynamic_cast<const FuncCallLikeNode*>(node)) {
+            // Covers both stencil accesses u(i, j) and function calls.
+            if (fn->name() == name || user_functions.count(fn->name())) {
+                return true;
+            }
+            for (const ExpressionNode* arg : fn->args()->arguments()) {
+                if (mentionsVariable(arg, name, user_functions)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (const BinaryOpNode* bn = dynamic_cast<const BinaryOpNode*>(node)) {
+            return mentionsVariable(bn->left(), name, user_functions) || mentionsVariable(bn->right(), name, user_functions);
+        }
+        if (const ComparisonOpNode* cn = dynamic_cast<const ComparisonOpNode*>(node)) {
+            return mentionsVariable(cn->left(), name, user_functions) || mentionsVariable(cn->right(), name, user_functions);
+        }
+        if (const UnaryNegationNode* un = dynamic_cast<const UnaryNegationNode*>(node)) {
+            return mentionsVariable(un->negatedExpression(), name, user_functions);
+        }
+        if (const NormNode* nn = dynamic_cast<const NormNode*>(node)) {
+            return mentionsVariable(nn->normedExpression(), name, user_functions);
+        }
+        if (const TrinaryIfNode* tn = dynamic_cast<const TrinaryIfNode*>(node)) {
+            return mentionsVariable(tn->predicate(), name, user_functions)
+                || mentionsVariable(tn->ifTrue(), name, user_functions)
+                || mentionsVariable(tn->ifFalse(), name, user_functions);
+        }
+        if (const VarAssignNode* va = dynamic_cast<const VarAssignNode*>(node)) {
+            return va->name() == name || mentionsVariable(va->rhs(), name, user_functions);
+        }
+        if (const StencilAssignmentNode* sa = dynamic_cast<const StencilAssignmentNode*>(node)) {
+            return sa->name() == name || mentionsVariable(sa->rhs(), name, user_functions);
+        }
+        if (const FuncCallStatementNode* fs = dynamic_cast<const FuncCallStatementNode*>(node)) {
+            return mentionsVariable(fs->funcCall(), name, user_functions);
+        }
+        if (const LoopNode* ln = dynamic_cast<const LoopNode*>(node)) {
+            return ln->loopSet() == name || mentionsVariable(ln->block(), name, user_functions);
+        }
+        if (const SequenceNode* sn = dynamic_cast<const SequenceNode*>(node)) {
+            for (const Node* child : sn->nodes()) {
+                if (mentionsVariable(child, name, user_functions)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        return true;
+    }
+
+    /// Returns true for expressions built from numbers and scalar variables only,
+    /// which can be evaluated anywhere without side effects.
+    bool isScalarArithmetic(const Node* expr)
+    {
+        if (dynamic_cast<const NumberNode*>(expr) || dynamic_cast<const QuantityNode*>(expr)) {
+            return true;
+        }
+        if (const VarNode* vn = dynamic_cast<const VarNode*>(expr)) {
+            const EquelleType type = SymbolTable::variableType(vn->name());
+            return type.basicType() == Scalar && type.isBasic();
+        }
+        if (const BinaryOpNode* bn = dynamic_cast<const BinaryOpNode*>(expr)) {
+            return isScalarArithmetic(bn->left()) && isScalarArithmetic(bn->right());
+        }
+        if (const UnaryNegationNode* un = dynamic_cast<const UnaryNegationNode*>(expr)) {
+            return isScalarArithmetic(un->negatedExpression());
+        }
+        return false;
+    }
+
+    bool isMutableStencilField(const std::string& name)
+    {
+        const EquelleType type = SymbolTable::variableType(name);
+        return type.isMutable() && type.isStencil() && type.isCollection() && !isStencilOnFaces(type);
+    }
+}
+
+/// Consecutive stencil assignments on the same set of cells are fused into a
+/// single sweep over the grid, as long as none of them reads a field written by
+/// another. This lets all components of a system (such as h, hu and hv) be
+/// updated in one pass instead of one pass per component.
+void PrintCPUBackendASTVisitor::findFusableStencils(SequenceNode& node)
+{
+    const std::vector<Node*>& statements = node.nodes();
+    const int n = statements.size();
+    int first = 0;
+    while (first < n) {
+        StencilAssignmentNode* head = stencilAssignment(statements[first]);
+        if (!head || stencil_fusion_.count(head) || isStencilOnFaces(head->lhs()->type())) {
+            // Already placed, either in a temporally blocked loop or by the enclosing sequence.
+            // Assignments to faces loop over a face range of their own, and are not fused.
+            ++first;
+            continue;
+        }
+        std::set<std::string> writes = { head->name() };
+        std::set<std::string> reads;
+        if (!collectStencilReads(head->rhs(), reads)) {
+            ++first;
+            continue;
+        }
+        reads.erase(head->name());
+        int last = first;
+        while (last + 1 < n) {
+            StencilAssignmentNode* next = stencilAssignment(statements[last + 1]);
+            if (!next
+                || stencil_fusion_.count(next)
+                || isStencilOnFaces(next->lhs()->type())
+                || next->type().gridMapping() != head->type().gridMapping()
+                || next->lhs()->args()->arguments().size() != head->lhs()->args()->arguments().size()
+                || writes.count(next->name())
+                || reads.count(next->name())) {
+                break;
+            }
+            std::set<std::string> next_reads;
+            if (!collectStencilReads(next->rhs(), next_reads)) {
+                break;
+            }
+            next_reads.erase(next->name());
+            bool conflict = false;
+            for (const std::string& w : writes) {
+                conflict = conflict || next_reads.count(w);
+            }
+            if (conflict) {
+                break;
+            }
+            writes.insert(next->name());
+            reads.insert(next_reads.begin(), next_reads.end());
+            ++last;
+        }
+        for (int s = first; s <= last; ++s) {
+            stencil_fusion_[stencilAssignment(statements[s])] = std::make_pair(s == first, s == last);
+        }
+        first = last + 1;
+    }
+}
+
+/// Consecutive assignments of reductions are batched, so that the runtime can complete
+/// them with one global communication instead of one per reduction. A reduction that
+/// reads the result of an earlier one in the batch starts a new batch.
+void PrintCPUBackendASTVisitor::findReductionBatches(SequenceNode& node)
+{
+    if (*reductionBatchString() == '\0') {
+        return;
+    }
+    std::vector<const VarAssignNode*> batch;
+    auto close_batch = [&]() {
+        if (batch.size() > 1) {
+            for (const VarAssignNode* member : batch) {
+                reduction_batch_of_[member] = reduction_batches_.size();
+            }
+            reduction_batches_.push_back(batch);
+        }
+        batch.clear();
+    };
+    for (const Node* statement : node.nodes()) {
+        const VarAssignNode* va = dynamic_cast<const VarAssignNode*>(statement);
+        const FuncCallNode* call = va ? dynamic_cast<const FuncCallNode*>(va->rhs()) : nullptr;
+        const bool is_reduction = call && !reduction_batch_of_.count(va)
+            && !SymbolTable::variableType(va->name()).isMutable()
+            && (call->name() == "MinReduce" || call->name() == "MaxReduce"
+                || call->name() == "SumReduce" || call->name() == "ProdReduce")
+            && !call->args()->argumentTypes().front().isStencil();
+        if (!is_reduction) {
+            close_batch();
+            continue;
+        }
+        for (const VarAssignNode* member : batch) {
+            if (mentionsVariable(call, member->name(), std::set<std::string>())) {
+                close_batch();
+                break;
+            }
+        }
+        batch.push_back(va);
+    }
+    close_batch();
+}
+
+/// Returns the assignment whose right hand side is the reduction node, if it is batched.
+const VarAssignNode* PrintCPUBackendASTVisitor::reductionBatchMember(const FuncCallNode& node) const
+{
+    for (const auto& member : reduction_batch_of_) {
+        if (member.first->rhs() == &node) {
+            return member.first;
+        }
+    }
+    return nullptr;
+}
+
+/// An assignment u0 = u between two mutable stencil fields in the main time loop
+/// is emitted as a buffer swap instead of a copy of the whole field, when the next
+/// iteration overwrites all of u before reading it, and u is not used after the
+/// assignment or after the loop. Only loops at the top level of the program are
+/// considered, since the statements following nested loops are harder to track.
+void PrintCPUBackendASTVisitor::findBufferSwaps(SequenceNode& program)
+{
+    if (!use_cartesian_) {
+        return;
+    }
+    const std::vector<Node*>& statements = program.nodes();
+    std::set<std::string> user_functions;
+    for (const Node* statement : statements) {
+        if (const FuncAssignNode* fa = dynamic_cast<const FuncAssignNode*>(statement)) {
+            user_functions.insert(fa->name());
+        }
+    }
+    for (size_t l = 0; l < statements.size(); ++l) {
+        const LoopNode* loop = dynamic_cast<const LoopNode*>(statements[l]);
+        if (!loop) {
+            continue;
+        }
+        SymbolTable::setCurrentFunction(loop->loopName());
+        const std::vector<Node*>& body = loop->block()->nodes();
+        for (size_t k = 0; k < body.size(); ++k) {
+            const VarAssignNode* assign = dynamic_cast<const VarAssignNode*>(body[k]);
+            const VarNode* source = assign ? dynamic_cast<const VarNode*>(assign->rhs()) : nullptr;
+            if (!source || source->name() == assign->name()
+                || !isMutableStencilField(assign->name()) || !isMutableStencilField(source->name())) {
+                continue;
+            }
+            const std::string& name = source->name();
+            // The first statement of the loop body using the source must overwrite all of it.
+            size_t first_use = 0;
+            while (first_use < k && !mentionsVariable(body[first_use], name, user_functions)) {
+                ++first_use;
+            }
+            const StencilAssignmentNode* refill = first_use < k ? stencilAssignment(body[first_use]) : nullptr;
+            std::set<std::string> reads;
+            if (!refill || refill->name() != name || refill->type().gridMapping() != AllCells
+                || !collectStencilReads(refill->rhs(), reads) || reads.count(name)) {
+                continue;
+            }
+            // The source must be dead after the assignment, in the loop body and after the loop.
+            bool used_later = false;
+            for (size_t s = k + 1; s < body.size(); ++s) {
+                used_later = used_later || mentionsVariable(body[s], name, user_functions);
+            }
+            for (size_t s = l + 1; s < statements.size(); ++s) {
+                used_later = used_later || mentionsVariable(statements[s], name, user_functions);
+            }
+            if (!used_later) {
+                buffer_swaps_.insert(assign);
+            }
+        }
+        SymbolTable::setCurrentFunction(SymbolTable::getCurrentFunction().parentScope());
+    }
+}
+
+/// A time loop whose body only computes constant scalars, updates one field u from
+/// u0 with a stencil and ends with a buffer swap u0 = u, is handed to the runtime as a
+/// whole so that it can be temporally blocked. Other loops are printed as usual.
+void PrintCPUBackendASTVisitor::findTemporalLoops(SequenceNode& program)
+{
+    if (!use_cartesian_) {
+        return;
+    }
+    for (const Node* statement : program.nodes()) {
+        const LoopNode* loop = dynamic_cast<const LoopNode*>(statement);
+        if (!loop || loop->block()->nodes().empty()) {
+            continue;
+        }
+        const std::vector<Node*>& body = loop->block()->nodes();
+        const VarAssignNode* swap = dynamic_cast<const VarAssignNode*>(body.back());
+        if (!swap || !buffer_swaps_.count(swap)) {
+            continue;
+        }
+        SymbolTable::setCurrentFunction(loop->loopName());
+        const StencilAssignmentNode* update = nullptr;
+        std::vector<VarAssignNode*> scalars;
+        bool pure = true;
+        for (size_t s = 0; s + 1 < body.size() && pure; ++s) {
+            if (const StencilAssignmentNode* sa = stencilAssignment(body[s])) {
+                pure = !update && sa->name() == static_cast<const VarNode*>(swap->rhs())->name();
+                update = sa;
+            } else if (VarAssignNode* va = dynamic_cast<VarAssignNode*>(body[s])) {
+                const EquelleType type = SymbolTable::variableType(va->name());
+                pure = type.basicType() == Scalar && type.isBasic() && !type.isMutable()
+                    && isScalarArithmetic(va->rhs());
+                scalars.push_back(va);
+            } else {
+                pure = false;
+            }
+        }
+        SymbolTable::setCurrentFunction(SymbolTable::getCurrentFunction().parentScope());
+        if (pure && update) {
+            TemporalLoop& temporal = temporal_loops_[loop];
+            temporal.swap = swap;
+            temporal.scalars = scalars;
+            temporal.dimensions = update->lhs()->args()->arguments().size();
+            temporal.uses_loop_variable = mentionsVariable(update, loop->loopVariable(), std::set<std::string>());
+            // The stencil update goes into the time stencil lambda, which the loop opens and closes.
+            stencil_fusion_[update] = std::make_pair(false, false);
+        }
+    }
+}
+
+/// Prints the scalar statements of a temporally blocked loop as a loop of its own over
+/// the steps, storing each value per step, so that the time stencil does not evaluate
+/// them again for every cell.
+void PrintCPUBackendASTVisitor::printHoistedScalars(const LoopNode& node, const TemporalLoop& temporal)
+{
+    if (temporal.scalars.empty()) {
+        return;
+    }
+    for (const VarAssignNode* scalar : temporal.scalars) {
+        std::cout << indent() << "std::vector<" << cppTypeString(scalar->type()) << "> "
+                  << scalar->name() << "_steps;";
+        endl();
+    }
+    const BasicType loopvartype = SymbolTable::variableType(node.loopSet()).basicType();
+    std::cout << indent() << "for (const " << cppTypeString(loopvartype) << "& "
+              << node.loopVariable() << " : " << node.loopSet() << ") {";
+    ++indent_;
+    endl();
+    for (VarAssignNode* scalar : temporal.scalars) {
+        scalar->accept(*this);
+        std::cout << indent() << scalar->name() << "_steps.push_back(" << scalar->name() << ");";
+        endl();
+        hoisted_statements_.insert(scalar);
+    }
+    --indent_;
+    std::cout << indent() << "}";
+    endl();
+}
+
+bool PrintCPUBackendASTVisitor::isTemporalLoopSwap(const VarAssignNode& node) const
+{
+    for (const auto& temporal : temporal_loops_) {
+        if (temporal.second.swap == &node) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void PrintCPUBackendASTVisitor::addRequirementString(const std::string& req)
 {
     requirement_strings_.insert(req);
@@ -780,11 +1531,19 @@ void PrintCPUBackendASTVisitor::addRequirementString(const std::string& req)
 
 void PrintCPUBackendASTVisitor::visit(StencilAssignmentNode &node)
 {
-    std::cout << indent() << "{ //Start of stencil-lambda" << std::endl;
-    indent_++;
-    //FIXME: Make dimension independent
-    std::cout << indent() << "auto cell_stencil = [&]( int i, int j ) {" << std::endl;
-    indent_++;
+    const auto fusion = stencil_fusion_.find(&node);
+    const bool opens = fusion == stencil_fusion_.end() || fusion->second.first;
+    if (opens) {
+        std::cout << indent() << "{ //Start of stencil-lambda" << std::endl;
+        indent_++;
+        // The stencil indices are named i, j (and k in 3D) in the generated lambda.
+        if (node.lhs()->args()->arguments().size() == 3) {
+            std::cout << indent() << "auto cell_stencil = [&]( int i, int j, int k ) {" << std::endl;
+        } else {
+            std::cout << indent() << "auto cell_stencil = [&]( int i, int j ) {" << std::endl;
+        }
+        indent_++;
+    }
     std::cout << indent();
 }
 
@@ -798,24 +1557,68 @@ void PrintCPUBackendASTVisitor::midVisit(StencilAssignmentNode &node)
 
 void PrintCPUBackendASTVisitor::postVisit(StencilAssignmentNode &node)
 {
-    std::string gridMapping = SymbolTable::entitySetName(node.type().gridMapping());
-    gridMapping[0] = tolower(gridMapping[0]);
-    indent_--;
     std::cout << ";" << std::endl;
+    const auto fusion = stencil_fusion_.find(&node);
+    const bool closes = fusion == stencil_fusion_.end() || fusion->second.second;
+    if (!closes) {
+        return;
+    }
+    std::string range = SymbolTable::entitySetName(node.type().gridMapping());
+    range[0] = tolower(range[0]);
+    std::vector<int> offsets;
+    const int direction = isStencilOnFaces(node.lhs()->type()) ? faceStencilOffsets(*node.lhs(), offsets) : -1;
+    if (direction >= 0) {
+        // Run over the faces normal to the half index, shifted so that each face is written once.
+        range = std::string("all") + char('X' + direction) + "Faces()";
+        if (std::count(offsets.begin(), offsets.end(), 0) != int(offsets.size())) {
+            offsets.resize(3, 0);
+            range += ".shifted( " + std::to_string(-offsets[0]) + ", " + std::to_string(-offsets[1])
+                + ", " + std::to_string(-offsets[2]) + " )";
+        }
+    }
+    indent_--;
     std::cout << indent() << "};" << std::endl;
-    std::cout << indent() << node.name() << ".grid." << gridMapping << ".execute( cell_stencil );" << std::endl;
+    std::cout << indent() << node.name() << ".grid." << range << ".execute( cell_stencil );" << std::endl;
     indent_--;
     std::cout << indent() << "} // End of stencil-lambda" << std::endl;
 }
 
 void PrintCPUBackendASTVisitor::visit(StencilNode& node)
 {
-    //FIXME If using half indices, should then use faceAt, not cellAt
-    std::cout << node.name() << ".grid.cellAt(" << node.name() << ", ";
+    if (!isStencilOnFaces(node.type())) {
+        if (!isSuppressed()) {
+            std::cout << node.name() << ".grid.cellAt(" << node.name() << ", ";
+        }
+        return;
+    }
+    // The indices are printed here, so the argument list is always suppressed.
+    const bool print = !isSuppressed();
+    suppress();
+    if (!print) {
+        return;
+    }
+    // A half index selects a face: u(i+0.5, j) is the negX face of cell (i+1, j).
+    std::vector<int> offsets;
+    const int direction = faceStencilOffsets(node, offsets);
+    std::cout << node.name() << ".grid.faceAt(" << node.name();
+    for (int d = 0; d < int(offsets.size()); ++d) {
+        std::cout << ", " << char('i' + d);
+        if (offsets[d] != 0) {
+            std::cout << (offsets[d] > 0 ? " + " : " - ") << (offsets[d] > 0 ? offsets[d] : -offsets[d]);
+        }
+    }
+    std::cout << ", CartesianGrid::Face::neg" << char('X' + direction) << ")";
 }
 
 void PrintCPUBackendASTVisitor::postVisit(StencilNode& node)
 {
+    if (isStencilOnFaces(node.type())) {
+        unsuppress();
+        return;
+    }
+    if (isSuppressed()) {
+        return;
+    }
     std::cout << ")";
 }
 
@@ -841,9 +1644,11 @@ namespace
 "#include <array>\n"
 "\n"
 "#include \"equelle/EquelleRuntimeCPU.hpp\"\n"
+"#include \"equelle/CartesianGrid.hpp\"\n"
 "\n"
 "void ensureRequirements(const equelle::EquelleRuntimeCPU& er);\n"
-"void equelleGeneratedCode(equelle::EquelleRuntimeCPU& er);\n"
+"void ensureCartesianRequirements(equelle::CartesianEquelleRuntime& er_cart);\n"
+"void equelleGeneratedCode(equelle::EquelleRuntimeCPU& er, equelle::CartesianEquelleRuntime& er_cart);\n"
 "\n"
  "#ifndef EQUELLE_NO_MAIN\n"
 "int main(int argc, char** argv)\n"
@@ -851,16 +1656,18 @@ namespace
 "    // Get user parameters.\n"
 "    Opm::parameter::ParameterGroup param(argc, argv, false);\n"
 "\n"
-"    // Create the Equelle runtime.\n"
+"    // Create the Equelle runtimes.\n"
 "    equelle::EquelleRuntimeCPU er(param);\n"
-"    equelleGeneratedCode(er);\n"
+"    equelle::CartesianEquelleRuntime er_cart(param);\n"
+"    equelleGeneratedCode(er, er_cart);\n"
 "    return 0;\n"
 "}\n"
 "#endif // EQUELLE_NO_MAIN\n"
 "\n"
-"void equelleGeneratedCode(equelle::EquelleRuntimeCPU& er) {\n"
+"void equelleGeneratedCode(equelle::EquelleRuntimeCPU& er, equelle::CartesianEquelleRuntime& er_cart) {\n"
 "    using namespace equelle;\n"
 "    ensureRequirements(er);\n"
+"    ensureCartesianRequirements(er_cart);\n"
 "\n"
 "    // ============= Generated code starts here ================\n";
     }
@@ -9,12 +9,21 @@
 #include "EquelleType.hpp"
 #include <string>
 #include <set>
+#include <map>
+#include <utility>
+#include <vector>
+
+class Node;
+class StencilAssignmentNode;
 
 class PrintCPUBackendASTVisitor : public ASTVisitorInterface
 {
 public:
     PrintCPUBackendASTVisitor();
-    explicit PrintCPUBackendASTVisitor(const bool use_cartesian);
+    /// @param use_cartesian Generate code for the cartesian stencil runtime.
+    /// @param stencil_width Ghost cell width required by the stencils, or -1 if unknown, in which
+    /// case the generated ensureCartesianRequirements() does not compile.
+    explicit PrintCPUBackendASTVisitor(const bool use_cartesian, const int stencil_width = -1);
     virtual ~PrintCPUBackendASTVisitor();
 
     void visit(SequenceNode& node);
@@ -80,11 +89,19 @@ public:
     void visit(StencilNode& node);
     void postVisit(StencilNode& node);
 
-    // These are overriden by subclasses who only need to alter the surroundings of the generated code.
+    // These are overridden by subclasses who only need to alter the surroundings of the generated code.
     virtual const char* cppStartString() const;
     virtual const char* cppEndString() const;
     virtual const char* classNameString() const;
     virtual const char* namespaceNameString() const;
+    // Runtime call that refreshes the ghost cells of a cell field before it is gathered onto faces, or "".
+    virtual const char* ghostUpdateString() const;
+    // Whether MinReduce() and the other reductions get the set their argument is On as a second argument.
+    virtual bool reductionsTakeDomain() const;
+    // Runtime call that completes a batch of partialReduce() results at once, or "" to reduce one by one.
+    virtual const char* reductionBatchString() const;
+    // Whether Output() of a collection gets the set it is On, to write it in the input order.
+    virtual bool outputTakesDomain() const;
 
 private:
     int suppression_level_;
@@ -96,6 +113,36 @@ private:
     int next_funcstart_inst_;
     std::string skipping_function_;
     bool use_cartesian_;
+    int stencil_width_;
+    // For stencil assignments that are fused with their neighbours into one sweep:
+    // whether the assignment opens and/or closes the shared stencil lambda.
+    std::map<const StencilAssignmentNode*, std::pair<bool, bool>> stencil_fusion_;
+    // Assignments between mutable stencil fields that are emitted as a buffer swap.
+    std::set<const VarAssignNode*> buffer_swaps_;
+    // Time loops emitted as one call to the temporally blocked executor.
+    struct TemporalLoop {
+        const VarAssignNode* swap; // The final u0 = u, which is done by the runtime.
+        std::vector<VarAssignNode*> scalars; // Computed for all steps before the stencil sweeps.
+        int dimensions;
+        bool uses_loop_variable;
+    };
+    std::map<const LoopNode*, TemporalLoop> temporal_loops_;
+    std::set<const VarAssignNode*> hoisted_statements_;
+    // Consecutive assignments of independent reductions, which are completed by one call to the runtime.
+    std::vector<std::vector<const VarAssignNode*>> reduction_batches_;
+    std::map<const VarAssignNode*, int> reduction_batch_of_;
+    // Fields whose ghost cells have been updated, and the variable holding the result, so that a
+    // field that is gathered several times is only exchanged once until it is assigned again.
+    // The fields are variables u or array elements q[0].
+    // Each function body and loop body is a scope, since the variables are declared inside it.
+    struct GhostUpdateScope {
+        std::map<std::string, std::string> updated;
+        bool is_function;
+        bool is_loop;
+    };
+    std::vector<GhostUpdateScope> ghost_update_scopes_;
+    std::map<std::string, int> ghost_update_count_;
+    std::set<const OnNode*> ghost_update_reuses_;
 
     void endl() const;
     std::string indent() const;
@@ -104,6 +151,18 @@ private:
     bool isSuppressed() const;
     std::string cppTypeString(const EquelleType& et) const;
     void addRequirementString(const std::string& req);
+    void findFusableStencils(SequenceNode& node);
+    void findReductionBatches(SequenceNode& node);
+    const VarAssignNode* reductionBatchMember(const FuncCallNode& node) const;
+    void findBufferSwaps(SequenceNode& program);
+    void findTemporalLoops(SequenceNode& program);
+    bool isTemporalLoopSwap(const VarAssignNode& node) const;
+    void printHoistedScalars(const LoopNode& node, const TemporalLoop& temporal);
+    bool readsNeighbourCells(const OnNode& node) const;
+    void printGhostUpdates(const Node* expr);
+    const std::string* findGhostUpdate(const OnNode& node) const;
+    void forgetGhostUpdate(const std::string& variable);
+    std::string entitySetCppTerm(const int entity_set_index) const;
 };
 
 #endif // PRINTCPUBACKENDASTVISITOR_HEADER_INCLUDED
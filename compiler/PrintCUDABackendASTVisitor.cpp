@@ -81,3 +81,8 @@ const char *PrintCUDABackendASTVisitor::namespaceNameString() const
     return "equelleCUDA";
 }
 
+bool PrintCUDABackendASTVisitor::outputTakesDomain() const
+{
+    return false;
+}
+
@@ -92,3 +92,24 @@ const char *PrintMPIBackendASTVisitor::namespaceNameString() const
 {
     return "equelle";
 }
+
+const char *PrintMPIBackendASTVisitor::ghostUpdateString() const
+{
+    return "er.updateGhosts";
+}
+
+bool PrintMPIBackendASTVisitor::reductionsTakeDomain() const
+{
+    return true;
+}
+
+const char *PrintMPIBackendASTVisitor::reductionBatchString() const
+{
+    return "er.reduce";
+}
+
+bool PrintMPIBackendASTVisitor::outputTakesDomain() const
+{
+    // RuntimeMPI::output() writes collections On AllCells() in the global enumeration.
+    return false;
+}
@@ -12,5 +12,9 @@ public:
     const char* cppEndString() const;
     const char* classNameString() const;
     const char* namespaceNameString() const;
+    const char* ghostUpdateString() const;
+    bool reductionsTakeDomain() const;
+    const char* reductionBatchString() const;
+    bool outputTakesDomain() const;
 };
 
@@ -256,6 +256,7 @@ std::string FunctionType::equelleString() const
 
 Function::Function(const std::string& name)
     : name_(name),
+      is_template_(false),
       parent_scope_(0)
 {
 }
@@ -263,6 +264,7 @@ Function::Function(const std::string& name)
 Function::Function(const std::string& name, const FunctionType& type)
     : name_(name),
       type_(type),
+      is_template_(false),
       parent_scope_(0)
 {
 }
@@ -814,7 +816,7 @@ SymbolTable::SymbolTable()
                                          { InvalidIndex, 1, InvalidIndex}));
     functions_.emplace_back("InputStencilCollectionOfScalar",
                             FunctionType({ Variable("name", EquelleType(String)),
-                                           Variable("entities", EquelleType(Invalid, None, NotApplicable, NotApplicable, false, false, NotAnArray, true)) },
+                                           Variable("entities", EquelleType(Invalid, Collection, NotApplicable, NotApplicable, false, true)) },
                                          EquelleType(Scalar, Collection, NotApplicable, NotApplicable, false, false, NotAnArray, true),
                                          Dimension(),
                                          { InvalidIndex, 1, InvalidIndex}));
@@ -897,6 +899,13 @@ SymbolTable::SymbolTable()
                             FunctionType( EquelleType( StencilJ ) ) );
     functions_.emplace_back("StencilK",
                             FunctionType( EquelleType( StencilK ) ) );
+    // Fills the ghost cells of a (mutable) stencil collection in place.
+    // The conditions string is either a single condition for all sides, or one per side
+    // in the order negX posX negY posY [negZ posZ]. See CartesianEquelleRuntime.
+    functions_.emplace_back("ApplyCartesianBoundaryConditions",
+                            FunctionType({ Variable("data", EquelleType(Scalar, Collection, NotApplicable, NotApplicable, false, false, NotAnArray, true)),
+                                           Variable("conditions", EquelleType(String)) },
+                                         EquelleType(Void)));
 
 
     // ----- Set main function ref and current (initially equal to main). -----
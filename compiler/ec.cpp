@@ -105,7 +105,7 @@ int main(int argc, char** argv)
         else if (backend == "cpu") {
             // Check if we use the Cartesian dialect
             const bool use_cartesian = cli_vars.count("cartesian");
-            PrintCPUBackendASTVisitor v(use_cartesian);
+            PrintCPUBackendASTVisitor v(use_cartesian, check.stencilWidth());
             SymbolTable::program()->accept(v);
         }
         else if (backend == "cuda") {
@@ -0,0 +1,111 @@
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE EquelleCompilerTest
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include "ASTNodes.hpp"
+#include "CheckASTVisitor.hpp"
+#include "PrintCPUBackendASTVisitor.hpp"
+#include "SymbolTable.hpp"
+
+extern int yyparse();
+extern FILE* yyin;
+extern int yylineno;
+
+namespace {
+
+    /// Parses an Equelle program and checks it with check, like ec does.
+    /// All programs share the global symbol table, so each test uses its own variable names.
+    void parseAndCheck( const std::string& source, CheckASTVisitor& check )
+    {
+        FILE* file = std::tmpfile();
+        BOOST_REQUIRE( file );
+        std::fputs( source.c_str(), file );
+        std::rewind( file );
+        yyin = file;
+        yylineno = 1;
+        const int parsed = yyparse();
+        yyin = nullptr;
+        std::fclose( file );
+        BOOST_REQUIRE_EQUAL( parsed, 0 );
+        SymbolTable::program()->accept( check );
+    }
+
+    /// Returns the cartesian C++ code for the last parsed program.
+    std::string printProgram( const CheckASTVisitor& check )
+    {
+        PrintCPUBackendASTVisitor printer( true, check.stencilWidth() );
+        std::ostringstream out;
+        std::streambuf* cout_buf = std::cout.rdbuf( out.rdbuf() );
+        SymbolTable::program()->accept( printer );
+        std::cout.rdbuf( cout_buf );
+        return out.str();
+    }
+
+} // anonymous namespace
+
+
+BOOST_AUTO_TEST_CASE( constantOffsets ) {
+    CheckASTVisitor check( true );
+    BOOST_CHECK_EQUAL( check.stencilWidth(), 0 );
+    parseAndCheck(
+        "a0 : Stencil Collection Of Scalar On AllCells()\n"
+        "a0 = InputStencilCollectionOfScalar(\"a0\", AllCells())\n"
+        "a : Mutable Stencil Collection Of Scalar On AllCells()\n"
+        "a = a0\n"
+        "ai = StencilI()\n"
+        "aj = StencilJ()\n"
+        "# The widest offset decides.\n"
+        "a(ai, aj) = a0(ai+1, aj) + a0(ai, aj-2)\n", check );
+    BOOST_CHECK_EQUAL( check.stencilWidth(), 2 );
+    BOOST_CHECK( check.isValid() );
+
+    const std::string code = printProgram( check );
+    BOOST_CHECK( code.find( "er_cart.ensureGhostWidthMin(2);" ) != std::string::npos );
+    BOOST_CHECK( code.find( "#error" ) == std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( undeterminedOffset ) {
+    CheckASTVisitor check( true );
+    parseAndCheck(
+        "b0 : Stencil Collection Of Scalar On AllCells()\n"
+        "b0 = InputStencilCollectionOfScalar(\"b0\", AllCells())\n"
+        "b : Mutable Stencil Collection Of Scalar On AllCells()\n"
+        "b = b0\n"
+        "n = InputScalarWithDefault(\"n\", 1)\n"
+        "bi = StencilI()\n"
+        "bj = StencilJ()\n"
+        "# The offset n is only known at run time, and the wider\n"
+        "# access after it must not hide that.\n"
+        "b(bi, bj) = b0(bi+n, bj) + b0(bi+3, bj)\n", check );
+    BOOST_CHECK_EQUAL( check.stencilWidth(), -1 );
+    BOOST_CHECK( !check.isValid() );
+
+    const std::string code = printProgram( check );
+    BOOST_CHECK( code.find( "#error" ) != std::string::npos );
+    BOOST_CHECK( code.find( "ensureGhostWidthMin" ) == std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( shiftedFaceRange ) {
+    CheckASTVisitor check( true );
+    parseAndCheck(
+        "d0 : Stencil Collection Of Scalar On AllCells()\n"
+        "d0 = InputStencilCollectionOfScalar(\"d0\", AllCells())\n"
+        "df : Mutable Stencil Collection Of Scalar On AllFaces()\n"
+        "df = InputStencilCollectionOfScalar(\"df\", AllFaces())\n"
+        "di = StencilI()\n"
+        "dj = StencilJ()\n"
+        "# Writing face i+0.5 runs over i = -1 to n-1, so d0 is read from\n"
+        "# cell -2 on, although no offset is wider than 1.\n"
+        "df(di+0.5, dj) = d0(di-1, dj)\n", check );
+    BOOST_CHECK_EQUAL( check.stencilWidth(), 2 );
+    BOOST_CHECK( check.isValid() );
+
+    const std::string code = printProgram( check );
+    BOOST_CHECK( code.find( "er_cart.ensureGhostWidthMin(2);" ) != std::string::npos );
+}
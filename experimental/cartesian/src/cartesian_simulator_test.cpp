@@ -83,7 +83,7 @@ BOOST_AUTO_TEST_CASE( heatEquation ) {
         t = (t + dt);
         er.output("t", t);
         er_cart.output("u", u);
-        u0 = u;
+        u0.swapAssign(u);
     }
 }
 
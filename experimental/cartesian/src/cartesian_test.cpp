@@ -113,7 +113,187 @@ BOOST_AUTO_TEST_CASE( cellAtTest ) {
     }
 }
 
-#if 0
+BOOST_AUTO_TEST_CASE( ghostWidthRequirementTest ) {
+	Opm::parameter::ParameterGroup param;
+
+	param.insertParameter("nx", "3");
+	param.insertParameter("ny", "5");
+
+	equelle::CartesianEquelleRuntime er_cart(param);
+	er_cart.ensureGhostWidthMin( 2 );
+    equelle::StencilCollOfScalar u = er_cart.inputCellScalarWithDefault( "u", 1.0 );
+    BOOST_CHECK_EQUAL( u.grid.ghost_width, 2 );
+
+	param.insertParameter("ghost_width", "1");
+	equelle::CartesianEquelleRuntime er_cart_narrow(param);
+	BOOST_CHECK_THROW( er_cart_narrow.ensureGhostWidthMin( 2 ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( boundaryConditionTest ) {
+	Opm::parameter::ParameterGroup param;
+
+	param.insertParameter("nx", "3");
+	param.insertParameter("ny", "2");
+	param.insertParameter("ghost_width", "1");
+
+	equelle::CartesianEquelleRuntime er_cart(param);
+    equelle::StencilCollOfScalar u = er_cart.inputCellScalarWithDefault( "u", 0.0 );
+    for( int j = 0; j < 2; ++j ) {
+        for( int i = 0; i < 3; ++i ) {
+            u.grid.cellAt( u, i, j ) = i + 10*j;
+        }
+    }
+
+    er_cart.applyCartesianBoundaryConditions( u, "periodic" );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, -1, 0 ), 2.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 3, 1 ), 10.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 1, -1 ), 11.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 1, 2 ), 1.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, -1, -1 ), 12.0 );
+
+    er_cart.applyCartesianBoundaryConditions( u, "negated_reflective reflective dirichlet=1 extrapolate" );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, -1, 1 ), -10.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 3, 1 ), 12.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 2, -1 ), 0.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 2, 2 ), 12.0 );
+
+    BOOST_CHECK_THROW( er_cart.applyCartesianBoundaryConditions( u, "periodic periodic" ), std::runtime_error );
+    BOOST_CHECK_THROW( er_cart.applyCartesianBoundaryConditions( u, "sticky" ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( swapAssignTest ) {
+    equelle::StencilCollOfScalar u0( std::make_tuple( 3, 2 ), 1, 1.0 );
+    equelle::StencilCollOfScalar u( std::make_tuple( 3, 2 ), 1, 2.0 );
+    u.grid.cellAt( u, -1, 0 ) = 5.0;
+    u.grid.cellAt( u, 1, 2 ) = 6.0;
+
+    u0.swapAssign( u );
+    BOOST_CHECK_EQUAL( u0.grid.cellAt( u0, 1, 1 ), 2.0 );
+    BOOST_CHECK_EQUAL( u0.grid.cellAt( u0, -1, 0 ), 5.0 );
+    // The ghost cells of u are kept, the interior is left with the old values of u0.
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, -1, 0 ), 5.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 1, 2 ), 6.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 3, -1 ), 0.0 );
+    BOOST_CHECK_EQUAL( u.grid.cellAt( u, 2, 1 ), 1.0 );
+}
+
+BOOST_AUTO_TEST_CASE( temporalBlockingTest ) {
+    equelle::StencilCollOfScalar initial( std::make_tuple( 13, 11 ), 2 );
+    for( int j = -2; j < 13; ++j ) {
+        for( int i = -2; i < 15; ++i ) {
+            initial.grid.cellAt( initial, i, j ) = ( 7*i + 3*j*j ) % 10;
+        }
+    }
+    auto diffusion = [&]( int step, equelle::StencilCollOfScalar& u, const equelle::StencilCollOfScalar& u0, int i, int j ) {
+        const double a = 0.1 + 0.01*step;
+        u.grid.cellAt( u, i, j ) = u0.grid.cellAt( u0, i, j ) + a * ( u0.grid.cellAt( u0, i-2, j ) + u0.grid.cellAt( u0, i+1, j )
+                + u0.grid.cellAt( u0, i, j-2 ) + u0.grid.cellAt( u0, i, j+1 ) - 4*u0.grid.cellAt( u0, i, j ) );
+    };
+
+    for( int steps = 1; steps < 8; ++steps ) {
+        equelle::StencilCollOfScalar u0 = initial;
+        equelle::StencilCollOfScalar u = initial;
+        for( int step = 0; step < steps; ++step ) {
+            u.grid.allCells().execute( [&]( int i, int j ) { diffusion( step, u, u0, i, j ); } );
+            u0 = u;
+        }
+
+        equelle::StencilCollOfScalar b0 = initial;
+        equelle::StencilCollOfScalar b = initial;
+        b.grid.allCells().executeTimeSteps( steps, 3, 2, 2, b, b0, diffusion );
+        for( int j = -2; j < 13; ++j ) {
+            for( int i = -2; i < 15; ++i ) {
+                BOOST_REQUIRE_CLOSE( b0.grid.cellAt( b0, i, j ), u0.grid.cellAt( u0, i, j ), 1e-10 );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( multiComponentTest ) {
+	Opm::parameter::ParameterGroup param;
+
+	param.insertParameter("nx", "5");
+	param.insertParameter("ny", "3");
+	param.insertParameter("h", "2.0");
+	param.insertParameter("hu", "3.0");
+
+	equelle::CartesianEquelleRuntime er_cart(param);
+    for ( auto layout : { equelle::ComponentLayout::SoA, equelle::ComponentLayout::AoSoA } ) {
+        equelle::MultiStencilCollOfScalar q = er_cart.inputCellMultiCollectionOfScalar( { "h", "hu" }, layout );
+        BOOST_REQUIRE_EQUAL( q.num_components, 2 );
+        BOOST_CHECK_EQUAL( q.cellAt( 0, 4, 2 ), 2.0 );
+        BOOST_CHECK_EQUAL( q.cellAt( 1, 4, 2 ), 3.0 );
+        BOOST_CHECK_EQUAL( q.cellAt( 1, -1, 2 ), 0.0 );
+
+        auto cell_stencil = [&]( int i, int j ) {
+            q.cellAt( 0, i, j ) = i;
+            q.cellAt( 1, i, j ) = q.cellAt( 0, i, j ) + j;
+        };
+        q.grid.allCells().execute( cell_stencil );
+
+        const equelle::StencilCollOfScalar hu = q.component( 1 );
+        BOOST_CHECK_EQUAL( hu.grid.cellAt( hu, 3, 2 ), 5.0 );
+        BOOST_CHECK_EQUAL( hu.grid.cellAt( hu, 3, -1 ), 0.0 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( cellAt3DTest ) {
+	Opm::parameter::ParameterGroup param;
+
+	param.insertParameter("grid_dim", "3");
+	param.insertParameter("nx", "3");
+	param.insertParameter("ny", "4");
+	param.insertParameter("nz", "5");
+	param.insertParameter("ghost_width", "1");
+
+	const int nx = 3;
+	const int ny = 4;
+	const int nz = 5;
+	const int ghost_width = 1;
+
+	equelle::CartesianEquelleRuntime er_cart(param);
+
+    equelle::StencilCollOfScalar u = er_cart.inputCellScalarWithDefault( "u", 1.0 );
+
+    BOOST_REQUIRE_EQUAL( u.grid.dimensions, 3 );
+    BOOST_REQUIRE_EQUAL( u.data.size(), (nx+2*ghost_width)*(ny+2*ghost_width)*(nz+2*ghost_width) );
+    BOOST_REQUIRE_EQUAL( u.grid.cellStrides[2], (nx+2*ghost_width)*(ny+2*ghost_width) );
+
+    for( int k = -ghost_width; k < nz+ghost_width; ++k ) {
+        for( int j = -ghost_width; j < ny+ghost_width; ++j ) {
+            for( int i = -ghost_width; i < nx+ghost_width; ++i ) {
+                const bool inside = i >= 0 && j >= 0 && k >= 0 && i < nx && j < ny && k < nz;
+                BOOST_CHECK_EQUAL( u.grid.cellAt( u, i, j, k ), inside ? 1.0 : 0.0 );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( execute3DTest ) {
+    equelle::StencilCollOfScalar u( std::make_tuple( 3, 4, 5 ), 1 );
+    equelle::StencilCollOfScalar v( std::make_tuple( 3, 4, 5 ), 1 );
+
+    auto init = [&]( int i, int j, int k ) {
+        u.grid.cellAt( u, i, j, k ) = i + 10*j + 100*k;
+    };
+    u.grid.allCells().execute( init );
+
+    auto cell_stencil = [&]( int i, int j, int k ) {
+        v.grid.cellAt( v, i, j, k ) = u.grid.cellAt( u, i, j, k+1 ) - u.grid.cellAt( u, i, j, k );
+    };
+    v.grid.allCells().tiled( 2, 2 ).execute( cell_stencil );
+
+    for( int k = 0; k < 4; ++k ) {
+        for( int j = 0; j < 4; ++j ) {
+            for( int i = 0; i < 3; ++i ) {
+                BOOST_CHECK_EQUAL( v.grid.cellAt( v, i, j, k ), 100.0 );
+            }
+        }
+    }
+    // The ghost layer above the top is zero.
+    BOOST_CHECK_EQUAL( v.grid.cellAt( v, 0, 0, 4 ), -400.0 );
+}
+
 /**
  * Test that faceAt gives the correct data
  */
@@ -122,54 +302,30 @@ BOOST_AUTO_TEST_CASE( faceAtTest ) {
     int dim_y = 5;
     int ghostWidth = 2;
 
-    equelle::CartesianGrid grid( std::make_tuple( dim_x, dim_y),  ghostWidth );
-    equelle::CartesianGrid::CartesianCollectionOfScalar flux = grid.inputFaceScalarWithDefault( "flux", 0.5 );
+    equelle::CartesianGrid grid( std::make_tuple( dim_x, dim_y ), ghostWidth );
+    equelle::FaceStencilCollOfScalar flux( grid, 0.5 );
 
     typedef equelle::CartesianGrid::Face Face;
 
     //check that a face can be reached from its two adjacent cells
-    for ( int j = -ghostWidth; j < dim_y+ghostWidth; ++j ) {
-        for( int i = -ghostWidth; i < dim_x+ghostWidth; ++i ) {
-            BOOST_CHECK_EQUAL( &grid.faceAt( i, j, Face::negX, flux ),
-                               &grid.faceAt( i-1, j, Face::posX, flux ) );
+    for ( int j = -ghostWidth+1; j < dim_y+ghostWidth; ++j ) {
+        for( int i = -ghostWidth+1; i < dim_x+ghostWidth; ++i ) {
+            BOOST_CHECK_EQUAL( &grid.faceAt( flux, i, j, Face::negX ),
+                               &grid.faceAt( flux, i-1, j, Face::posX ) );
 
-            BOOST_CHECK_EQUAL( &grid.faceAt( i, j, Face::negY, flux ),
-                               &grid.faceAt( i, j-1, Face::posY, flux ) );
+            BOOST_CHECK_EQUAL( &grid.faceAt( flux, i, j, Face::negY ),
+                               &grid.faceAt( flux, i, j-1, Face::posY ) );
         }
     }
 
     // Check that we are zero on the ghost faces.
     for( int j = -ghostWidth; j < dim_y+ghostWidth; ++j ) {
         for( int i = -ghostWidth; i < dim_x+ghostWidth; ++i ) {
-            //Outside domain
-            if (i < 0 || i > dim_x) {
-                BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negX, flux ), 0.0 );
-            }
-            else {
-                //Outside domain
-                if (j <0 || j >= dim_y) {
-                    BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negX, flux ), 0.0 );
-                }
-                //Inside domain
-                else {
-                    BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negX, flux ), 0.5 );
-                }
-            }
+            const bool inside_x = i >= 0 && i <= dim_x && j >= 0 && j < dim_y;
+            BOOST_CHECK_EQUAL( grid.faceAt( flux, i, j, Face::negX ), inside_x ? 0.5 : 0.0 );
 
-            //Outside domain
-            if (j < 0 || j > dim_y) {
-                BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negY, flux ), 0.0 );
-            }
-            else {
-                //Outside domain
-                if (i <0 || i >= dim_x) {
-                    BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negY, flux ), 0.0 );
-                }
-                //Inside domain
-                else {
-                    BOOST_CHECK_EQUAL( grid.faceAt( i, j, Face::negY, flux ), 0.5 );
-                }
-            }
+            const bool inside_y = j >= 0 && j <= dim_y && i >= 0 && i < dim_x;
+            BOOST_CHECK_EQUAL( grid.faceAt( flux, i, j, Face::negY ), inside_y ? 0.5 : 0.0 );
         }
     }
 
@@ -177,16 +333,157 @@ BOOST_AUTO_TEST_CASE( faceAtTest ) {
     for( int j = 0; j < dim_y; ++j ) {
         for( int i = 0; i < dim_x; ++i ) {
             double sum = 0.0f;
-            sum += grid.faceAt( i, j, equelle::CartesianGrid::Face::negX, flux );
-            sum += grid.faceAt( i, j, equelle::CartesianGrid::Face::posX, flux );
-            sum += grid.faceAt( i, j, equelle::CartesianGrid::Face::negY, flux );
-            sum += grid.faceAt( i, j, equelle::CartesianGrid::Face::posY, flux );
+            sum += grid.faceAt( flux, i, j, Face::negX );
+            sum += grid.faceAt( flux, i, j, Face::posX );
+            sum += grid.faceAt( flux, i, j, Face::negY );
+            sum += grid.faceAt( flux, i, j, Face::posY );
             BOOST_CHECK_EQUAL( sum, 2.0 );
         }
     }
+
+    // All faces, including those of the ghost cells, have distinct storage.
+    std::vector<const double*> addresses;
+    for( int j = -ghostWidth; j < dim_y+ghostWidth; ++j ) {
+        for( int i = -ghostWidth; i < dim_x+ghostWidth; ++i ) {
+            addresses.push_back( &grid.faceAt( flux, i, j, Face::negX ) );
+            addresses.push_back( &grid.faceAt( flux, i, j, Face::negY ) );
+        }
+        addresses.push_back( &grid.faceAt( flux, dim_x+ghostWidth-1, j, Face::posX ) );
+    }
+    for( int i = -ghostWidth; i < dim_x+ghostWidth; ++i ) {
+        addresses.push_back( &grid.faceAt( flux, i, dim_y+ghostWidth-1, Face::posY ) );
+    }
+    std::sort( addresses.begin(), addresses.end() );
+    BOOST_CHECK( std::adjacent_find( addresses.begin(), addresses.end() ) == addresses.end() );
+    BOOST_CHECK_EQUAL( int(addresses.size()), grid.number_of_faces_and_ghost_faces );
+    BOOST_CHECK_EQUAL( int(flux.data.size()), grid.number_of_faces_and_ghost_faces );
+}
+
+BOOST_AUTO_TEST_CASE( faceAt3DTest ) {
+    equelle::CartesianGrid grid( std::make_tuple( 2, 3, 4 ), 1 );
+    equelle::FaceStencilCollOfScalar flux( grid, 1.0 );
+    typedef equelle::CartesianGrid::Face Face;
+
+    BOOST_CHECK_EQUAL( &grid.faceAt( flux, 1, 2, 3, Face::negZ ), &grid.faceAt( flux, 1, 2, 2, Face::posZ ) );
+    BOOST_CHECK_EQUAL( grid.faceAt( flux, 1, 2, 3, Face::posZ ), 1.0 );
+    BOOST_CHECK_EQUAL( grid.faceAt( flux, 1, 2, 4, Face::posZ ), 0.0 );
+    BOOST_CHECK_EQUAL( &grid.faceAt( flux, 2, 3, 4, Face::posZ ) + 1,
+                       flux.data.data() + grid.number_of_faces_and_ghost_faces );
+}
+
+BOOST_AUTO_TEST_CASE( constantFaceData ) {
+    Opm::parameter::ParameterGroup param;
+
+    param.insertParameter( "nx", "2" );
+    param.insertParameter( "ny", "2" );
+    param.insertParameter( "flux", "-1.5" );
+
+    equelle::CartesianEquelleRuntime er_cart( param );
+    auto f = er_cart.inputFaceCollectionOfScalar( "flux" );
+
+    BOOST_CHECK_EQUAL( f.grid.faceAt( f, 0, 0, equelle::CartesianGrid::Face::negX ), -1.5 );
+    BOOST_CHECK_EQUAL( f.grid.faceAt( f, 1, 0, equelle::CartesianGrid::Face::negX ), -1.5 );
+    BOOST_CHECK_EQUAL( f.grid.faceAt( f, 2, 0, equelle::CartesianGrid::Face::negX ), -1.5 );
+
+    // Check that ghost face is not set.
+    BOOST_CHECK_EQUAL( f.grid.faceAt( f, 2, 0, equelle::CartesianGrid::Face::posX ), 0.0 );
+}
+
+BOOST_AUTO_TEST_CASE( faceDataFromFile ) {
+    Opm::parameter::ParameterGroup param;
+
+    param.insertParameter( "nx", "2" );
+    param.insertParameter( "ny", "2" );
+
+    std::vector<double> defaults = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+    injectMockData( param, "flux", defaults.begin(), defaults.end() );
+
+    equelle::CartesianEquelleRuntime er_cart( param );
+    auto u = er_cart.inputFaceCollectionOfScalar( "flux" );
+    BOOST_CHECK_EQUAL( u.grid.faceAt( u, 0, 0, equelle::CartesianGrid::Face::negX ), 1 );
+    BOOST_CHECK_EQUAL( u.grid.faceAt( u, 1, 0, equelle::CartesianGrid::Face::posX ), 3 );
+
+    BOOST_CHECK_EQUAL( u.grid.faceAt( u, 1, 1, equelle::CartesianGrid::Face::negY ), 11 );
+    BOOST_CHECK_EQUAL( u.grid.faceAt( u, 1, 1, equelle::CartesianGrid::Face::posY ), 12 );
 }
 
+/**
+ * Flux-form update: each face flux is computed once, and used by both neighbouring cells.
+ */
+BOOST_AUTO_TEST_CASE( staggeredFluxTest ) {
+    equelle::StencilCollOfScalar u( std::make_tuple( 4, 3 ), 1 );
+    for( int j = -1; j < 4; ++j ) {
+        for( int i = -1; i < 5; ++i ) {
+            u.grid.cellAt( u, i, j ) = i*i + 2*j;
+        }
+    }
+    equelle::FaceStencilCollOfScalar flux( u.grid );
+    typedef equelle::CartesianGrid::Face Face;
+    flux.grid.allXFaces().execute( [&]( int i, int j ) {
+        flux.grid.faceAt( flux, i, j, Face::negX ) = u.grid.cellAt( u, i, j ) - u.grid.cellAt( u, i-1, j );
+    } );
+    flux.grid.allYFaces().shifted( 0, -1, 0 ).execute( [&]( int i, int j ) {
+        flux.grid.faceAt( flux, i, j, Face::posY ) = u.grid.cellAt( u, i, j+1 ) - u.grid.cellAt( u, i, j );
+    } );
+
+    equelle::StencilCollOfScalar div( std::make_tuple( 4, 3 ), 1 );
+    div.grid.allCells().execute( [&]( int i, int j ) {
+        div.grid.cellAt( div, i, j ) = flux.grid.faceAt( flux, i, j, Face::posX ) - flux.grid.faceAt( flux, i, j, Face::negX )
+            + flux.grid.faceAt( flux, i, j, Face::posY ) - flux.grid.faceAt( flux, i, j, Face::negY );
+    } );
+    // The discrete Laplacian of i*i + 2*j is 2.
+    for( int j = 0; j < 3; ++j ) {
+        for( int i = 0; i < 4; ++i ) {
+            BOOST_CHECK_CLOSE( div.grid.cellAt( div, i, j ), 2.0, 1e-12 );
+        }
+    }
+}
 
+BOOST_AUTO_TEST_CASE( binaryOutputAndInput ) {
+    Opm::parameter::ParameterGroup param;
+    param.insertParameter( "grid_dim", "3" );
+    param.insertParameter( "nx", "4" );
+    param.insertParameter( "ny", "3" );
+    param.insertParameter( "nz", "2" );
+    param.insertParameter( "output_format", "binary" );
+    param.insertParameter( "output_ghost_cells", "false" );
+    param.insertParameter( "output_async", "true" );
+
+    std::vector<double> values( 4*3*2 );
+    std::iota( values.begin(), values.end(), 0.5 );
+    injectMockData( param, "u", values.begin(), values.end() );
+
+    {
+        equelle::CartesianEquelleRuntime er_cart( param );
+        equelle::StencilCollOfScalar u = er_cart.inputCellCollectionOfScalar( "u" );
+        BOOST_CHECK_EQUAL( u.grid.cellAt( u, 1, 2, 1 ), values[ (1*3 + 2)*4 + 1 ] );
+
+        std::vector<double> packed;
+        u.grid.packCells( u, false, packed );
+        BOOST_CHECK_EQUAL_COLLECTIONS( packed.begin(), packed.end(), values.begin(), values.end() );
+
+        er_cart.output( "binary_u", u );
+        u.grid.cellAt( u, 0, 0, 0 ) = -1.0;
+        er_cart.output( "binary_u", u );
+        // The destructor waits for the files to be written.
+    }
+
+    // Read the second file back in, as binary input.
+    param.insertParameter( "v_from_file", "true" );
+    param.insertParameter( "v_filename", "binary_u-00001.bin" );
+    param.insertParameter( "v_binary", "true" );
+    equelle::CartesianEquelleRuntime er_cart( param );
+    equelle::StencilCollOfScalar v = er_cart.inputCellCollectionOfScalar( "v" );
+    std::vector<double> packed;
+    v.grid.packCells( v, false, packed );
+    values[0] = -1.0;
+    BOOST_CHECK_EQUAL_COLLECTIONS( packed.begin(), packed.end(), values.begin(), values.end() );
+    // Ghost cells are not part of the file.
+    BOOST_CHECK_EQUAL( v.grid.cellAt( v, -1, 0, 0 ), 0.0 );
+}
+
+#if 0
 BOOST_AUTO_TEST_CASE( disallow3DGrids ) {
     Opm::parameter::ParameterGroup param;
     param.disableOutput();
@@ -247,46 +544,4 @@ BOOST_AUTO_TEST_CASE( constantCellData ) {
     BOOST_CHECK_EQUAL( grid.cellAt( 0, 1, u ), 42 );
     BOOST_CHECK_EQUAL( grid.cellAt( 1, 1, u ), 42 );
 }
-
-BOOST_AUTO_TEST_CASE( constantFaceData ) {
-    Opm::parameter::ParameterGroup param;
-    param.disableOutput();
-
-    param.insertParameter( "nx", "2" );
-    param.insertParameter( "ny", "2" );
-    param.insertParameter( "flux", "-1.5" );
-
-    equelle::CartesianGrid grid(param);
-
-    auto f = grid.inputFaceCollectionOfScalar( "flux" );
-
-    BOOST_CHECK_EQUAL( grid.faceAt( 0, 0, equelle::CartesianGrid::Face::negX, f ), -1.5 );
-    BOOST_CHECK_EQUAL( grid.faceAt( 1, 0, equelle::CartesianGrid::Face::negX, f ), -1.5 );
-    BOOST_CHECK_EQUAL( grid.faceAt( 2, 0, equelle::CartesianGrid::Face::negX, f ), -1.5 );
-
-    // Check that ghost face is not set.
-    BOOST_CHECK_EQUAL( grid.faceAt( 2, 0, equelle::CartesianGrid::Face::posX, f ), 0.0 );
-}
-
-BOOST_AUTO_TEST_CASE( faceDataFromFile ) {
-    Opm::parameter::ParameterGroup param;
-    param.disableOutput();
-
-    param.insertParameter( "nx", "2" );
-    param.insertParameter( "ny", "2" );
-
-    std::vector<double> defaults = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
-
-    injectMockData( param, "flux", defaults.begin(), defaults.end() );
-
-    equelle::CartesianGrid grid(param);
-    auto u = grid.inputFaceCollectionOfScalar( "flux" );
-    BOOST_CHECK_EQUAL( grid.faceAt( 0, 0, equelle::CartesianGrid::Face::negX, u ), 1 );
-    BOOST_CHECK_EQUAL( grid.faceAt( 1, 0, equelle::CartesianGrid::Face::posX, u ), 3 );
-
-    BOOST_CHECK_EQUAL( grid.faceAt( 1, 1, equelle::CartesianGrid::Face::negY, u ), 11 );
-    BOOST_CHECK_EQUAL( grid.faceAt( 1, 1, equelle::CartesianGrid::Face::posY, u ), 12 );
-
-
-}
 #endif
@@ -5,6 +5,7 @@
 
 #include "equelle/mpiutils.hpp"
 #include "equelle/RuntimeMPI.hpp"
+#include "equelle/PartitionFile.hpp"
 #include "opm/core/grid.h"
 #include "opm/core/grid/GridManager.hpp"
 
@@ -26,8 +27,13 @@ int main( int argc, char* argv[] ) {
         auto zr = runtime.computePartition();
 
         if ( equelle::getMPIRank() == 0 ) {
+            const int numCells = runtime.globalGrid->c_grid()->number_of_cells;
             std::ofstream f( std::string( argv[1]) + std::string( ".part.out")  );
-            equelle::ZoltanGrid::dumpRank0Exports( runtime.globalGrid->c_grid()->number_of_cells, zr, f );
+            equelle::ZoltanGrid::dumpRank0Exports( numCells, zr, f );
+
+            // Compact version for the partition_filename parameter of RuntimeMPI, when run on as many nodes.
+            equelle::PartitionFile::write( std::string( argv[1] ) + std::string( ".part" ),
+                                           equelle::ZoltanGrid::rank0CellOwners( numCells, zr ), size );
         }
     }
 